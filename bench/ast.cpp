@@ -0,0 +1,273 @@
+#include "bench.h"
+
+#include <iostream>
+
+#include "node_table.h"
+
+namespace {
+    // what a traversal computes: the nodes met and the sum of the literal values, the same for both layouts
+    struct Sum {
+        size_t nodes = 0;
+        int64_t literals = 0;
+
+        bool operator==(const Sum&) const = default;
+    };
+
+    // walk of the pointer tree, in the shape the passes over it have (a visitor per kind of node)
+    struct TreeWalk {
+        Sum& sum;
+
+        void expr(const Node::Expr* e) const {
+            struct ExprVisitor {
+                const TreeWalk& walk;
+
+                void operator()(const Node::Term* t) const { walk.term(t); }
+
+                void operator()(const Node::BinExpr* bin) const {
+                    walk.sum.nodes++;
+                    walk.expr(bin->lside);
+                    walk.expr(bin->rside);
+                }
+
+                void operator()(const Node::ExprNot* e) const {
+                    walk.sum.nodes++;
+                    walk.expr(e->expr);
+                }
+
+                void operator()(const Node::VarIncr*) const { walk.sum.nodes++; }
+
+                void operator()(const Node::VarDecr*) const { walk.sum.nodes++; }
+            };
+
+            std::visit(ExprVisitor{ *this }, e->var);
+        }
+
+        void term(const Node::Term* t) const {
+            struct TermVisitor {
+                const TreeWalk& walk;
+
+                void operator()(const Node::TermBooleanLiteral* lit) const {
+                    walk.sum.nodes++;
+                    walk.sum.literals += lit->value;
+                }
+
+                void operator()(const Node::TermIntegerLiteral* lit) const {
+                    walk.sum.nodes++;
+                    walk.sum.literals += lit->value;
+                }
+
+                void operator()(const Node::TermCharLiteral* lit) const {
+                    walk.sum.nodes++;
+                    walk.sum.literals += lit->char_lit.val.value()[0];
+                }
+
+                void operator()(const Node::TermStringLiteral*) const { walk.sum.nodes++; }
+
+                void operator()(const Node::TermIdentifier*) const { walk.sum.nodes++; }
+
+                void operator()(const Node::FuncCall* fcall) const { walk.call(fcall); }
+
+                void operator()(const Node::TermParen* paren) const { walk.expr(paren->expr); }
+            };
+
+            std::visit(TermVisitor{ *this }, t->var);
+        }
+
+        void call(const Node::FuncCall* fcall) const {
+            sum.nodes++;
+            for (const Node::Expr* arg : fcall->args)
+                expr(arg);
+        }
+
+        void scope(const Node::Scope* sc) const {
+            sum.nodes++;
+            for (const Node::ScopeStmt* s : sc->stmts)
+                stmt(s);
+        }
+
+        void if_pred(const Node::IfPred* pred) const {
+            if (const auto elif_pred = std::get_if<Node::IfPredElif*>(&pred->var)) {
+                sum.nodes++;
+                expr((*elif_pred)->expr);
+                scope((*elif_pred)->scope);
+                if ((*elif_pred)->pred.has_value())
+                    if_pred((*elif_pred)->pred.value());
+            }
+            else
+                scope(std::get<Node::IfPredElse*>(pred->var)->scope);
+        }
+
+        void stmt(const Node::ScopeStmt* s) const {
+            struct ScopeStmtVisitor {
+                const TreeWalk& walk;
+
+                void operator()(const Node::Scope* sc) const { walk.scope(sc); }
+
+                void operator()(const Node::StmtImplicitVar* v) const {
+                    walk.sum.nodes++;
+                    walk.expr(v->expr);
+                }
+
+                void operator()(const Node::StmtExplicitVar*) const { walk.sum.nodes++; }
+
+                void operator()(const Node::StmtVarAssign* assign) const {
+                    walk.sum.nodes++;
+                    walk.expr(assign->expr);
+                }
+
+                void operator()(const Node::FuncCall* fcall) const { walk.call(fcall); }
+
+                void operator()(const Node::VarIncr*) const { walk.sum.nodes++; }
+
+                void operator()(const Node::VarDecr*) const { walk.sum.nodes++; }
+
+                void operator()(const Node::StmtReturn* ret) const {
+                    walk.sum.nodes++;
+                    walk.expr(ret->expr);
+                }
+
+                void operator()(const Node::StmtWhile* w) const {
+                    walk.sum.nodes++;
+                    walk.expr(w->expr);
+                    walk.scope(w->scope);
+                }
+
+                void operator()(const Node::StmtIf* stmt_if) const {
+                    walk.sum.nodes++;
+                    walk.expr(stmt_if->expr);
+                    walk.scope(stmt_if->scope);
+                    if (stmt_if->pred.has_value())
+                        walk.if_pred(stmt_if->pred.value());
+                }
+            };
+
+            std::visit(ScopeStmtVisitor{ *this }, s->var);
+        }
+
+        void prog(const Node::Prog& p) const {
+            for (const Node::ProgStmt* s : p.stmts) {
+                if (const auto f = std::get_if<Node::FuncDeclaration*>(&s->var)) {
+                    sum.nodes++;
+                    scope((*f)->scope);
+                }
+                else if (const auto v = std::get_if<Node::StmtImplicitVar*>(&s->var)) {
+                    sum.nodes++;
+                    expr((*v)->expr);
+                }
+            }
+        }
+    };
+
+    // the same walk over the table, following the operand indices
+    struct TableWalk {
+        const NodeTable& t;
+        Sum& sum;
+
+        void node(NodeTable::Index n) const {
+            using Kind = NodeTable::Kind;
+            sum.nodes++;
+
+            switch (t.kinds[n]) {
+            case Kind::BOOL_LIT:
+            case Kind::CHAR_LIT:
+            case Kind::INT_LIT:
+                sum.literals += t.imms[n];
+                break;
+            case Kind::BIN:
+            case Kind::WHILE:
+                node(t.lhs[n]);
+                node(t.rhs[n]);
+                break;
+            case Kind::NOT:
+            case Kind::RETURN:
+            case Kind::DECLARE:
+            case Kind::ASSIGN:
+                if (t.lhs[n] != NodeTable::NONE)
+                    node(t.lhs[n]);
+                break;
+            case Kind::CALL:
+            case Kind::PRINT:
+            case Kind::PRINTLN:
+            case Kind::ITOC:
+            case Kind::CTOI:
+            case Kind::SCOPE:
+                for (NodeTable::Index i = t.lhs[n]; i < t.lhs[n] + t.rhs[n]; i++)
+                    node(t.lists[i]);
+                break;
+            case Kind::IF:
+                node(t.lhs[n]);
+                node(t.rhs[n]);
+                if (t.imms[n] != NodeTable::NONE)
+                    node(t.imms[n]);
+                break;
+            case Kind::FUNC:
+                node(t.rhs[n]);
+                break;
+            default:
+                break;
+            }
+        }
+
+        void prog() const {
+            for (const NodeTable::Index g : t.globals)
+                node(g);
+            for (const NodeTable::Index f : t.functions)
+                node(f);
+        }
+    };
+
+    // a pass that needs no order (a count, a search) reads the arrays front to back
+    Sum scan(const NodeTable& t) {
+        Sum sum{ t.size(), 0 };
+
+        for (size_t n = 0; n < t.size(); n++) {
+            const NodeTable::Kind kind = t.kinds[n];
+            if (kind == NodeTable::Kind::BOOL_LIT || kind == NodeTable::Kind::CHAR_LIT
+                || kind == NodeTable::Kind::INT_LIT)
+                sum.literals += t.imms[n];
+        }
+
+        return sum;
+    }
+}
+
+namespace bench {
+    bool ast() {
+        const std::string src = synthetic_program(8 << 20);
+        Tokenizer tokenizer(src);
+        Parser parser(tokenizer);
+        const std::optional<Node::Prog> prog = parser.parse_prog();
+
+        if (!prog.has_value()) {
+            std::cout << "ast: the synthetic program does not parse" << std::endl;
+            return false;
+        }
+
+        Sum tree_sum, table_sum, scan_sum;
+        std::optional<NodeTable> table;
+
+        const double flatten = best_of(3, [&] { table.emplace(prog.value()); });
+        const double tree = best_of(5, [&] {
+            tree_sum = {};
+            TreeWalk{ tree_sum }.prog(prog.value());
+        });
+        const double walk = best_of(5, [&] {
+            table_sum = {};
+            TableWalk{ table.value(), table_sum }.prog();
+        });
+        const double linear = best_of(5, [&] { scan_sum = scan(table.value()); });
+
+        std::cout << "ast: " << table->size() / 1e6 << " M nodes (" << src.size() / 1e6 << " MB), pointer tree "
+            << tree * 1e3 << " ms, table walk " << walk * 1e3 << " ms, table scan " << linear * 1e3
+            << " ms, flattening " << flatten * 1e3 << " ms (best of 5)" << std::endl;
+
+        // the three traversals must meet the same nodes, or the table lost some of the tree
+        if (!(tree_sum == table_sum && table_sum == scan_sum)) {
+            std::cout << "ast: the traversals disagree: " << tree_sum.nodes << " nodes in the tree, "
+                << table_sum.nodes << " walked in the table, " << scan_sum.nodes << " in the table" << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+}
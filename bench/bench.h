@@ -0,0 +1,45 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+
+/// @brief benchmarks of the compiler itself, run by `make bench` (see bench/run.sh); each prints its figures
+/// and checks what must not regress
+namespace bench {
+    /// @brief best wall time of some runs of fn, in seconds
+    template<typename F>
+    double best_of(int runs, F&& fn) {
+        double best = 0;
+
+        for (int i = 0; i < runs; i++) {
+            const auto start = std::chrono::steady_clock::now();
+            fn();
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+            if (i == 0 || elapsed.count() < best)
+                best = elapsed.count();
+        }
+
+        return best;
+    }
+
+    /// @brief a valid program of about `bytes` bytes mixing every kind of token: declarations, loops,
+    /// conditions, calls, literals of each type and comments
+    std::string synthetic_program(size_t bytes);
+
+    /// @brief lexing throughput on a synthetic program, in MB/s
+    /// @return false if a check failed
+    bool tokenizer();
+
+    /// @brief traversal time of a large synthetic program, as a pointer tree and as a NodeTable
+    /// @return false if the traversals do not meet the same nodes
+    bool ast();
+
+    /// @brief C++ generation time of deeply nested expressions
+    /// @return false if it grows faster than the depth
+    bool expressions();
+
+    /// @brief C++ generation time of deeply nested if and while blocks
+    /// @return false if it grows faster than the generated code
+    bool scopes();
+}
@@ -0,0 +1,92 @@
+#include "bench.h"
+
+#include <iostream>
+
+#include <malloc.h>
+
+#include "generation.h"
+
+namespace {
+    // 20 functions each returning an expression nested `depth` parentheses deep
+    std::string nested_expressions(int depth) {
+        static constexpr const char* ops[] = { " + ", " - ", " * " };
+        std::string src = "var g = 3\n";
+
+        for (int f = 0; f < 20; f++) {
+            src += "func f" + std::to_string(f) + "() : int {\n    return ";
+            for (int i = 0; i < depth; i++)
+                src += std::string("g") + ops[i % 3] + "(";
+            src += "1" + std::string(depth, ')') + "\n}\n";
+        }
+
+        src += "func main() : int {\n    return f0()\n}\n";
+        return src;
+    }
+
+    // main nesting `depth` blocks, alternately an if and a while, each with a statement of its own
+    std::string nested_scopes(int depth) {
+        std::string src = "func main() : int {\n    var a = 0\n";
+
+        for (int i = 0; i < depth; i++) {
+            src += i % 2 == 0 ? "if (a < " : "while (a > ";
+            src += std::to_string(i) + ") {\na = a + 1\n";
+        }
+        src += std::string(depth, '}') + "\n    return a\n}\n";
+
+        return src;
+    }
+
+    // best time of some runs of the C++ generation of a program (the parse is not timed), and the size of its output
+    double generate(const std::string& src, size_t& output, int runs = 5) {
+        Tokenizer tokenizer(src);
+        Parser parser(tokenizer);
+        const std::optional<Node::Prog> prog = parser.parse_prog();
+
+        // a run before the timed ones, so that the output of these lands in memory already faulted in
+        output = Generator().prog(prog.value()).size();
+
+        return bench::best_of(runs, [&] { output = Generator().prog(prog.value()).size(); });
+    }
+}
+
+namespace bench {
+    bool expressions() {
+        size_t half_size = 0, size = 0;
+        const double half = generate(nested_expressions(1500), half_size);
+        const double full = generate(nested_expressions(3000), size);
+
+        std::cout << "expressions: 20 functions of 3000-deep expressions generated in " << full * 1e3 << " ms ("
+            << size / 1e6 / full << " MB/s), 1500-deep in " << half * 1e3 << " ms (best of 5)" << std::endl;
+
+        // twice the depth is twice the output, a cost growing with the depth of each node would show here
+        if (full > 3 * half) {
+            std::cout << "expressions: generation is not linear in the depth of the expressions" << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    bool scopes() {
+        // keep the freed buffers instead of handing them back to the system: the 2000 levels make outputs of 16 MB,
+        // past the size glibc maps afresh at each allocation, and the page faults of that would dominate their time
+        mallopt(M_MMAP_THRESHOLD, 64 << 20);
+        mallopt(M_TRIM_THRESHOLD, 256 << 20);
+
+        size_t size = 0, double_size = 0;
+        const double full = generate(nested_scopes(1000), size, 20);
+        const double twice = generate(nested_scopes(2000), double_size, 20);
+
+        std::cout << "scopes: 1000 nested blocks generated in " << full * 1e3 << " ms (" << size / 1e6 / full
+            << " MB/s), 2000 in " << twice * 1e3 << " ms (" << double_size / 1e6 / twice << " MB/s, best of 20)"
+            << std::endl;
+
+        // the indentation makes the output quadratic in the depth, the time must stay linear in the output
+        if (twice / double_size > 2 * full / size) {
+            std::cout << "scopes: generation is not linear in the size of the output" << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+}
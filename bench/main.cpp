@@ -0,0 +1,50 @@
+#include <iostream>
+#include <string_view>
+
+#include "bench.h"
+
+namespace
+{
+    struct Benchmark
+    {
+        std::string_view name;
+        bool (*run)();
+    };
+
+    constexpr Benchmark benchmarks[] = {
+        { "tokenizer", bench::tokenizer },
+        { "ast", bench::ast },
+        { "expressions", bench::expressions },
+        { "scopes", bench::scopes },
+    };
+}
+
+int main(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; i++)
+    {
+        bool known = false;
+        for (const Benchmark &b : benchmarks)
+            known |= argv[i] == b.name;
+
+        if (!known)
+        {
+            std::cerr << "unknown benchmark " << argv[i] << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    // no name runs them all
+    bool passed = true;
+    for (const Benchmark &b : benchmarks)
+    {
+        bool selected = argc == 1;
+        for (int i = 1; i < argc; i++)
+            selected |= argv[i] == b.name;
+
+        if (selected)
+            passed &= b.run();
+    }
+
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,177 @@
+#!/usr/bin/env bash
+# Benchmarks: the internals of the compiler (cern-bench, see bench/main.cpp) and the run time of the programs of
+# bench/programs through the backends. Each prints the figures quoted in the history of the change it measures;
+# a check that fails (a regression) makes the script exit with 1.
+#
+# usage: bench/run.sh <cern> <cern-bench> [name ...]    (no name runs them all)
+
+set -u
+
+cern=$(realpath "$1")
+cern_bench=$(realpath "$2")
+shift 2
+
+programs=$(cd "$(dirname "$0")" && pwd)/programs
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+cd "$work" || exit 1
+
+# the builds must really run, the cache of the user is left alone
+export XDG_CACHE_HOME="$work/cache"
+
+# best wall time of 3 runs of a command, in seconds; the output and the exit status of the last run are left in
+# $work/output
+best() {
+    local best=""
+    for _ in 1 2 3; do
+        local start end
+        start=$(date +%s%N)
+        "$@" > "$work/output" 2>&1
+        echo "exit $?" >> "$work/output"
+        end=$(date +%s%N)
+        if [ -z "$best" ] || [ $((end - start)) -lt "$best" ]; then
+            best=$((end - start))
+        fi
+    done
+    printf "%d.%03d s" $((best / 1000000000)) $((best / 1000000 % 1000))
+}
+
+# time a program through some options of cern and print it as a row of the section: the runs in the compiler
+# (--run, --interpret) are timed whole, the builds are timed running the app they wrote, or building it with
+# --build; every row of a program must give the output of its first row
+row() {
+    local label=$1 program=$2
+    shift 2
+
+    local source=$program
+    [ -f "$source" ] || source=$programs/$program
+
+    local time
+    if [[ " $* " == *" --run "* || " $* " == *" --interpret "* ]]; then
+        time=$(best "$cern" "$@" "$source")
+    elif [ "${1:-}" = --build ]; then
+        shift
+        time=$(best "$cern" --no-cache "$@" "$source")
+        ./app > "$work/output" 2>&1
+        echo "exit $?" >> "$work/output"
+    else
+        rm -f app
+        if ! "$cern" --no-cache "$@" "$source" > /dev/null 2>&1; then
+            printf "  %-38s build failed\n" "$label"
+            return 1
+        fi
+        time=$(best ./app)
+    fi
+    printf "  %-38s %s\n" "$label" "$time"
+
+    local expected=$work/$(basename "$program").expected
+    if [ ! -f "$expected" ]; then
+        cp "$work/output" "$expected"
+    elif ! cmp -s "$expected" "$work/output"; then
+        echo "  the output of $program differs:"
+        diff "$expected" "$work/output" | head -n 5
+        return 1
+    fi
+}
+
+# bytecode VM against the executables of the other backends, and startup against a g++ build
+bench_vm() {
+    local ok=0
+
+    echo "vm: b.ce, 100M iterations of a call plus arithmetic"
+    row "g++ -O0" b.ce || ok=1
+    row "--native" b.ce --native || ok=1
+    row "--run --no-jit" b.ce --run --no-jit || ok=1
+    row "--run" b.ce --run || ok=1
+
+    echo "vm: a.ce, a short script from source to output"
+    row "build through g++" a.ce --build || ok=1
+    row "--run" a.ce --run || ok=1
+
+    return $ok
+}
+
+# tree-walking interpreter: startup on a short script, and throughput on b.ce cut down to 10M iterations
+bench_interpret() {
+    local ok=0
+
+    echo "interpret: a.ce, a short script from source to output"
+    row "build through g++" a.ce --build || ok=1
+    row "--interpret" a.ce --interpret || ok=1
+    row "--run" a.ce --run || ok=1
+
+    sed 's/100000000/10000000/' "$programs/b.ce" > b10.ce
+    echo "interpret: b.ce cut down to 10M iterations"
+    row "--interpret --no-opt" b10.ce --interpret --no-opt || ok=1
+    row "--interpret" b10.ce --interpret || ok=1
+    row "--run --no-jit" b10.ce --run --no-jit || ok=1
+
+    return $ok
+}
+
+# machine code compiled by the JIT against the bytecode VM and the executable of g++
+bench_jit() {
+    local ok=0
+
+    echo "jit: loop.ce, 100M iterations of integer arithmetic"
+    row "g++ -O0" loop.ce || ok=1
+    row "--run --no-jit" loop.ce --run --no-jit || ok=1
+    row "--run" loop.ce --run || ok=1
+
+    echo "jit: b.ce, 100M iterations of a call plus arithmetic"
+    row "g++ -O0" b.ce || ok=1
+    row "--run --no-jit" b.ce --run --no-jit || ok=1
+    row "--run" b.ce --run || ok=1
+
+    return $ok
+}
+
+# a call-heavy loop with the inliner disabled then at its default threshold, through every backend
+bench_inline() {
+    local ok=0
+
+    echo "inline: b.ce, 100M calls of sq(), --inline-threshold 0 then the default"
+    for mode in "" --native "--run --no-jit" --run; do
+        row "${mode:-g++ -O0} --inline-threshold 0" b.ce $mode --inline-threshold 0 || ok=1
+        row "${mode:-g++ -O0}" b.ce $mode || ok=1
+    done
+
+    return $ok
+}
+
+# nested loops as parsed then with the invariants hoisted and the induction products strength-reduced
+bench_loops() {
+    local ok=0
+
+    echo "loops: nested.ce, 30M inner iterations, --no-opt then optimized"
+    for mode in "" --native "--run --no-jit" --run --interpret; do
+        row "${mode:-g++ -O0} --no-opt" nested.ce $mode --no-opt || ok=1
+        row "${mode:-g++ -O0}" nested.ce $mode || ok=1
+    done
+
+    return $ok
+}
+
+# the sections timing programs, the other names go to cern-bench
+sections=(vm interpret jit inline loops)
+
+passed=true
+internals=()
+for name in "${@:-all}"; do
+    if [[ " ${sections[*]} " == *" $name "* ]]; then
+        "bench_$name" || passed=false
+    elif [ "$name" = all ]; then
+        "$cern_bench" || passed=false
+        for s in "${sections[@]}"; do
+            "bench_$s" || passed=false
+        done
+    else
+        internals+=("$name")
+    fi
+done
+
+if [ ${#internals[@]} -gt 0 ]; then
+    "$cern_bench" "${internals[@]}" || passed=false
+fi
+
+$passed
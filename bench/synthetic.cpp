@@ -0,0 +1,36 @@
+#include "bench.h"
+
+namespace bench {
+    std::string synthetic_program(size_t bytes) {
+        std::string src;
+        src.reserve(bytes + 512);
+
+        // every function reads its own global, so the names never clash
+        for (size_t i = 0; src.size() < bytes; i++) {
+            const std::string n = std::to_string(i);
+
+            src += "var g" + n + " = " + n + "\n";
+            src += "func f" + n + "() : int {\n";
+            src += "    var a = g" + n + " * 3 + 7\n";
+            src += "    var s = \"text " + n + "\\n\" // the label\n";
+            src += "    var c = 'x'\n";
+            src += "    /* count up */\n";
+            src += "    while ((a < 100) && (a != 5)) {\n";
+            src += "        a = a + (g" + n + " - 1) / 2\n";
+            src += "        a++\n";
+            src += "    }\n";
+            src += "    if (a >= 10) {\n";
+            src += "        println(s, \" \", a)\n";
+            src += "    } elif (a == 3) {\n";
+            src += "        print(c, ctoi('7'))\n";
+            src += "    } else {\n";
+            src += "        a--\n";
+            src += "    }\n";
+            src += "    return a\n";
+            src += "}\n";
+        }
+
+        src += "func main() : int {\n    return f0()\n}\n";
+        return src;
+    }
+}
@@ -0,0 +1,23 @@
+#include "bench.h"
+
+#include <iostream>
+
+#include "tokenizer.h"
+
+namespace bench {
+    bool tokenizer() {
+        const std::string src = synthetic_program(16 << 20);
+        size_t tokens = 0;
+
+        const double seconds = best_of(5, [&] {
+            Tokenizer t(src);
+            tokens = 0;
+            while (t.next().has_value())
+                tokens++;
+        });
+
+        std::cout << "tokenizer: " << src.size() / 1e6 / seconds << " MB/s, " << tokens / 1e6 / seconds
+            << " M tokens/s (" << src.size() / 1e6 << " MB, best of 5)" << std::endl;
+        return true;
+    }
+}
@@ -5,17 +5,105 @@
 #include <memory>
 #include <utility>
 #include <iostream>
+#include <algorithm>
+#include <memory_resource>
+#include <vector>
 
-class ArenaAllocator final
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+// also a memory resource, so std::pmr containers can keep their storage in the arena
+class ArenaAllocator final : public std::pmr::memory_resource
 {
 private:
-    size_t _size;
-    std::byte *_buffer;
-    std::byte *_offset;
+    // every block starts with this header, blocks are chained from the newest to the oldest
+    struct Block
+    {
+        Block *prev;
+        std::size_t size;
+        bool mapped;
+    };
+
+    // blocks at least this big are mmap'd and advised to use transparent huge pages
+    static constexpr std::size_t HUGE_BLOCK_SIZE = 2 * 1024 * 1024;
+    // geometric growth stops doubling past this size
+    static constexpr std::size_t MAX_BLOCK_SIZE = 64 * 1024 * 1024;
+
+    std::size_t _next_block_size;
+    Block *_head{nullptr};
+    std::byte *_offset{nullptr};
+    std::byte *_end{nullptr};
+
+    std::size_t _bytes_used{0};
+    std::size_t _bytes_reserved{0};
+    std::size_t _block_count{0};
+
+    static Block *new_block(const std::size_t size)
+    {
+        void *memory = nullptr;
+        bool mapped = false;
+
+#ifdef __linux__
+        if (size >= HUGE_BLOCK_SIZE)
+        {
+            memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (memory == MAP_FAILED)
+                memory = nullptr;
+            else
+            {
+                madvise(memory, size, MADV_HUGEPAGE);
+                mapped = true;
+            }
+        }
+#endif
+
+        if (memory == nullptr)
+            memory = ::operator new(size);
+
+        return new (memory) Block{nullptr, size, mapped};
+    }
+
+    static void free_block(Block *block)
+    {
+#ifdef __linux__
+        if (block->mapped)
+        {
+            munmap(block, block->size);
+            return;
+        }
+#endif
+        ::operator delete(block);
+    }
+
+    // chain a new block big enough for an allocation of num_bytes aligned on align
+    void grow(const std::size_t num_bytes, const std::size_t align)
+    {
+        const std::size_t needed = sizeof(Block) + num_bytes + align;
+        const std::size_t size = std::max(_next_block_size, needed);
+
+        Block *block = new_block(size);
+        block->prev = _head;
+        _head = block;
+
+        _offset = reinterpret_cast<std::byte *>(block) + sizeof(Block);
+        _end = reinterpret_cast<std::byte *>(block) + size;
+
+        _bytes_reserved += size;
+        _block_count++;
+        _next_block_size = std::min(_next_block_size * 2, MAX_BLOCK_SIZE);
+    }
+
+    void release()
+    {
+        while (_head != nullptr)
+            free_block(std::exchange(_head, _head->prev));
+    }
 
 public:
-    ArenaAllocator(const std::size_t max_num_bytes)
-        : _size{max_num_bytes}, _buffer{new std::byte[max_num_bytes]}, _offset{_buffer}
+    // the arena starts empty, the first block is allocated on first use
+    explicit ArenaAllocator(const std::size_t first_block_size = 64 * 1024)
+        : _next_block_size{std::max(first_block_size, sizeof(Block) * 2)}
     {
     }
 
@@ -24,30 +112,46 @@ public:
     ArenaAllocator &operator=(const ArenaAllocator &) = delete;
 
     ArenaAllocator(ArenaAllocator &&other) noexcept
-        : _size{std::exchange(other._size, 0)}, _buffer{std::exchange(other._buffer, nullptr)}, _offset{std::exchange(other._offset, nullptr)}
+        : _next_block_size{other._next_block_size}, _head{std::exchange(other._head, nullptr)},
+          _offset{std::exchange(other._offset, nullptr)}, _end{std::exchange(other._end, nullptr)},
+          _bytes_used{std::exchange(other._bytes_used, 0)}, _bytes_reserved{std::exchange(other._bytes_reserved, 0)},
+          _block_count{std::exchange(other._block_count, 0)}
     {
     }
 
     ArenaAllocator &operator=(ArenaAllocator &&other) noexcept
     {
-        std::swap(_size, other._size);
-        std::swap(_buffer, other._buffer);
+        std::swap(_next_block_size, other._next_block_size);
+        std::swap(_head, other._head);
         std::swap(_offset, other._offset);
+        std::swap(_end, other._end);
+        std::swap(_bytes_used, other._bytes_used);
+        std::swap(_bytes_reserved, other._bytes_reserved);
+        std::swap(_block_count, other._block_count);
         return *this;
     }
 
-    template <typename T>
-    [[nodiscard]] T *alloc()
+    [[nodiscard]] void *allocate(const std::size_t num_bytes, const std::size_t align)
     {
-        std::size_t remaining_num_bytes = _size - static_cast<std::size_t>(_offset - _buffer);
+        std::size_t remaining_num_bytes = static_cast<std::size_t>(_end - _offset);
         auto pointer = static_cast<void *>(_offset);
-        const auto aligned_address = std::align(alignof(T), sizeof(T), pointer, remaining_num_bytes);
+        auto aligned_address = _offset == nullptr ? nullptr : std::align(align, num_bytes, pointer, remaining_num_bytes);
         if (aligned_address == nullptr)
         {
-            throw std::bad_alloc{};
+            grow(num_bytes, align);
+            remaining_num_bytes = static_cast<std::size_t>(_end - _offset);
+            pointer = static_cast<void *>(_offset);
+            aligned_address = std::align(align, num_bytes, pointer, remaining_num_bytes);
         }
-        _offset = static_cast<std::byte *>(aligned_address) + sizeof(T);
-        return static_cast<T *>(aligned_address);
+        _offset = static_cast<std::byte *>(aligned_address) + num_bytes;
+        _bytes_used += num_bytes;
+        return aligned_address;
+    }
+
+    template <typename T>
+    [[nodiscard]] T *alloc()
+    {
+        return static_cast<T *>(allocate(sizeof(T), alignof(T)));
     }
 
     template <typename T, typename... Args>
@@ -57,8 +161,56 @@ public:
         return new (allocated_memory) T{std::forward<Args>(args)...};
     }
 
+    // drop every allocation at once, the newest (and biggest) block is kept for reuse
+    void reset()
+    {
+        if (_head == nullptr)
+            return;
+
+        Block *keep = std::exchange(_head, _head->prev);
+        release();
+        keep->prev = nullptr;
+        _head = keep;
+
+        _offset = reinterpret_cast<std::byte *>(keep) + sizeof(Block);
+        _end = reinterpret_cast<std::byte *>(keep) + keep->size;
+
+        _bytes_used = 0;
+        _bytes_reserved = keep->size;
+        _block_count = 1;
+    }
+
+    // bytes handed out by allocate (alignment padding excluded)
+    std::size_t bytes_used() const { return _bytes_used; }
+
+    // bytes held in blocks
+    std::size_t bytes_reserved() const { return _bytes_reserved; }
+
+    std::size_t block_count() const { return _block_count; }
+
     ~ArenaAllocator()
     {
-        delete[] _buffer;
+        release();
+    }
+
+protected:
+    void *do_allocate(const std::size_t num_bytes, const std::size_t align) override
+    {
+        return allocate(num_bytes, align);
+    }
+
+    // memory is only given back on reset or destruction
+    void do_deallocate(void *, std::size_t, std::size_t) override
+    {
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+    {
+        return this == &other;
     }
 };
+
+// vector whose elements live in an arena: construct it with the arena as resource,
+// it never touches the global heap and needs no destructor call
+template <typename T>
+using ArenaVector = std::pmr::vector<T>;
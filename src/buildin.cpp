@@ -1,49 +1,41 @@
 #include "buildin.h"
 
-#include <sstream>
-
 #include "generation.h"
 
 namespace {
-    void exit_with(const std::string& err_msg)
+    // the functions may be generated on several threads
+    [[noreturn]] void exit_with(const std::string& err_msg)
     {
-        std::cerr << "[Error] " << err_msg << std::endl;
-        exit(EXIT_FAILURE);
+        exit_with_error("[Error] " + err_msg);
     }
 
-    std::string print_call(const std::vector<Node::Expr*>& args)
+    void print_call(std::span<Node::Expr* const> args, std::string& out)
     {
-        std::stringstream ss;
-
-        ss << "std::cout";
+        out += "std::cout";
 
         for (size_t i = 0; i < args.size(); i++)
         {
-            ss << " << " << gen::expr(args[i]);
+            out += " << ";
+            gen::expr(args[i], out);
         }
-        
-        ss << ";\n";
 
-        return ss.str();
+        out += ";\n";
     }
 
-    std::string println_call(const std::vector<Node::Expr*>& args)
+    void println_call(std::span<Node::Expr* const> args, std::string& out)
     {
-        std::stringstream ss;
-
-        ss << "std::cout";
+        out += "std::cout";
 
         for (size_t i = 0; i < args.size(); i++)
         {
-            ss << " << " << gen::expr(args[i]);
+            out += " << ";
+            gen::expr(args[i], out);
         }
-        
-        ss << " << std::endl;\n";
 
-        return ss.str();
+        out += " << std::endl;\n";
     }
 
-    std::string itoc_call(const std::vector<Node::Expr*>& args)
+    void itoc_call(std::span<Node::Expr* const> args, std::string& out)
     {
         if (args.empty())
             exit_with("function `itoc` require an argument");
@@ -52,10 +44,12 @@ namespace {
         if (args.size() > 1)
             exit_with("too many arguments in function call");
 
-        return "(char)(" + gen::expr(args[0]) + "+ '0')";
+        out += "(char)(";
+        gen::expr(args[0], out);
+        out += "+ '0')";
     }
 
-    std::string ctoi_call(const std::vector<Node::Expr*>& args)
+    void ctoi_call(std::span<Node::Expr* const> args, std::string& out)
     {
         if (args.empty())
             exit_with("function `ctoi` require an argument");
@@ -64,20 +58,24 @@ namespace {
         if (args.size() > 1)
             exit_with("too many arguments in function call");
 
-        return "("+ gen::expr(args[0]) + " - '0')";
+        out += "(";
+        gen::expr(args[0], out);
+        out += " - '0')";
     }
 }
 
-std::optional<std::string> call_func(std::string func, const std::vector<Node::Expr*>& args)
+bool call_func(std::string_view func, std::span<Node::Expr* const> args, std::string& out)
 {
     if (func == "print")
-        return print_call(args);
+        print_call(args, out);
     else if (func == "println")
-        return println_call(args);
+        println_call(args, out);
     else if (func == "itoc")
-        return itoc_call(args);
+        itoc_call(args, out);
     else if (func == "ctoi")
-        return ctoi_call(args);
-    
-    return {};
+        ctoi_call(args, out);
+    else
+        return false;
+
+    return true;
 }
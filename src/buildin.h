@@ -1,5 +1,10 @@
 #pragma once
 
+#include <span>
+
 #include "parser.h"
 
-std::optional<std::string> call_func(std::string func, const std::vector<Node::Expr*>& args = {});
+/// @brief emit a call to a buildin function
+/// @param out buffer the generated code is appended to
+/// @return false if func is not a buildin (nothing is emitted)
+bool call_func(std::string_view func, std::span<Node::Expr* const> args, std::string& out);
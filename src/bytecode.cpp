@@ -0,0 +1,572 @@
+#include "bytecode.h"
+
+#include <algorithm>
+
+namespace {
+    // opcodes whose operand a is the written register
+    bool writes_a(bc::OpCode op) {
+        switch (op) {
+        case bc::SETG:
+        case bc::JMP:
+        case bc::JMPF:
+        case bc::JMPT:
+        case bc::RET:
+        case bc::RETV:
+        case bc::PRINTI:
+        case bc::PRINTC:
+        case bc::PRINTS:
+        case bc::PRINTLN:
+        case bc::HALT:
+            return false;
+        default:
+            return true;
+        }
+    }
+
+    bc::OpCode to_opcode(BinOp op) {
+        switch (op) {
+        case BinOp::ADD:
+            return bc::ADD;
+        case BinOp::SUB:
+            return bc::SUB;
+        case BinOp::MULTI:
+            return bc::MUL;
+        case BinOp::DIV:
+            return bc::DIV;
+        case BinOp::IS_EQUAL:
+            return bc::EQ;
+        case BinOp::IS_NOT_EQUAL:
+            return bc::NE;
+        case BinOp::GREATER_OR_EQUAL:
+            return bc::GE;
+        case BinOp::GREATER:
+            return bc::GT;
+        case BinOp::LOWER_OR_EQUAL:
+            return bc::LE;
+        case BinOp::LOWER:
+            return bc::LT;
+        default:
+            assert(false); // && and || are lowered to jumps
+            return bc::HALT;
+        }
+    }
+
+    // form taking its right operand as an immediate (+ and - both map to ADDI)
+    bc::OpCode to_immediate_opcode(BinOp op) {
+        switch (op) {
+        case BinOp::MULTI:
+            return bc::MULI;
+        case BinOp::IS_EQUAL:
+            return bc::EQI;
+        case BinOp::IS_NOT_EQUAL:
+            return bc::NEI;
+        case BinOp::GREATER_OR_EQUAL:
+            return bc::GEI;
+        case BinOp::GREATER:
+            return bc::GTI;
+        case BinOp::LOWER_OR_EQUAL:
+            return bc::LEI;
+        case BinOp::LOWER:
+            return bc::LTI;
+        default:
+            assert(false); // no immediate form
+            return bc::HALT;
+        }
+    }
+}
+
+void BytecodeCompiler::exit_with(const std::string& err_msg) {
+    std::cerr << "[Bytecode Error] " << err_msg << std::endl;
+    exit(EXIT_FAILURE);
+}
+
+size_t BytecodeCompiler::emit(bc::OpCode op, int32_t a, int32_t b, int32_t c) {
+    program.code.push_back({ op, a, b, c });
+    return program.code.size() - 1;
+}
+
+void BytecodeCompiler::patch(size_t at) {
+    bc::Instr& jump = program.code[at];
+    const int32_t target = static_cast<int32_t>(program.code.size());
+
+    if (jump.op == bc::JMP)
+        jump.a = target;
+    else
+        jump.b = target;
+}
+
+int BytecodeCompiler::new_reg() {
+    bc::Function& f = program.functions[current];
+    f.frame_size = std::max(f.frame_size, reg_top + 1);
+    return reg_top++;
+}
+
+int BytecodeCompiler::string_index(std::string_view lit) {
+    std::string s = unescape(lit);
+
+    if (const auto it = strings.find(s); it != strings.end())
+        return it->second;
+
+    const int index = static_cast<int>(program.strings.size());
+    program.strings.push_back(s);
+    strings.emplace(std::move(s), index);
+    return index;
+}
+
+void BytecodeCompiler::begin_function(std::string_view name, VarType type) {
+    current = program.functions.size();
+    program.functions.push_back({ name, type, program.code.size(), 0, 0 });
+    reg_top = 0;
+    locals.emplace_back();
+}
+
+void BytecodeCompiler::end_function() {
+    program.functions[current].end = program.code.size();
+    locals.pop_back();
+}
+
+bc::Program BytecodeCompiler::compile(const Node::Prog& p) {
+    program = {};
+    string_index("");
+
+    // function 0 runs the global initializers then main, it is compiled last so the
+    // functions and globals it refers to are known; reserve its slot
+    program.functions.push_back({ "<init>", VarType::INT });
+
+    for (const Node::ProgStmt* s : p.stmts) {
+        if (const auto f = std::get_if<Node::FuncDeclaration*>(&s->var))
+            func(*f);
+        else if (const auto v = std::get_if<Node::StmtImplicitVar*>(&s->var))
+            globals[(*v)->identifier.val.value()] = static_cast<int>(globals.size());
+        else if (const auto v = std::get_if<Node::StmtExplicitVar*>(&s->var))
+            globals[(*v)->ident.val.value()] = static_cast<int>(globals.size());
+    }
+
+    const auto main = functions.find("main");
+    if (main == functions.end())
+        exit_with("no `main` function");
+
+    current = 0;
+    program.functions[0].entry = program.code.size();
+    reg_top = 0;
+    locals.emplace_back();
+
+    // globals start zeroed: 0, false and the empty string (index 0)
+    for (const Node::ProgStmt* s : p.stmts) {
+        if (const auto v = std::get_if<Node::StmtImplicitVar*>(&s->var))
+            global((*v)->identifier, (*v)->expr->type, (*v)->expr);
+    }
+
+    const int status = new_reg();
+    emit(bc::CALL, status, main->second);
+    if (program.functions[main->second].type == VarType::VOID)
+        emit(bc::LOADI, status, 0);
+    emit(bc::HALT, status);
+
+    end_function();
+    program.num_globals = globals.size();
+
+    return std::move(program);
+}
+
+void BytecodeCompiler::global(const Token& ident, VarType, const Node::Expr* e) {
+    const int saved = reg_top;
+    emit(bc::SETG, globals.find(ident.val.value())->second, expr(e));
+    reg_top = saved;
+}
+
+void BytecodeCompiler::local(const Token& ident, VarType, const Node::Expr* e) {
+    const int reg = new_reg();
+
+    if (e != nullptr)
+        expr_to(e, reg);
+    else
+        emit(bc::LOADI, reg, 0); // also the empty string
+
+    locals.back()[ident.val.value()] = reg;
+}
+
+void BytecodeCompiler::assign(std::string_view name, const Node::Expr* e) {
+    for (auto it = locals.rbegin(); it != locals.rend(); it++) {
+        if (const auto var = it->find(name); var != it->end()) {
+            expr_to(e, var->second);
+            return;
+        }
+    }
+
+    const auto var = globals.find(name);
+    if (var == globals.end())
+        exit_with("unknown variable `" + std::string(name) + "`");
+
+    emit(bc::SETG, var->second, expr(e));
+}
+
+void BytecodeCompiler::func(const Node::FuncDeclaration* f) {
+    const std::string_view name = f->ident.val.value();
+
+    // registered before the body: the parser only lets a function call the ones declared before it
+    begin_function(name, f->type);
+    scope(f->scope);
+
+    // falling off the end returns 0 (void functions ignore it)
+    emit(bc::RETV);
+    end_function();
+
+    functions[name] = static_cast<int>(current);
+}
+
+void BytecodeCompiler::scope(const Node::Scope* sc) {
+    const int saved = reg_top;
+    locals.emplace_back();
+
+    for (const Node::ScopeStmt* s : sc->stmts)
+        scope_stmt(s);
+
+    locals.pop_back();
+    reg_top = saved;
+}
+
+void BytecodeCompiler::scope_stmt(const Node::ScopeStmt* s) {
+    struct ScopeStmtVisitor {
+        BytecodeCompiler& comp;
+
+        void operator()(const Node::StmtReturn* stmt_return) const {
+            comp.emit(bc::RET, comp.expr(stmt_return->expr));
+        }
+
+        void operator()(const Node::StmtImplicitVar* stmt_var) const {
+            comp.local(stmt_var->identifier, stmt_var->expr->type, stmt_var->expr);
+        }
+
+        void operator()(const Node::StmtExplicitVar* stmt_var) const {
+            comp.local(stmt_var->ident, stmt_var->type, nullptr);
+        }
+
+        void operator()(const Node::StmtVarAssign* var_assign) const {
+            comp.assign(var_assign->ident.val.value(), var_assign->expr);
+        }
+
+        void operator()(const Node::FuncCall* fcall) const {
+            comp.call(fcall);
+        }
+
+        void operator()(const Node::VarIncr* i) const {
+            comp.step(i->ident, 1, -1);
+        }
+
+        void operator()(const Node::VarDecr* d) const {
+            comp.step(d->ident, -1, -1);
+        }
+
+        void operator()(const Node::Scope* s) const {
+            comp.scope(s);
+        }
+
+        void operator()(const Node::StmtWhile* w) const {
+            const int saved = comp.reg_top;
+            const int32_t cond = static_cast<int32_t>(comp.program.code.size());
+            const size_t exit = comp.emit(bc::JMPF, comp.expr(w->expr));
+            comp.reg_top = saved;
+
+            comp.scope(w->scope);
+            comp.emit(bc::JMP, cond);
+            comp.patch(exit);
+        }
+
+        void operator()(const Node::StmtIf* stmt_if) const {
+            std::vector<size_t> exits;
+            const int saved = comp.reg_top;
+            const size_t next = comp.emit(bc::JMPF, comp.expr(stmt_if->expr));
+            comp.reg_top = saved;
+
+            comp.scope(stmt_if->scope);
+
+            if (stmt_if->pred.has_value()) {
+                exits.push_back(comp.emit(bc::JMP));
+                comp.patch(next);
+                comp.if_pred(stmt_if->pred.value(), exits);
+            }
+            else
+                comp.patch(next);
+
+            for (const size_t exit : exits)
+                comp.patch(exit);
+        }
+    };
+
+    // temporaries do not outlive the statement, the register of a declared local does
+    const bool declares = std::holds_alternative<Node::StmtImplicitVar*>(s->var)
+        || std::holds_alternative<Node::StmtExplicitVar*>(s->var);
+    const int saved = reg_top;
+    std::visit(ScopeStmtVisitor{ *this }, s->var);
+    reg_top = saved + declares;
+}
+
+void BytecodeCompiler::if_pred(const Node::IfPred* pred, std::vector<size_t>& exits) {
+    struct PredVisitor {
+        BytecodeCompiler& comp;
+        std::vector<size_t>& exits;
+
+        void operator()(const Node::IfPredElif* elif_pred) const {
+            const int saved = comp.reg_top;
+            const size_t next = comp.emit(bc::JMPF, comp.expr(elif_pred->expr));
+            comp.reg_top = saved;
+
+            comp.scope(elif_pred->scope);
+
+            if (elif_pred->pred.has_value()) {
+                exits.push_back(comp.emit(bc::JMP));
+                comp.patch(next);
+                comp.if_pred(elif_pred->pred.value(), exits);
+            }
+            else
+                comp.patch(next);
+        }
+
+        void operator()(const Node::IfPredElse* else_pred) const {
+            comp.scope(else_pred->scope);
+        }
+    };
+
+    std::visit(PredVisitor{ *this, exits }, pred->var);
+}
+
+int BytecodeCompiler::expr(const Node::Expr* e) {
+    struct ExprVisitor {
+        BytecodeCompiler& comp;
+
+        int operator()(const Node::Term* t) const {
+            return comp.term(t);
+        }
+
+        int operator()(const Node::BinExpr* bin_e) const {
+            return comp.bin_expr(bin_e);
+        }
+
+        int operator()(const Node::ExprNot* e) const {
+            const int reg = comp.expr(e->expr);
+            const int dst = comp.new_reg();
+            comp.emit(bc::NOT, dst, reg);
+            return dst;
+        }
+
+        int operator()(const Node::VarIncr* i) const {
+            const int old = comp.new_reg();
+            comp.step(i->ident, 1, old);
+            return old;
+        }
+
+        int operator()(const Node::VarDecr* d) const {
+            const int old = comp.new_reg();
+            comp.step(d->ident, -1, old);
+            return old;
+        }
+    };
+
+    return std::visit(ExprVisitor{ *this }, e->var);
+}
+
+void BytecodeCompiler::expr_to(const Node::Expr* e, int dst) {
+    const int saved = reg_top;
+    const int reg = expr(e);
+
+    // a temporary written by the last instruction: write dst instead of copying it
+    if (reg != dst && reg >= saved && program.code.back().a == reg && writes_a(program.code.back().op))
+        program.code.back().a = dst;
+    else if (reg != dst)
+        emit(bc::MOV, dst, reg);
+
+    reg_top = saved;
+}
+
+int BytecodeCompiler::bin_expr(const Node::BinExpr* bin) {
+    const bool strings_compared = bin->lside->type == VarType::STRING || bin->rside->type == VarType::STRING;
+    if (strings_compared && bin->op != BinOp::IS_EQUAL && bin->op != BinOp::IS_NOT_EQUAL)
+        exit_with("only `==` and `!=` are supported on strings");
+
+    // short circuit: dst = lside; if (dst decides) skip; dst = rside; dst = dst != 0
+    if (bin->op == BinOp::AND || bin->op == BinOp::OR) {
+        const int dst = new_reg();
+
+        expr_to(bin->lside, dst);
+        const size_t shortcut = emit(bin->op == BinOp::AND ? bc::JMPF : bc::JMPT, dst);
+        expr_to(bin->rside, dst);
+        patch(shortcut);
+        emit(bc::TEST, dst, dst);
+        return dst;
+    }
+
+    // a literal right side is encoded in the instruction
+    if (const std::optional<int32_t> imm = immediate(bin->rside); imm.has_value() && bin->op != BinOp::DIV) {
+        const int lhs = expr(bin->lside);
+        const int dst = new_reg();
+
+        switch (bin->op) {
+        case BinOp::ADD:
+            emit(bc::ADDI, dst, lhs, imm.value());
+            break;
+        case BinOp::SUB:
+            emit(bc::ADDI, dst, lhs, static_cast<int32_t>(0u - static_cast<uint32_t>(imm.value())));
+            break;
+        default:
+            emit(to_immediate_opcode(bin->op), dst, lhs, imm.value());
+        }
+        return dst;
+    }
+
+    const int lhs = expr(bin->lside);
+    const int rhs = expr(bin->rside);
+    const int dst = new_reg();
+
+    emit(to_opcode(bin->op), dst, lhs, rhs);
+    return dst;
+}
+
+std::optional<int32_t> BytecodeCompiler::immediate(const Node::Expr* e) {
+    const auto t = std::get_if<Node::Term*>(&e->var);
+    if (t == nullptr)
+        return {};
+
+    if (const auto lit = std::get_if<Node::TermIntegerLiteral*>(&(*t)->var))
+        return (*lit)->value;
+    if (const auto lit = std::get_if<Node::TermCharLiteral*>(&(*t)->var))
+        return (*lit)->char_lit.val.value()[0];
+    if (const auto lit = std::get_if<Node::TermBooleanLiteral*>(&(*t)->var))
+        return (*lit)->value;
+
+    return {};
+}
+
+int BytecodeCompiler::term(const Node::Term* t) {
+    struct TermVisitor {
+        BytecodeCompiler& comp;
+
+        int load(int64_t value) const {
+            const int reg = comp.new_reg();
+            comp.emit(bc::LOADI, reg, static_cast<int32_t>(value));
+            return reg;
+        }
+
+        int operator()(const Node::TermBooleanLiteral* term_bool_lit) const {
+            return load(term_bool_lit->value);
+        }
+
+        int operator()(const Node::TermIntegerLiteral* term_int_lit) const {
+            return load(term_int_lit->value);
+        }
+
+        int operator()(const Node::TermCharLiteral* term_char_lit) const {
+            return load(term_char_lit->char_lit.val.value()[0]);
+        }
+
+        int operator()(const Node::TermStringLiteral* term_string_lit) const {
+            return load(comp.string_index(term_string_lit->string_lit.val.value()));
+        }
+
+        int operator()(const Node::TermIdentifier* term_ident) const {
+            const std::string_view name = term_ident->ident.val.value();
+
+            for (auto it = comp.locals.rbegin(); it != comp.locals.rend(); it++) {
+                if (const auto var = it->find(name); var != it->end())
+                    return var->second;
+            }
+
+            const auto var = comp.globals.find(name);
+            if (var == comp.globals.end())
+                comp.exit_with("unknown variable `" + std::string(name) + "`");
+
+            const int reg = comp.new_reg();
+            comp.emit(bc::GETG, reg, var->second);
+            return reg;
+        }
+
+        int operator()(const Node::FuncCall* fcall) const {
+            return comp.call(fcall);
+        }
+
+        int operator()(const Node::TermParen* term_paren) const {
+            return comp.expr(term_paren->expr);
+        }
+    };
+
+    return std::visit(TermVisitor{ *this }, t->var);
+}
+
+void BytecodeCompiler::step(const Node::TermIdentifier* ident, int delta, int old) {
+    const std::string_view name = ident->ident.val.value();
+
+    for (auto it = locals.rbegin(); it != locals.rend(); it++) {
+        if (const auto var = it->find(name); var != it->end()) {
+            if (old >= 0)
+                emit(bc::MOV, old, var->second);
+            emit(bc::ADDI, var->second, var->second, delta);
+            return;
+        }
+    }
+
+    const auto var = globals.find(name);
+    if (var == globals.end())
+        exit_with("unknown variable `" + std::string(name) + "`");
+
+    const int saved = reg_top;
+    const int reg = old >= 0 ? old : new_reg();
+    const int next = new_reg();
+
+    emit(bc::GETG, reg, var->second);
+    emit(bc::ADDI, next, reg, delta);
+    emit(bc::SETG, var->second, next);
+    reg_top = saved;
+}
+
+int BytecodeCompiler::call(const Node::FuncCall* fcall) {
+    const std::string_view name = fcall->ident.val.value();
+
+    if (name == "print" || name == "println") {
+        for (const Node::Expr* arg : fcall->args) {
+            const int saved = reg_top;
+            const int reg = expr(arg);
+
+            switch (arg->type) {
+            case VarType::INT:
+            case VarType::BOOL:
+                emit(bc::PRINTI, reg);
+                break;
+            case VarType::CHAR:
+                emit(bc::PRINTC, reg);
+                break;
+            case VarType::STRING:
+                emit(bc::PRINTS, reg);
+                break;
+            default:
+                exit_with("cannot print a void expression");
+            }
+
+            reg_top = saved;
+        }
+
+        if (name == "println")
+            emit(bc::PRINTLN);
+        return -1;
+    }
+
+    if (name == "itoc" || name == "ctoi") {
+        if (fcall->args.size() != 1)
+            exit_with("function `" + std::string(name) + "` require one argument");
+
+        const int arg = expr(fcall->args[0]);
+        const int dst = new_reg();
+        emit(name == "itoc" ? bc::ITOC : bc::CTOI, dst, arg);
+        return dst;
+    }
+
+    if (!fcall->args.empty())
+        exit_with("function `" + std::string(name) + "` takes no argument");
+
+    const auto f = functions.find(name);
+    if (f == functions.end())
+        exit_with("unknown function `" + std::string(name) + "`");
+
+    const int dst = new_reg();
+    emit(bc::CALL, dst, f->second);
+    return dst;
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "parser.h"
+
+namespace bc {
+    /// @brief register machine opcodes, operands are registers of the current frame unless noted
+    enum OpCode : uint8_t {
+        LOADI,      // a = imm b
+        MOV,        // a = b
+        GETG,       // a = globals[b]
+        SETG,       // globals[a] = b
+        ADD,        // a = b + c
+        SUB,        // a = b - c
+        MUL,        // a = b * c
+        DIV,        // a = b / c
+        ADDI,       // a = b + imm c
+        MULI,       // a = b * imm c
+        EQ,         // a = b == c
+        NE,         // a = b != c
+        LT,         // a = b < c
+        LE,         // a = b <= c
+        GT,         // a = b > c
+        GE,         // a = b >= c
+        EQI,        // a = b == imm c
+        NEI,        // a = b != imm c
+        LTI,        // a = b < imm c
+        LEI,        // a = b <= imm c
+        GTI,        // a = b > imm c
+        GEI,        // a = b >= imm c
+        NOT,        // a = !b
+        TEST,       // a = b != 0
+        ITOC,       // a = (char)(b + '0')
+        CTOI,       // a = b - '0'
+        JMP,        // pc = a
+        JMPF,       // if !a: pc = b
+        JMPT,       // if a: pc = b
+        CALL,       // a = functions[b]()
+        RET,        // return a
+        RETV,       // return (void)
+        PRINTI,     // print a as an int
+        PRINTC,     // print a as a char
+        PRINTS,     // print strings[a]
+        PRINTLN,    // print a new line and flush
+        HALT,       // stop, a is the exit status
+        OP_COUNT
+    };
+
+    struct Instr {
+        OpCode op;
+        int32_t a = 0;
+        int32_t b = 0;
+        int32_t c = 0;
+    };
+
+    struct Function {
+        std::string_view name;
+        VarType type;
+        /// @brief index of the first instruction
+        size_t entry = 0;
+        /// @brief index past the last instruction
+        size_t end = 0;
+        /// @brief registers used by a call (locals and temporaries)
+        int frame_size = 0;
+    };
+
+    /// @brief compiled program, function 0 initializes the globals then calls main
+    struct Program {
+        std::vector<Instr> code;
+        std::vector<Function> functions;
+        /// @brief string constants with their escapes decoded, a string value is an index in this table
+        /// (0 is the empty string); literals are deduplicated so equal strings have equal indices
+        std::vector<std::string> strings;
+        size_t num_globals = 0;
+    };
+}
+
+/// @brief lowers a program to register bytecode run by the VM (see vm.h)
+class BytecodeCompiler {
+private:
+    bc::Program program;
+
+    /// @brief index of the function being compiled
+    size_t current = 0;
+
+    std::unordered_map<std::string_view, int> globals;
+    std::unordered_map<std::string_view, int> functions;
+    std::unordered_map<std::string, int> strings;
+
+    /// @brief registers of the locals, one map per open scope
+    std::vector<std::unordered_map<std::string_view, int>> locals;
+
+    /// @brief first free register of the current frame
+    int reg_top = 0;
+
+    [[noreturn]] void exit_with(const std::string& err_msg);
+
+    /// @brief append an instruction and return its index
+    size_t emit(bc::OpCode op, int32_t a = 0, int32_t b = 0, int32_t c = 0);
+
+    /// @brief make a jump emitted at index `at` land on the next instruction
+    void patch(size_t at);
+
+    int new_reg();
+
+    int string_index(std::string_view lit);
+
+    void begin_function(std::string_view name, VarType type);
+
+    void end_function();
+
+    void func(const Node::FuncDeclaration* f);
+
+    void global(const Token& ident, VarType type, const Node::Expr* e);
+
+    void local(const Token& ident, VarType type, const Node::Expr* e);
+
+    void assign(std::string_view name, const Node::Expr* e);
+
+    void scope(const Node::Scope* sc);
+
+    void scope_stmt(const Node::ScopeStmt* s);
+
+    void if_pred(const Node::IfPred* pred, std::vector<size_t>& exits);
+
+    /// @brief compile an expression
+    /// @return the register holding its value (a local register or a fresh temporary)
+    int expr(const Node::Expr* e);
+
+    /// @brief compile an expression into a given register
+    void expr_to(const Node::Expr* e, int dst);
+
+    int bin_expr(const Node::BinExpr* bin);
+
+    /// @brief value of an int, char or bool literal, usable as an immediate operand
+    std::optional<int32_t> immediate(const Node::Expr* e);
+
+    int term(const Node::Term* t);
+
+    /// @brief increment or decrement a variable
+    /// @param old register receiving the value before the update (-1 to ignore it)
+    void step(const Node::TermIdentifier* ident, int delta, int old);
+
+    /// @return register holding the result (-1 for void calls)
+    int call(const Node::FuncCall* fcall);
+
+public:
+    bc::Program compile(const Node::Prog& p);
+};
@@ -0,0 +1,293 @@
+#include "cache.h"
+
+#include <atomic>
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include <unistd.h>
+
+#include "native.h"
+#include "parallel.h"
+
+namespace {
+    // flags of every g++ call compiling generated code
+    const std::vector<std::string> cxx = { "g++", "-std=c++23", "-Wall", "-Wextra" };
+
+    // word mixers of the two lanes, multiply-rotate steps with different constants so the lanes stay independent
+    uint64_t mix0(uint64_t h, uint64_t w) {
+        h ^= w * 0x9E3779B97F4A7C15ull;
+        return std::rotl(h, 31) * 0xBF58476D1CE4E5B9ull;
+    }
+
+    uint64_t mix1(uint64_t h, uint64_t w) {
+        h ^= w * 0xC2B2AE3D27D4EB4Full;
+        return std::rotl(h, 29) * 0x94D049BB133111EBull;
+    }
+
+    // final avalanche, every bit of the lane flips about half of the output bits
+    uint64_t finish(uint64_t h) {
+        h ^= h >> 30;
+        h *= 0xBF58476D1CE4E5B9ull;
+        h ^= h >> 27;
+        h *= 0x94D049BB133111EBull;
+        return h ^ (h >> 31);
+    }
+
+    std::string hex(uint64_t v) {
+        static constexpr char digits[] = "0123456789abcdef";
+
+        std::string s(16, '0');
+        for (int i = 15; i >= 0; i--, v >>= 4)
+            s[i] = digits[v & 0xf];
+        return s;
+    }
+}
+
+ContentHash::ContentHash()
+    : lanes{ 0x243F6A8885A308D3ull, 0x13198A2E03707344ull } {
+}
+
+void ContentHash::add(std::string_view data) {
+    lanes[0] = mix0(lanes[0], data.size());
+    lanes[1] = mix1(lanes[1], data.size());
+
+    size_t i = 0;
+    for (; i + 8 <= data.size(); i += 8) {
+        uint64_t w;
+        std::memcpy(&w, data.data() + i, 8);
+        lanes[0] = mix0(lanes[0], w);
+        lanes[1] = mix1(lanes[1], w);
+    }
+
+    // the size is mixed in already, the tail is zero padded
+    if (i < data.size()) {
+        uint64_t w = 0;
+        std::memcpy(&w, data.data() + i, data.size() - i);
+        lanes[0] = mix0(lanes[0], w);
+        lanes[1] = mix1(lanes[1], w);
+    }
+}
+
+std::string ContentHash::hex() const {
+    return ::hex(finish(lanes[0])) + ::hex(finish(lanes[1]));
+}
+
+BuildCache::BuildCache(bool verbose, bool enabled)
+    : verbose(verbose) {
+    if (!enabled)
+        return;
+
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg != nullptr && *xdg != '\0')
+        root = std::filesystem::path(xdg) / "cern";
+    else if (const char* home = std::getenv("HOME"); home != nullptr && *home != '\0')
+        root = std::filesystem::path(home) / ".cache" / "cern";
+
+    std::error_code ec;
+    if (!root.empty() && !std::filesystem::create_directories(root, ec) && ec)
+        root.clear();
+
+    if (root.empty() && verbose)
+        std::cerr << "[Cache] no cache directory, the build is not cached" << std::endl;
+}
+
+void BuildCache::add(std::string_view data) {
+    hash.add(data);
+}
+
+const std::string& BuildCache::compiler_id() {
+    if (!compiler.empty())
+        return compiler;
+
+    std::error_code ec;
+    const uintmax_t size = std::filesystem::file_size("/proc/self/exe", ec);
+
+    std::string content(ec ? 0 : size, '\0');
+    std::ifstream("/proc/self/exe", std::ios::binary).read(content.data(), static_cast<std::streamsize>(content.size()));
+
+    // without the executable, the build time of this file is the best guess of the version
+    ContentHash h;
+    h.add(content.empty() ? std::string_view(__DATE__ " " __TIME__) : std::string_view(content));
+    compiler = h.hex();
+
+    return compiler;
+}
+
+const std::string& BuildCache::toolchain() {
+    if (!gxx.empty())
+        return gxx;
+
+    // empty if g++ cannot be run, the compilation fails later anyway
+    if (!native::capture({ "g++", "--version" }, gxx))
+        gxx.clear();
+
+    return gxx;
+}
+
+void BuildCache::add_compiler() {
+    add(compiler_id());
+}
+
+std::string BuildCache::count(bool hit) const {
+    const std::filesystem::path path = root / "stats";
+    long hits = 0;
+    long misses = 0;
+
+    {
+        std::ifstream in(path);
+        in >> hits >> misses;
+    }
+
+    (hit ? hits : misses)++;
+
+    // concurrent builds may lose a count, the stats are only indicative
+    std::ofstream(path) << hits << " " << misses << "\n";
+
+    return std::to_string(hits) + " hits, " + std::to_string(misses) + " misses";
+}
+
+bool BuildCache::restore(std::span<const std::string_view> files) {
+    key = hash.hex();
+
+    if (root.empty())
+        return false;
+
+    const std::filesystem::path entry = root / key;
+    std::error_code ec;
+    bool hit = std::filesystem::is_directory(entry, ec);
+
+    // a file missing from the entry is a miss, the build writes them all again
+    for (size_t i = 0; hit && i < files.size(); i++) {
+        std::filesystem::copy_file(entry / files[i], files[i], std::filesystem::copy_options::overwrite_existing, ec);
+        hit = !ec;
+    }
+
+    const std::string stats = count(hit);
+    if (verbose)
+        std::cerr << "[Cache] " << (hit ? "hit " : "miss ") << key << " (" << stats << ")" << std::endl;
+
+    return hit;
+}
+
+void BuildCache::store(std::span<const std::string_view> files) {
+    if (root.empty())
+        return;
+
+    // filled aside then renamed, so a concurrent build never sees a partial entry
+    const std::filesystem::path entry = root / key;
+    const std::filesystem::path staging = root / (key + ".tmp" + std::to_string(getpid()));
+    std::error_code ec;
+
+    std::filesystem::create_directory(staging, ec);
+    for (size_t i = 0; !ec && i < files.size(); i++)
+        std::filesystem::copy_file(files[i], staging / files[i], std::filesystem::copy_options::overwrite_existing, ec);
+
+    if (!ec)
+        std::filesystem::rename(staging, entry, ec);
+
+    // another build stored the same entry first, or a copy failed
+    if (ec)
+        std::filesystem::remove_all(staging, ec);
+    else if (verbose)
+        std::cerr << "[Cache] stored " << key << std::endl;
+}
+
+bool BuildCache::build(const Generator::Units& units, const std::string& exe_path) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+
+    // without a cache the objects only live for this build
+    const bool reuse = !root.empty();
+    const std::string suffix = "." + std::to_string(getpid());
+    const fs::path dir = reuse ? root / "objects" : fs::temp_directory_path(ec) / ("cern" + suffix);
+
+    fs::create_directories(dir, ec);
+    if (ec) {
+        std::cerr << "[Error] cannot create " << dir.string() << std::endl;
+        return false;
+    }
+
+    // written aside then renamed, a concurrent build may write the same file
+    auto write = [&](const std::string& path, std::string_view content) {
+        std::ofstream(path + suffix, std::ios::binary) << content;
+        fs::rename(path + suffix, path, ec);
+    };
+
+    // the objects of another cern or another g++ are never linked together
+    ContentHash header_hash;
+    header_hash.add(compiler_id());
+    header_hash.add(toolchain());
+    for (const std::string& flag : cxx)
+        header_hash.add(flag);
+    header_hash.add(units.header);
+
+    // g++ takes the .gch next to the included header, or the header itself if the .gch does not match
+    const std::string header = (dir / (header_hash.hex() + ".h")).string();
+    if (!fs::exists(header + ".gch", ec)) {
+        write(header, units.header);
+
+        std::vector<std::string> args = cxx;
+        args.insert(args.end(), { "-x", "c++-header", header, "-o", header + suffix + ".gch" });
+        if (native::run(args))
+            fs::rename(header + suffix + ".gch", header + ".gch", ec);
+    }
+
+    // an object is named by the hash of all its code
+    std::vector<std::string> objects(units.units.size());
+    std::vector<size_t> missing;
+
+    for (size_t i = 0; i < units.units.size(); i++) {
+        ContentHash h = header_hash;
+        h.add(units.units[i].header ? "header" : "");
+        h.add(units.units[i].code);
+
+        objects[i] = (dir / h.hex()).string();
+        if (!fs::exists(objects[i] + ".o", ec))
+            missing.push_back(i);
+    }
+
+    std::atomic<bool> failed{ false };
+    parallel_for(missing.size(), [&](size_t j) {
+        const std::string& base = objects[missing[j]];
+        std::error_code error;
+
+        std::ofstream(base + suffix + ".cpp", std::ios::binary) << units.units[missing[j]].code;
+
+        std::vector<std::string> args = cxx;
+        if (units.units[missing[j]].header)
+            args.insert(args.end(), { "-include", header });
+        args.insert(args.end(), { "-c", base + suffix + ".cpp", "-o", base + suffix + ".o" });
+        if (native::run(args))
+            fs::rename(base + suffix + ".o", base + ".o", error);
+        else
+            failed = true;
+
+        fs::remove(base + suffix + ".cpp", error);
+    });
+
+    if (verbose) {
+        std::cerr << "[Cache] " << units.units.size() - missing.size() << " of " << units.units.size()
+            << " units reused";
+        for (const size_t i : missing)
+            std::cerr << (i == missing.front() ? ", compiled " : " ") << units.units[i].name;
+        std::cerr << std::endl;
+    }
+
+    bool linked = false;
+    if (!failed) {
+        std::vector<std::string> args = { "g++" };
+        for (const std::string& base : objects)
+            args.push_back(base + ".o");
+        args.insert(args.end(), { "-o", exe_path });
+
+        linked = native::run(args);
+    }
+
+    if (!reuse)
+        fs::remove_all(dir, ec);
+
+    return linked;
+}
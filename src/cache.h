@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "generation.h"
+
+/// @brief 128 bit hash of some data (not cryptographic), the key of an entry of the cache
+class ContentHash {
+private:
+    /// @brief two 64 bit lanes seeded differently
+    uint64_t lanes[2];
+
+public:
+    ContentHash();
+
+    /// @brief mix some data into the hash (its size too, so two pieces cannot be shifted into each other)
+    void add(std::string_view data);
+
+    /// @return the hash in hex
+    std::string hex() const;
+};
+
+/// @brief on-disk cache of the builds, in $XDG_CACHE_HOME/cern or ~/.cache/cern: the files a build writes
+/// (the generated code and the executable), stored under a hash of everything they depend on, and the objects
+/// of the translation units of the incremental builds, stored under a hash of their code
+/// @note the keys mix the compiler executable itself (and the version of g++ for the objects), so any rebuild of
+/// cern starts a new set of entries; the entries are never evicted, removing the directory empties the cache
+class BuildCache {
+private:
+    /// @brief root of the cache (empty if there is no home to put it in, or the cache is disabled)
+    std::filesystem::path root;
+
+    ContentHash hash;
+
+    /// @brief hash of the compiler executable in hex, once `compiler_id` computed it
+    std::string compiler;
+
+    /// @brief output of `g++ --version`, once `toolchain` ran it
+    std::string gxx;
+
+    bool verbose;
+
+    /// @brief key of the entry in hex, once `restore` computed it
+    std::string key;
+
+    /// @brief add the hit or the miss to the counters of the cache
+    /// @return the updated counters as `<hits> hits, <misses> misses`
+    std::string count(bool hit) const;
+
+    /// @brief hash of the content of the running compiler in hex, computed on the first call
+    const std::string& compiler_id();
+
+    /// @brief version of the g++ compiling the generated code, as printed by `g++ --version`, run on the first call
+    const std::string& toolchain();
+
+public:
+    /// @param verbose print the hits, misses and stores on stderr
+    /// @param enabled false to neither read nor fill the cache (the incremental builds compile every unit)
+    BuildCache(bool verbose, bool enabled = true);
+
+    /// @brief mix some data into the key
+    void add(std::string_view data);
+
+    /// @brief mix the content of the running compiler into the key
+    void add_compiler();
+
+    /// @brief copy the files of the entry of the key into the working directory
+    /// @return false on a miss (nothing is copied)
+    bool restore(std::span<const std::string_view> files);
+
+    /// @brief save the files a successful build wrote in the working directory as the entry of the key
+    void store(std::span<const std::string_view> files);
+
+    /// @brief build an executable from translation units with g++, one object each: the objects of the units
+    /// already compiled (same code and header) are taken from the cache, only the others are compiled, on a pool
+    /// of threads, then everything is linked
+    /// @note the header is compiled once as a precompiled header
+    /// @return false if g++ failed
+    bool build(const Generator::Units& units, const std::string& exe_path);
+};
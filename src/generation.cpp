@@ -1,376 +1,555 @@
 #include "generation.h"
 
 #include "buildin.h"
+#include "parallel.h"
 
-#include <sstream>
 #include <cassert>
 #include <algorithm>
-#include <stack>
 
-namespace gen {
-    namespace {
-        std::stringstream output;
-
-        std::stringstream current_scope;
-        std::stack<std::stringstream> scope_stack;
+namespace {
+    // start of the generated code
+    constexpr std::string_view header = "#include <iostream>\n#include <string>\n\nusing namespace std;\n\n";
 
-        std::string indentation;
+    // the standard library only appears as std::cout (print, println) and as the string type, the units without
+    // them skip parsing the includes; a string literal naming them is a false positive costing only time
+    bool uses_std(std::string_view code) {
+        return code.find("std::") != std::string_view::npos || code.find("string") != std::string_view::npos;
     }
 
-    void begin_scope() {
-        scope_stack.emplace(current_scope.str());
-
-        current_scope.clear();
+    // the globals (by slot) and the functions a piece of code uses, declared at the top of its translation unit
+    struct References {
+        std::vector<bool> globals;
+        // in the order of their first call
+        std::vector<const Node::FuncDeclaration*> funcs;
+
+        void var(VarSlot slot) {
+            if (slot.global)
+                globals[slot.index] = true;
+        }
+
+        void call(const Node::FuncCall* fcall) {
+            // the buildin ones have no declaration
+            if (fcall->func != nullptr && std::ranges::find(funcs, fcall->func) == funcs.end())
+                funcs.push_back(fcall->func);
+
+            for (const Node::Expr* arg : fcall->args)
+                expr(arg);
+        }
+
+        void expr(const Node::Expr* e) {
+            struct ExprVisitor {
+                References& refs;
+
+                void operator()(const Node::Term* t) const {
+                    if (const auto ident = std::get_if<Node::TermIdentifier*>(&t->var))
+                        refs.var((*ident)->slot);
+                    else if (const auto fcall = std::get_if<Node::FuncCall*>(&t->var))
+                        refs.call(*fcall);
+                    else if (const auto paren = std::get_if<Node::TermParen*>(&t->var))
+                        refs.expr((*paren)->expr);
+                }
 
-        current_scope << indentation << "{\n";
+                void operator()(const Node::BinExpr* bin) const {
+                    refs.expr(bin->lside);
+                    refs.expr(bin->rside);
+                }
 
-        indentation += "  ";
-    }
+                void operator()(const Node::ExprNot* n) const {
+                    refs.expr(n->expr);
+                }
 
-    void end_scope() {
-        indentation.pop_back();
-        indentation.pop_back();
+                void operator()(const Node::VarIncr* i) const {
+                    refs.var(i->ident->slot);
+                }
 
-        current_scope << indentation << "}\n";
+                void operator()(const Node::VarDecr* d) const {
+                    refs.var(d->ident->slot);
+                }
+            };
 
-        scope_stack.top() << current_scope.str();
+            std::visit(ExprVisitor{ *this }, e->var);
+        }
 
-        current_scope.clear();
+        void scope(const Node::Scope* sc) {
+            struct ScopeStmtVisitor {
+                References& refs;
 
-        current_scope.copyfmt(scope_stack.top());
+                void operator()(const Node::Scope* s) const {
+                    refs.scope(s);
+                }
 
-        scope_stack.pop();
-    }
+                void operator()(const Node::StmtImplicitVar* stmt_var) const {
+                    refs.expr(stmt_var->expr);
+                }
 
-    void exit_with(const std::string& err_msg) {
-        std::cerr << "[Generation Error] " << err_msg << std::endl;
-        exit(EXIT_FAILURE);
-    }
+                void operator()(const Node::StmtExplicitVar*) const {
+                }
 
-    std::string prog(const Node::Prog p) {
-        output << "#include <iostream>" << std::endl;
-        output << "#include <string>" << std::endl;
+                void operator()(const Node::StmtVarAssign* var_assign) const {
+                    refs.var(var_assign->slot);
+                    refs.expr(var_assign->expr);
+                }
 
-        output << std::endl;
+                void operator()(const Node::FuncCall* fcall) const {
+                    refs.call(fcall);
+                }
 
-        output << "using namespace std;" << std::endl;
+                void operator()(const Node::VarIncr* i) const {
+                    refs.var(i->ident->slot);
+                }
 
-        output << std::endl;
+                void operator()(const Node::VarDecr* d) const {
+                    refs.var(d->ident->slot);
+                }
 
-        for (const Node::ProgStmt* s : p.stmts)
-            prog_stmt(s);
+                void operator()(const Node::StmtReturn* stmt_return) const {
+                    refs.expr(stmt_return->expr);
+                }
 
-        output << current_scope.str();
+                void operator()(const Node::StmtWhile* w) const {
+                    refs.expr(w->expr);
+                    refs.scope(w->scope);
+                }
 
-        return output.str();
-    }
+                void operator()(const Node::StmtIf* stmt_if) const {
+                    refs.expr(stmt_if->expr);
+                    refs.scope(stmt_if->scope);
+
+                    for (std::optional<Node::IfPred*> pred = stmt_if->pred; pred.has_value();) {
+                        if (const auto elif = std::get_if<Node::IfPredElif*>(&pred.value()->var)) {
+                            refs.expr((*elif)->expr);
+                            refs.scope((*elif)->scope);
+                            pred = (*elif)->pred;
+                        } else {
+                            refs.scope(std::get<Node::IfPredElse*>(pred.value()->var)->scope);
+                            pred = {};
+                        }
+                    }
+                }
+            };
 
-    void prog_stmt(const Node::ProgStmt* s) {
-        struct ProgStmtVisitor {
-            void operator()(const Node::StmtImplicitVar* stmt_var) const {
-                current_scope << indentation;
-                current_scope << to_string(stmt_var->expr->type);
-                current_scope << " ";
-                current_scope << stmt_var->identifier.val.value();
-                current_scope << " = ";
-                current_scope << expr(stmt_var->expr);
-                current_scope << ";\n";
-            }
+            for (const Node::ScopeStmt* s : sc->stmts)
+                std::visit(ScopeStmtVisitor{ *this }, s->var);
+        }
+    };
+}
 
-            void operator()(const Node::StmtExplicitVar* stmt_var) const {
-                current_scope << indentation;
-                current_scope << to_string(stmt_var->type);
-                current_scope << " ";
-                current_scope << stmt_var->ident.val.value();
-                current_scope << ";\n";
-            }
+void Generator::indent() {
+    output.append(depth * 2, ' ');
+}
 
-            void operator()(const Node::FuncDeclaration* func) const {
-                current_scope << "\n";
-                current_scope << indentation;
-                current_scope << to_string(func->type);
-                current_scope << " ";
-                current_scope << func->ident.val.value();
-                current_scope << "()\n";
-                scope(func->scope);
-            }
-        };
+void Generator::begin_scope() {
+    indent();
+    output += "{\n";
 
-        ProgStmtVisitor visitor;
-        std::visit(visitor, s->var);
-    }
+    depth++;
+}
 
-    void scope(const Node::Scope* sc) {
-        begin_scope();
+void Generator::end_scope() {
+    depth--;
 
-        for (const Node::ScopeStmt* s : sc->stmts)
-            scope_stmt(s);
+    indent();
+    output += "}\n";
+}
 
-        end_scope();
-    }
+std::string Generator::prog(const Node::Prog& p) {
+    // the declarations are independent, each one is generated into a buffer of its own
+    std::vector<std::string> parts(p.stmts.size());
 
-    void scope_stmt(const Node::ScopeStmt* s) {
-        struct ScopeStmtVisitor {
-            void operator()(const Node::StmtReturn* stmt_return) const {
-                current_scope << indentation;
-                current_scope << "return " << expr(stmt_return->expr) << ";\n";
-            }
+    parallel_for(p.stmts.size(), [&](size_t i) {
+        Generator g;
+        g.prog_stmt(p.stmts[i]);
+        parts[i] = std::move(g.output);
+    });
 
-            void operator()(const Node::StmtImplicitVar* stmt_var) const {
-                current_scope << indentation;
-                current_scope << to_string(stmt_var->expr->type);
-                current_scope << " ";
-                current_scope << stmt_var->identifier.val.value();
-                current_scope << " = ";
-                current_scope << expr(stmt_var->expr);
-                current_scope << ";\n";
-            }
+    output.clear();
+    depth = 0;
 
-            void operator()(const Node::StmtExplicitVar* stmt_var) const {
-                current_scope << indentation;
-                current_scope << to_string(stmt_var->type);
-                current_scope << " ";
-                current_scope << stmt_var->ident.val.value();
-                current_scope << ";\n";
-            }
+    output += header;
 
-            void operator()(const Node::StmtVarAssign* var_assign) const {
-                current_scope << indentation;
-                current_scope << var_assign->ident.val.value();
-                current_scope << " = ";
-                current_scope << expr(var_assign->expr);
-                current_scope << ";\n";
-            }
+    size_t size = output.size();
+    for (const std::string& part : parts)
+        size += part.size();
+    output.reserve(size);
 
-            void operator()(const Node::FuncCall* fcall) const {
-                if (const auto f = call_func(fcall->ident.val.value(), fcall->args)) {
-                    current_scope << indentation;
-                    current_scope << f.value();
-                    return;
-                }
+    for (const std::string& part : parts)
+        output += part;
 
-                current_scope << indentation;
-                current_scope << fcall->ident.val.value();
-                current_scope << " (";
+    return std::move(output);
+}
 
-                if (!fcall->args.empty()) {
-                    current_scope << expr(fcall->args[0]);
+Generator::Units Generator::units(const Node::Prog& p) {
+    // declaration of each global by slot, for the units using it
+    std::vector<std::string> globals(p.global_slots);
+    std::vector<const Node::ProgStmt*> vars;
+    std::vector<const Node::ProgStmt*> funcs;
+
+    for (const Node::ProgStmt* s : p.stmts) {
+        if (std::holds_alternative<Node::FuncDeclaration*>(s->var)) {
+            funcs.push_back(s);
+        } else if (const auto v = std::get_if<Node::StmtImplicitVar*>(&s->var)) {
+            globals[(*v)->slot.index] = to_string((*v)->expr->type) + " " + std::string((*v)->identifier.val.value());
+            vars.push_back(s);
+        } else {
+            const Node::StmtExplicitVar* e = std::get<Node::StmtExplicitVar*>(s->var);
+            globals[e->slot.index] = to_string(e->type) + " " + std::string(e->ident.val.value());
+            vars.push_back(s);
+        }
+    }
 
-                    for (size_t i = 1; i < fcall->args.size(); i++) {
-                        current_scope << ", " << expr(fcall->args[i]);
-                    }
-                }
+    // the declarations a unit needs, then its definitions
+    auto declare = [&](const References& refs, std::string& out) {
+        for (size_t i = 0; i < refs.globals.size(); i++) {
+            if (refs.globals[i]) {
+                out += "extern ";
+                out += globals[i];
+                out += ";\n";
+            }
+        }
+
+        for (const Node::FuncDeclaration* f : refs.funcs) {
+            out += to_string(f->type);
+            out += " ";
+            out += f->ident.val.value();
+            out += "();\n";
+        }
+    };
+
+    const size_t first = vars.empty() ? 0 : 1;
+    Units u{ std::string(header), std::vector<Unit>(first + funcs.size()) };
+
+    // the globals stay in one unit, so they are initialized in declaration order as in a single file
+    if (!vars.empty()) {
+        References refs{ std::vector<bool>(p.global_slots) };
+        for (const Node::ProgStmt* s : vars) {
+            if (const auto v = std::get_if<Node::StmtImplicitVar*>(&s->var))
+                refs.expr((*v)->expr);
+        }
+
+        // they are defined here, only the functions are declared
+        refs.globals.assign(p.global_slots, false);
+
+        Generator g;
+        declare(refs, g.output);
+        for (const Node::ProgStmt* s : vars)
+            g.prog_stmt(s);
+
+        // always with the includes: <iostream> initializes std::cout before the initializers, which may print
+        u.units[0] = { "globals", std::move(g.output), true };
+    }
 
-                current_scope << ");\n";
-            }
+    parallel_for(funcs.size(), [&](size_t i) {
+        const Node::FuncDeclaration* f = std::get<Node::FuncDeclaration*>(funcs[i]->var);
+        References refs{ std::vector<bool>(p.global_slots) };
+        refs.scope(f->scope);
 
-            void operator()(const Node::VarIncr* i) const {
-                current_scope << indentation;
-                current_scope <<  i->ident->ident.val.value();
-                current_scope << "++;\n";
-            }
+        Generator g;
+        declare(refs, g.output);
+        g.prog_stmt(funcs[i]);
+        const bool std_lib = uses_std(g.output);
+        u.units[first + i] = { std::string(f->ident.val.value()), std::move(g.output), std_lib };
+    });
 
-            void operator()(const Node::VarDecr* d) const {
-                current_scope << indentation;
-                current_scope <<  d->ident->ident.val.value();
-                current_scope << "--;\n";
-            }
+    return u;
+}
 
-            void operator()(const Node::Scope* s) const {
-                scope(s);
-            }
+void Generator::prog_stmt(const Node::ProgStmt* s) {
+    struct ProgStmtVisitor {
+        Generator& g;
+
+        void operator()(const Node::StmtImplicitVar* stmt_var) const {
+            g.indent();
+            g.output += to_string(stmt_var->expr->type);
+            g.output += " ";
+            g.output += stmt_var->identifier.val.value();
+            g.output += " = ";
+            gen::expr(stmt_var->expr, g.output);
+            g.output += ";\n";
+        }
+
+        void operator()(const Node::StmtExplicitVar* stmt_var) const {
+            g.indent();
+            g.output += to_string(stmt_var->type);
+            g.output += " ";
+            g.output += stmt_var->ident.val.value();
+            g.output += ";\n";
+        }
+
+        void operator()(const Node::FuncDeclaration* func) const {
+            g.output += "\n";
+            g.indent();
+            g.output += to_string(func->type);
+            g.output += " ";
+            g.output += func->ident.val.value();
+            g.output += "()\n";
+            g.scope(func->scope);
+        }
+    };
+
+    std::visit(ProgStmtVisitor{ *this }, s->var);
+}
 
-            void operator()(const Node::StmtWhile* w) const {
-                current_scope << indentation;
-                current_scope << "while (";
-                current_scope << expr(w->expr);
-                current_scope << ")\n";
-                scope(w->scope);
-            }
+void Generator::scope(const Node::Scope* sc) {
+    begin_scope();
 
-            void operator()(const Node::StmtIf* stmt_if) const {
-                current_scope << indentation;
-                current_scope << "if (";
-                current_scope << expr(stmt_if->expr);
-                current_scope << ")\n";
-                scope(stmt_if->scope);
+    for (const Node::ScopeStmt* s : sc->stmts)
+        scope_stmt(s);
 
-                if (stmt_if->pred.has_value())
-                    if_pred(stmt_if->pred.value());
-            }
-        };
+    end_scope();
+}
 
-        ScopeStmtVisitor visitor;
-        std::visit(visitor, s->var);
-    }
+void Generator::scope_stmt(const Node::ScopeStmt* s) {
+    struct ScopeStmtVisitor {
+        Generator& g;
+
+        void operator()(const Node::StmtReturn* stmt_return) const {
+            g.indent();
+            g.output += "return ";
+            gen::expr(stmt_return->expr, g.output);
+            g.output += ";\n";
+        }
+
+        void operator()(const Node::StmtImplicitVar* stmt_var) const {
+            g.indent();
+            g.output += to_string(stmt_var->expr->type);
+            g.output += " ";
+            g.output += stmt_var->identifier.val.value();
+            g.output += " = ";
+            gen::expr(stmt_var->expr, g.output);
+            g.output += ";\n";
+        }
+
+        void operator()(const Node::StmtExplicitVar* stmt_var) const {
+            g.indent();
+            g.output += to_string(stmt_var->type);
+            g.output += " ";
+            g.output += stmt_var->ident.val.value();
+            g.output += ";\n";
+        }
+
+        void operator()(const Node::StmtVarAssign* var_assign) const {
+            g.indent();
+            g.output += var_assign->ident.val.value();
+            g.output += " = ";
+            gen::expr(var_assign->expr, g.output);
+            g.output += ";\n";
+        }
+
+        void operator()(const Node::FuncCall* fcall) const {
+            g.indent();
+
+            if (call_func(fcall->ident.val.value(), fcall->args, g.output))
+                return;
+
+            g.output += fcall->ident.val.value();
+            g.output += " (";
+            gen::args(fcall->args, g.output);
+            g.output += ");\n";
+        }
+
+        void operator()(const Node::VarIncr* i) const {
+            g.indent();
+            g.output += i->ident->ident.val.value();
+            g.output += "++;\n";
+        }
+
+        void operator()(const Node::VarDecr* d) const {
+            g.indent();
+            g.output += d->ident->ident.val.value();
+            g.output += "--;\n";
+        }
+
+        void operator()(const Node::Scope* s) const {
+            g.scope(s);
+        }
+
+        void operator()(const Node::StmtWhile* w) const {
+            g.indent();
+            g.output += "while (";
+            gen::expr(w->expr, g.output);
+            g.output += ")\n";
+            g.scope(w->scope);
+        }
+
+        void operator()(const Node::StmtIf* stmt_if) const {
+            g.indent();
+            g.output += "if (";
+            gen::expr(stmt_if->expr, g.output);
+            g.output += ")\n";
+            g.scope(stmt_if->scope);
+
+            if (stmt_if->pred.has_value())
+                g.if_pred(stmt_if->pred.value());
+        }
+    };
+
+    std::visit(ScopeStmtVisitor{ *this }, s->var);
+}
 
-    void if_pred(const Node::IfPred* pred) {
-        struct PredVisitor {
-            void operator()(const Node::IfPredElif* elif_pred) const {
-                current_scope << indentation;
-                current_scope << "else if (";
-                current_scope << expr(elif_pred->expr);
-                current_scope << ")\n";
-                scope(elif_pred->scope);
-
-                if (elif_pred->pred.has_value())
-                    if_pred(elif_pred->pred.value());
-            }
+void Generator::if_pred(const Node::IfPred* pred) {
+    struct PredVisitor {
+        Generator& g;
+
+        void operator()(const Node::IfPredElif* elif_pred) const {
+            g.indent();
+            g.output += "else if (";
+            gen::expr(elif_pred->expr, g.output);
+            g.output += ")\n";
+            g.scope(elif_pred->scope);
+
+            if (elif_pred->pred.has_value())
+                g.if_pred(elif_pred->pred.value());
+        }
+
+        void operator()(const Node::IfPredElse* else_pred) const {
+            g.indent();
+            g.output += "else\n";
+            g.scope(else_pred->scope);
+        }
+    };
+
+    std::visit(PredVisitor{ *this }, pred->var);
+}
 
-            void operator()(const Node::IfPredElse* else_pred) const {
-                current_scope << indentation;
-                current_scope << "else\n";
-                scope(else_pred->scope);
-            }
-        };
+namespace gen {
+    void exit_with(const std::string& err_msg) {
+        exit_with_error("[Generation Error] " + err_msg);
+    }
 
-        PredVisitor visitor;
-        std::visit(visitor, pred->var);
+    void args(std::span<Node::Expr* const> args, std::string& out) {
+        for (size_t i = 0; i < args.size(); i++) {
+            if (i > 0)
+                out += ", ";
+            expr(args[i], out);
+        }
     }
 
-    std::string expr(const Node::Expr* e) {
+    void expr(const Node::Expr* e, std::string& out) {
         struct ExprVisitor {
-            std::string result;
+            std::string& out;
 
-            void operator()(const Node::Term* t) {
-                result = term(t);
+            void operator()(const Node::Term* t) const {
+                term(t, out);
             }
 
-            void operator()(const Node::BinExpr* bin_e) {
-                result = bin_expr(bin_e);
+            void operator()(const Node::BinExpr* bin_e) const {
+                bin_expr(bin_e, out);
             }
-        
-            void operator()(const Node::ExprNot* e) {
-                result = "!" + expr(e->expr);
+
+            void operator()(const Node::ExprNot* e) const {
+                // `!` binds tighter in C++ than in the grammar, keep a binary operand grouped
+                const bool grouped = std::holds_alternative<Node::BinExpr*>(e->expr->var);
+                out += grouped ? "!(" : "!";
+                expr(e->expr, out);
+                if (grouped)
+                    out += ")";
             }
 
-            void operator()(const Node::VarIncr* i) {
-                result = i->ident->ident.val.value() + "++";
+            void operator()(const Node::VarIncr* i) const {
+                out += i->ident->ident.val.value();
+                out += "++";
             }
 
-            void operator()(const Node::VarDecr* d) {
-                result = d->ident->ident.val.value() + "--";
+            void operator()(const Node::VarDecr* d) const {
+                out += d->ident->ident.val.value();
+                out += "--";
             }
         };
 
-        ExprVisitor visitor;
-        std::visit(visitor, e->var);
-
-        return visitor.result;
+        std::visit(ExprVisitor{ out }, e->var);
     }
 
-    std::string bin_expr(const Node::BinExpr* bin) {
-        struct BinExprVisitor {
-            std::string result;
-
-            void operator()(const Node::BinExprAdd* add) {
-                result = expr(add->lside) + " + " + expr(add->rside);
-            }
-
-            void operator()(const Node::BinExprSub* sub) {
-                result = expr(sub->lside) + " - " + expr(sub->rside);
-            }
-
-            void operator()(const Node::BinExprMulti* multi) {
-                result = expr(multi->lside) + " * " + expr(multi->rside);
-            }
-
-            void operator()(const Node::BinExprDiv* div) {
-                result = expr(div->lside) + " / " + expr(div->rside);
-            }
-
-            void operator()(const Node::BinExprAnd* e) {
-                result = expr(e->lside) + " && " + expr(e->rside);
-            }
-
-            void operator()(const Node::BinExprOr* e) {
-                result = expr(e->lside) + " || " + expr(e->rside);
-            }
-
-            void operator()(const Node::BinExprIsEqual* e) {
-                result = expr(e->lside) + " == " + expr(e->rside);
-            }
-
-            void operator()(const Node::BinExprIsNotEqual* e) {
-                result = expr(e->lside) + " != " + expr(e->rside);
-            }
-
-            void operator()(const Node::BinExprGreaterOrEqual* e) {
-                result = expr(e->lside) + " >= " + expr(e->rside);
-            }
-
-            void operator()(const Node::BinExprGreater* e) {
-                result = expr(e->lside) + " > " + expr(e->rside);
-            }
-
-            void operator()(const Node::BinExprLowerOrEqual* e) {
-                result = expr(e->lside) + " <= " + expr(e->rside);
-            }
-
-            void operator()(const Node::BinExprLower* e) {
-                result = expr(e->lside) + " < " + expr(e->rside);
+    void bin_expr(const Node::BinExpr* bin, std::string& out) {
+        // C++ precedence of the operator, binary expressions are left associative
+        const auto cpp_prec = [](BinOp op) {
+            switch (op) {
+            case BinOp::MULTI:
+            case BinOp::DIV:
+                return 5;
+            case BinOp::ADD:
+            case BinOp::SUB:
+                return 4;
+            case BinOp::GREATER_OR_EQUAL:
+            case BinOp::GREATER:
+            case BinOp::LOWER_OR_EQUAL:
+            case BinOp::LOWER:
+                return 3;
+            case BinOp::IS_EQUAL:
+            case BinOp::IS_NOT_EQUAL:
+                return 2;
+            case BinOp::AND:
+                return 1;
+            default:
+                return 0;
             }
         };
 
-        BinExprVisitor visitor;
-        std::visit(visitor, bin->var);
+        // parenthesize an operand when C++ would group it differently than the parsed tree
+        const auto operand = [&](const Node::Expr* e, bool right) {
+            const auto sub = std::get_if<Node::BinExpr*>(&e->var);
+            const bool paren = sub != nullptr
+                && (cpp_prec((*sub)->op) < cpp_prec(bin->op) || (right && cpp_prec((*sub)->op) == cpp_prec(bin->op)));
+
+            if (paren)
+                out += "(";
+            expr(e, out);
+            if (paren)
+                out += ")";
+        };
 
-        return visitor.result;
+        operand(bin->lside, false);
+        out += " ";
+        out += to_string(bin->op);
+        out += " ";
+        operand(bin->rside, true);
     }
 
-    std::string term(const Node::Term* t) {
+    void term(const Node::Term* t, std::string& out) {
         struct TermVisitor {
-            std::string result;
+            std::string& out;
 
-            void operator()(const Node::TermBooleanLiteral* term_bool_lit) {
-                result = term_bool_lit->bool_lit.val.value();
+            void operator()(const Node::TermBooleanLiteral* term_bool_lit) const {
+                out += term_bool_lit->bool_lit.val.value();
             }
 
-            void operator()(const Node::TermIntegerLiteral* term_int_lit) {
-                result = term_int_lit->int_lit.val.value();
+            void operator()(const Node::TermIntegerLiteral* term_int_lit) const {
+                out += term_int_lit->int_lit.val.value();
             }
 
-            void operator()(const Node::TermCharLiteral* term_char_lit) {
-                result = "'" + term_char_lit->char_lit.val.value() + "'";
+            void operator()(const Node::TermCharLiteral* term_char_lit) const {
+                out += "'";
+                out += term_char_lit->char_lit.val.value();
+                out += "'";
             }
 
-            void operator()(const Node::TermStringLiteral* term_string_lit) {
-                result = "\"" + term_string_lit->string_lit.val.value() + "\"";
+            void operator()(const Node::TermStringLiteral* term_string_lit) const {
+                out += "\"";
+                out += term_string_lit->string_lit.val.value();
+                out += "\"";
             }
 
-            void operator()(const Node::TermIdentifier* term_ident) {
-                result = term_ident->ident.val.value();
+            void operator()(const Node::TermIdentifier* term_ident) const {
+                out += term_ident->ident.val.value();
             }
 
-            void operator()(const Node::FuncCall* fcall) {
-                if (const auto f = call_func(fcall->ident.val.value(), fcall->args)) {
-                    result = f.value();
+            void operator()(const Node::FuncCall* fcall) const {
+                if (call_func(fcall->ident.val.value(), fcall->args, out))
                     return;
-                }
 
-                result = " ";
-                result += fcall->ident.val.value();
-                result += "(";
-
-                if (!fcall->args.empty()) {
-                    result += expr(fcall->args[0]);
-
-                    for (size_t i = 1; i < fcall->args.size(); i++) {
-                        result += ", " + expr(fcall->args[i]);
-                    }
-                }
-
-                result += ")";
+                out += " ";
+                out += fcall->ident.val.value();
+                out += "(";
+                args(fcall->args, out);
+                out += ")";
             }
 
-            void operator()(const Node::TermParen* term_paren) {
-                result = "(" + expr(term_paren->expr) + ")";
+            void operator()(const Node::TermParen* term_paren) const {
+                out += "(";
+                expr(term_paren->expr, out);
+                out += ")";
             }
         };
 
-        TermVisitor visitor;
-        std::visit(visitor, t->var);
-
-        return visitor.result;
+        std::visit(TermVisitor{ out }, t->var);
     }
 }
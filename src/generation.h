@@ -1,27 +1,71 @@
 #pragma once
 
+#include <span>
+#include <string>
+#include <vector>
+
 #include "parser.h"
 
-namespace gen {
+/// @brief C++ backend walking the syntax tree; a generator holds the state of what it is generating, so
+/// several can run at once
+class Generator {
+private:
+    /// @brief buffer the code is appended to, in order
+    std::string output;
+
+    /// @brief current scope depth, each level is indented by two spaces
+    size_t depth = 0;
+
+    void indent();
+
     void begin_scope();
 
     void end_scope();
 
-    void exit_with(const std::string &err_msg);
+    void prog_stmt(const Node::ProgStmt* s);
 
-    std::string prog(const Node::Prog p);
+    void scope(const Node::Scope* sc);
 
-    void prog_stmt(const Node::ProgStmt *s);
+    void scope_stmt(const Node::ScopeStmt* s);
 
-    void scope(const Node::Scope *sc);
+    void if_pred(const Node::IfPred* pred);
 
-    void scope_stmt(const Node::ScopeStmt *s);
+public:
+    /// @brief translation unit of a program generated one function at a time
+    struct Unit {
+        /// @brief function defined, or `globals` for the unit defining the globals
+        std::string name;
+        std::string code;
+        /// @brief the code uses the standard library (`std::cout`, `string`), it is compiled with the header
+        bool header;
+    };
+
+    /// @brief a program as translation units compiled on their own and linked together
+    struct Units {
+        /// @brief includes of the units using the standard library, the same for every program
+        std::string header;
+        /// @brief the globals (with their initializers, in declaration order) then each function; a unit declares
+        /// the globals and the functions it uses, so its code only changes with them
+        std::vector<Unit> units;
+    };
+
+    /// @brief generate a whole program: every top-level declaration by a generator of its own, the functions
+    /// on a pool of threads, then their code is concatenated in declaration order
+    std::string prog(const Node::Prog& p);
+
+    /// @brief generate a program as translation units, on a pool of threads like `prog`
+    Units units(const Node::Prog& p);
+};
+
+// the expression emitters hold no state, they append to out instead of building intermediate strings
+namespace gen {
+    [[noreturn]] void exit_with(const std::string &err_msg);
 
-    void if_pred(const Node::IfPred *pred);
+    void args(std::span<Node::Expr *const> args, std::string &out);
 
-    std::string expr(const Node::Expr *e);
+    void expr(const Node::Expr *e, std::string &out);
 
-    std::string bin_expr(const Node::BinExpr *bin);
+    void bin_expr(const Node::BinExpr *bin, std::string &out);
 
-    std::string term(const Node::Term *t);
+    void term(const Node::Term *t, std::string &out);
 }
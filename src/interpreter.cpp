@@ -0,0 +1,230 @@
+#include "interpreter.h"
+
+namespace {
+    // int arithmetic wraps on 32 bits like the C++ backend's int
+    int64_t wrap(uint32_t v) {
+        return static_cast<int32_t>(v);
+    }
+}
+
+std::string Interpreter::string(Value v) {
+    // the default string value is empty
+    return v.str != nullptr ? unescape(*v.str) : std::string();
+}
+
+void Interpreter::exit_with(const std::string& err_msg) {
+    std::cout.flush();
+    std::cerr << "[Runtime Error] " << err_msg << std::endl;
+    exit(EXIT_FAILURE);
+}
+
+Interpreter::Value& Interpreter::var(VarSlot slot) {
+    return slot.global ? globals[slot.index] : stack[base + slot.index];
+}
+
+int Interpreter::run(const Node::Prog& p) {
+    const NodeTable table(p);
+    nodes = &table;
+
+    globals.assign(table.global_slots, Value{});
+
+    // the globals are initialized in declaration order, explicit ones start zeroed
+    for (const NodeTable::Index g : table.globals)
+        stmt(g);
+
+    if (table.main == NodeTable::NONE)
+        exit_with("no `main` function");
+
+    const Value status = call(table.main);
+    std::cout.flush();
+
+    return table.types[table.main] == VarType::VOID ? 0 : static_cast<int>(status.num);
+}
+
+Interpreter::Value Interpreter::call(NodeTable::Index f) {
+    const size_t caller_base = base;
+
+    base = stack.size();
+    stack.resize(base + nodes->imms[f]);
+
+    // falling off the end returns 0 (void functions ignore it)
+    const Value value = stmt(nodes->rhs[f]) ? ret : Value{};
+
+    stack.resize(base);
+    base = caller_base;
+
+    return value;
+}
+
+bool Interpreter::stmt(NodeTable::Index n) {
+    const NodeTable& t = *nodes;
+
+    switch (t.kinds[n]) {
+    case NodeTable::Kind::SCOPE:
+        for (NodeTable::Index i = t.lhs[n]; i < t.lhs[n] + t.rhs[n]; i++) {
+            if (stmt(t.lists[i]))
+                return true;
+        }
+        return false;
+    case NodeTable::Kind::RETURN:
+        ret = expr(t.lhs[n]);
+        return true;
+    case NodeTable::Kind::DECLARE:
+    case NodeTable::Kind::ASSIGN: {
+        const Value value = t.lhs[n] != NodeTable::NONE ? expr(t.lhs[n]) : Value{};
+        var(t.slot(n)) = value;
+        return false;
+    }
+    case NodeTable::Kind::WHILE:
+        while (expr(t.lhs[n]).num) {
+            if (stmt(t.rhs[n]))
+                return true;
+        }
+        return false;
+    case NodeTable::Kind::IF:
+        // an elif is an IF in the else branch
+        if (expr(t.lhs[n]).num)
+            return stmt(t.rhs[n]);
+        if (t.imms[n] != NodeTable::NONE)
+            return stmt(t.imms[n]);
+        return false;
+    default:
+        // a call or a step, its value is dropped
+        expr(n);
+        return false;
+    }
+}
+
+Interpreter::Value Interpreter::expr(NodeTable::Index n) {
+    const NodeTable& t = *nodes;
+
+    switch (t.kinds[n]) {
+    case NodeTable::Kind::BOOL_LIT:
+    case NodeTable::Kind::CHAR_LIT:
+    case NodeTable::Kind::INT_LIT:
+        return { t.imms[n] };
+    case NodeTable::Kind::STRING_LIT:
+        return { 0, &t.tokens[t.token_ids[n]].val.value() };
+    case NodeTable::Kind::VAR:
+        return var(t.slot(n));
+    case NodeTable::Kind::CALL:
+        return call(t.imms[n]);
+    case NodeTable::Kind::BIN:
+        return bin_expr(n);
+    case NodeTable::Kind::NOT:
+        return { !expr(t.lhs[n]).num };
+    case NodeTable::Kind::INCR:
+        return step(t.slot(n), 1);
+    case NodeTable::Kind::DECR:
+        return step(t.slot(n), -1);
+    case NodeTable::Kind::PRINT:
+    case NodeTable::Kind::PRINTLN:
+    case NodeTable::Kind::ITOC:
+    case NodeTable::Kind::CTOI:
+        return buildin_call(n);
+    default:
+        assert(false); // unreachable, statements are not values
+        return {};
+    }
+}
+
+Interpreter::Value Interpreter::bin_expr(NodeTable::Index n) {
+    const NodeTable& t = *nodes;
+    const BinOp op = static_cast<BinOp>(t.imms[n]);
+
+    // short circuit
+    if (op == BinOp::AND)
+        return { expr(t.lhs[n]).num && expr(t.rhs[n]).num };
+    if (op == BinOp::OR)
+        return { expr(t.lhs[n]).num || expr(t.rhs[n]).num };
+
+    const Value lhs = expr(t.lhs[n]);
+    const Value rhs = expr(t.rhs[n]);
+
+    if (lhs.str != nullptr || rhs.str != nullptr) {
+        if (op != BinOp::IS_EQUAL && op != BinOp::IS_NOT_EQUAL)
+            exit_with("only `==` and `!=` are supported on strings");
+
+        return { (string(lhs) == string(rhs)) == (op == BinOp::IS_EQUAL) };
+    }
+
+    const uint32_t l = static_cast<uint32_t>(lhs.num);
+    const uint32_t r = static_cast<uint32_t>(rhs.num);
+
+    switch (op) {
+    case BinOp::ADD:
+        return { wrap(l + r) };
+    case BinOp::SUB:
+        return { wrap(l - r) };
+    case BinOp::MULTI:
+        return { wrap(l * r) };
+    case BinOp::DIV:
+        if (rhs.num == 0)
+            exit_with("division by zero");
+        return { wrap(static_cast<uint32_t>(lhs.num / rhs.num)) };
+    case BinOp::IS_EQUAL:
+        return { lhs.num == rhs.num };
+    case BinOp::IS_NOT_EQUAL:
+        return { lhs.num != rhs.num };
+    case BinOp::GREATER_OR_EQUAL:
+        return { lhs.num >= rhs.num };
+    case BinOp::GREATER:
+        return { lhs.num > rhs.num };
+    case BinOp::LOWER_OR_EQUAL:
+        return { lhs.num <= rhs.num };
+    case BinOp::LOWER:
+        return { lhs.num < rhs.num };
+    default:
+        assert(false); // unreachable
+        return {};
+    }
+}
+
+Interpreter::Value Interpreter::step(VarSlot slot, int delta) {
+    Value& v = var(slot);
+    const Value old = v;
+
+    v.num = wrap(static_cast<uint32_t>(v.num) + static_cast<uint32_t>(delta));
+    return old;
+}
+
+Interpreter::Value Interpreter::buildin_call(NodeTable::Index n) {
+    const NodeTable& t = *nodes;
+    const NodeTable::Kind kind = t.kinds[n];
+
+    if (kind == NodeTable::Kind::PRINT || kind == NodeTable::Kind::PRINTLN) {
+        for (NodeTable::Index i = t.lhs[n]; i < t.lhs[n] + t.rhs[n]; i++) {
+            const NodeTable::Index arg = t.lists[i];
+            const Value value = expr(arg);
+
+            switch (t.types[arg]) {
+            case VarType::INT:
+            case VarType::BOOL:
+                std::cout << value.num;
+                break;
+            case VarType::CHAR:
+                std::cout << static_cast<char>(value.num);
+                break;
+            case VarType::STRING:
+                // a std::string built from a literal stops at its first NUL, like the C++ backend
+                std::cout << string(value).c_str();
+                break;
+            default:
+                exit_with("cannot print a void expression");
+            }
+        }
+
+        if (kind == NodeTable::Kind::PRINTLN)
+            std::cout << std::endl;
+        return {};
+    }
+
+    if (t.rhs[n] != 1)
+        exit_with("function `" + std::string(t.text(n)) + "` require one argument");
+
+    const int64_t arg = expr(t.lists[t.lhs[n]]).num;
+
+    if (kind == NodeTable::Kind::ITOC)
+        return { static_cast<int8_t>(arg + '0') };
+    return { wrap(static_cast<uint32_t>(arg - '0')) };
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vector>
+
+#include "node_table.h"
+
+/// @brief tree-walking interpreter running the program flattened into a NodeTable: variables are read and
+/// written through the slots resolved by the parser, so no identifier is looked up while running
+class Interpreter {
+private:
+    /// @brief int, bool and char values are held in num, a string points to the value of its literal
+    struct Value {
+        int64_t num = 0;
+        const std::string_view* str = nullptr;
+    };
+
+    std::vector<Value> globals;
+    /// @brief locals of the active calls, the frame of the running function starts at base
+    std::vector<Value> stack;
+    size_t base = 0;
+
+    /// @brief value of the return statement being unwound
+    Value ret{};
+
+    /// @brief the program being run, flattened
+    const NodeTable* nodes = nullptr;
+
+    [[noreturn]] void exit_with(const std::string& err_msg);
+
+    /// @brief decoded content of a string value
+    static std::string string(Value v);
+
+    Value& var(VarSlot slot);
+
+    /// @param f FUNC node of the function
+    Value call(NodeTable::Index f);
+
+    /// @brief run a statement (a SCOPE runs its statements in turn)
+    /// @return true once a return statement ran
+    bool stmt(NodeTable::Index n);
+
+    Value expr(NodeTable::Index n);
+
+    Value bin_expr(NodeTable::Index n);
+
+    /// @brief increment or decrement a variable
+    /// @return its value before the update
+    Value step(VarSlot slot, int delta);
+
+    Value buildin_call(NodeTable::Index n);
+
+public:
+    /// @brief run a whole program, its output goes to stdout
+    /// @return the exit status (the value returned by main)
+    int run(const Node::Prog& p);
+};
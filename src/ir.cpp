@@ -0,0 +1,854 @@
+#include "ir.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace ir {
+    namespace {
+        // blocks reachable from the entry, in postorder
+        std::vector<BlockId> postorder(const Function& f) {
+            std::vector<BlockId> order;
+            std::vector<bool> visited(f.blocks.size(), false);
+
+            // explicit stack of (block, successors visited): deep nests of loops do not recurse; the last successor
+            // is visited first so the first one (taken branch, loop body) follows its block in reverse postorder
+            std::vector<std::pair<BlockId, size_t>> stack{ { 0, 0 } };
+            visited[0] = true;
+
+            while (!stack.empty()) {
+                const BlockId b = stack.back().first;
+                const size_t next = stack.back().second++;
+
+                if (next < f.blocks[b].succs.size()) {
+                    const BlockId s = f.blocks[b].succs[f.blocks[b].succs.size() - 1 - next];
+                    if (!visited[s]) {
+                        visited[s] = true;
+                        stack.push_back({ s, 0 });
+                    }
+                }
+                else {
+                    order.push_back(b);
+                    stack.pop_back();
+                }
+            }
+
+            return order;
+        }
+
+        bool pure(const std::vector<Instr>& instrs, const Instr& instr) {
+            switch (instr.op) {
+            case Op::BIN: {
+                // a division traps on a zero divisor, it is only pure by a non-zero constant
+                if (instr.bin != BinOp::DIV)
+                    return true;
+                const Instr& divisor = instrs[instr.args[1]];
+                return divisor.op == Op::CONST && divisor.imm != 0;
+            }
+            case Op::CONST:
+            case Op::GLOBAL:
+            case Op::NOT:
+            case Op::ITOC:
+            case Op::CTOI:
+            case Op::PHI:
+                return true;
+            default:
+                return false;
+            }
+        }
+
+        size_t successors(Op op) {
+            switch (op) {
+            case Op::JUMP:
+                return 1;
+            case Op::BRANCH:
+                return 2;
+            default:
+                return 0;
+            }
+        }
+    }
+
+    void dominators(Function& f) {
+        const std::vector<BlockId> post = postorder(f);
+
+        // position of the reachable blocks in the postorder
+        std::vector<int> number(f.blocks.size(), -1);
+        for (size_t i = 0; i < post.size(); i++)
+            number[post[i]] = static_cast<int>(i);
+
+        f.order.assign(post.rbegin(), post.rend());
+
+        // Cooper, Harvey and Kennedy: iterate over the reverse postorder until the dominators are stable,
+        // the entry dominating itself while it runs
+        std::vector<BlockId> idom(f.blocks.size(), NO_BLOCK);
+        idom[0] = 0;
+
+        const auto intersect = [&](BlockId a, BlockId b) {
+            while (a != b) {
+                while (number[a] < number[b])
+                    a = idom[a];
+                while (number[b] < number[a])
+                    b = idom[b];
+            }
+            return a;
+        };
+
+        for (bool changed = true; changed;) {
+            changed = false;
+
+            for (const BlockId b : f.order) {
+                if (b == 0)
+                    continue;
+
+                BlockId new_idom = NO_BLOCK;
+                for (const BlockId p : f.blocks[b].preds) {
+                    if (idom[p] != NO_BLOCK)
+                        new_idom = new_idom == NO_BLOCK ? p : intersect(p, new_idom);
+                }
+
+                if (idom[b] != new_idom) {
+                    idom[b] = new_idom;
+                    changed = true;
+                }
+            }
+        }
+
+        for (Block& b : f.blocks) {
+            b.idom = NO_BLOCK;
+            b.children.clear();
+        }
+
+        for (const BlockId b : f.order) {
+            if (b != 0) {
+                f.blocks[b].idom = idom[b];
+                f.blocks[idom[b]].children.push_back(b);
+            }
+        }
+    }
+
+    bool dominates(const Function& f, BlockId a, BlockId b) {
+        for (; b != NO_BLOCK; b = f.blocks[b].idom) {
+            if (b == a)
+                return true;
+        }
+
+        return false;
+    }
+
+    bool verify(const Function& f) {
+        // position of every placed instruction in its block
+        std::vector<int> position(f.instrs.size(), -1);
+        for (const Block& b : f.blocks) {
+            for (size_t i = 0; i < b.instrs.size(); i++)
+                position[b.instrs[i]] = static_cast<int>(i);
+        }
+
+        const auto defined = [&](Value v) {
+            return v >= 0 && static_cast<size_t>(v) < f.instrs.size() && position[v] >= 0
+                && f.instrs[v].type != VarType::VOID;
+        };
+
+        for (BlockId id = 0; id < static_cast<BlockId>(f.blocks.size()); id++) {
+            const Block& b = f.blocks[id];
+
+            if (b.instrs.empty() || b.succs.size() != successors(f.instrs[b.instrs.back()].op))
+                return false;
+
+            for (const BlockId s : b.succs) {
+                if (std::ranges::count(f.blocks[s].preds, id) != 1)
+                    return false;
+            }
+            for (const BlockId p : b.preds) {
+                if (std::ranges::count(f.blocks[p].succs, id) != 1)
+                    return false;
+            }
+
+            for (size_t i = 0; i < b.instrs.size(); i++) {
+                const Instr& instr = f.instrs[b.instrs[i]];
+
+                if (instr.block != id || (instr.op >= Op::JUMP) != (i + 1 == b.instrs.size()))
+                    return false;
+
+                if (instr.op == Op::PHI) {
+                    if ((i > 0 && f.instrs[b.instrs[i - 1]].op != Op::PHI) || instr.args.size() != b.preds.size())
+                        return false;
+
+                    // used at the end of the predecessor
+                    for (size_t k = 0; k < instr.args.size(); k++) {
+                        if (!defined(instr.args[k]) || !dominates(f, f.instrs[instr.args[k]].block, b.preds[k]))
+                            return false;
+                    }
+                    continue;
+                }
+
+                for (const Value arg : instr.args) {
+                    if (!defined(arg))
+                        return false;
+
+                    const Instr& def = f.instrs[arg];
+                    if (def.block == id ? position[arg] >= static_cast<int>(i) : !dominates(f, def.block, id))
+                        return false;
+                }
+            }
+        }
+
+        return true;
+    }
+}
+
+void IRBuilder::exit_with(const std::string& err_msg) {
+    std::cerr << "[IR Error] " << err_msg << std::endl;
+    exit(EXIT_FAILURE);
+}
+
+ir::BlockId IRBuilder::new_block() {
+    f->blocks.emplace_back();
+    defs.emplace_back();
+    sealed.push_back(false);
+    incomplete_phis.emplace_back();
+
+    return static_cast<ir::BlockId>(f->blocks.size() - 1);
+}
+
+void IRBuilder::link(ir::BlockId from, ir::BlockId to) {
+    f->blocks[from].succs.push_back(to);
+    f->blocks[to].preds.push_back(from);
+}
+
+void IRBuilder::jump(ir::BlockId to) {
+    emit({ .op = ir::Op::JUMP });
+    link(current, to);
+}
+
+void IRBuilder::ret(ir::Value v) {
+    if (v == ir::NO_VALUE)
+        emit({ .op = ir::Op::RET });
+    else
+        emit({ .op = ir::Op::RET, .args = { v } });
+
+    // the statements after a return go to a block without predecessor, dropped at the end
+    current = new_block();
+    seal(current);
+}
+
+void IRBuilder::seal(ir::BlockId b) {
+    const std::vector<std::pair<int, ir::Value>> phis = std::move(incomplete_phis[b]);
+    incomplete_phis[b].clear();
+
+    for (const auto& [slot, phi] : phis)
+        add_phi_operands(slot, phi);
+
+    sealed[b] = true;
+}
+
+ir::Value IRBuilder::emit(ir::Instr instr) {
+    const ir::Value v = static_cast<ir::Value>(f->instrs.size());
+
+    instr.block = current;
+    f->instrs.push_back(std::move(instr));
+    f->blocks[current].instrs.push_back(v);
+
+    return v;
+}
+
+ir::Value IRBuilder::constant(VarType type, std::string_view text, int64_t imm) {
+    std::string key(1, static_cast<char>(type));
+    key += text;
+
+    if (const auto it = constants.find(key); it != constants.end())
+        return it->second;
+
+    // the entry dominates every block and has no phi
+    const ir::Value v = static_cast<ir::Value>(f->instrs.size());
+    f->instrs.push_back({ .op = ir::Op::CONST, .type = type, .text = text, .imm = imm, .block = 0 });
+    f->blocks[0].instrs.insert(f->blocks[0].instrs.begin(), v);
+
+    constants.emplace(std::move(key), v);
+    return v;
+}
+
+ir::Value IRBuilder::default_value(VarType type) {
+    switch (type) {
+    case VarType::BOOL:
+        return constant(type, "false", 0);
+    case VarType::CHAR:
+        return constant(type, "\\0", 0);
+    case VarType::STRING:
+        return constant(type, "", 0);
+    default:
+        return constant(VarType::INT, "0", 0);
+    }
+}
+
+void IRBuilder::write_var(int slot, ir::BlockId b, ir::Value v) {
+    defs[b][slot] = v;
+}
+
+ir::Value IRBuilder::read_var(int slot, ir::BlockId b) {
+    if (const auto it = defs[b].find(slot); it != defs[b].end())
+        return it->second;
+
+    return read_var_recursive(slot, b);
+}
+
+ir::Value IRBuilder::read_var_recursive(int slot, ir::BlockId b) {
+    const VarType type = slot_types[slot];
+    ir::Value v;
+
+    if (!sealed[b]) {
+        // more predecessors to come, the operands are added by `seal`
+        v = new_phi(b, type);
+        incomplete_phis[b].push_back({ slot, v });
+    }
+    else if (f->blocks[b].preds.size() == 1)
+        v = read_var(slot, f->blocks[b].preds[0]);
+    else if (f->blocks[b].preds.empty())
+        v = default_value(type); // unreachable code
+    else {
+        // written first so a loop reaching back here finds the phi
+        v = new_phi(b, type);
+        write_var(slot, b, v);
+        add_phi_operands(slot, v);
+    }
+
+    write_var(slot, b, v);
+    return v;
+}
+
+ir::Value IRBuilder::new_phi(ir::BlockId b, VarType type) {
+    const ir::Value v = static_cast<ir::Value>(f->instrs.size());
+
+    f->instrs.push_back({ .op = ir::Op::PHI, .type = type, .block = b });
+    f->blocks[b].instrs.insert(f->blocks[b].instrs.begin(), v);
+
+    return v;
+}
+
+void IRBuilder::add_phi_operands(int slot, ir::Value phi) {
+    const ir::BlockId b = f->instrs[phi].block;
+
+    // reading may add instructions, no reference is kept across it
+    for (size_t i = 0; i < f->blocks[b].preds.size(); i++) {
+        const ir::Value v = read_var(slot, f->blocks[b].preds[i]);
+        f->instrs[phi].args.push_back(v);
+    }
+}
+
+void IRBuilder::begin_function(int32_t index, std::string_view name, VarType type, int frame_slots) {
+    f = &module.functions[index];
+    f->name = name;
+    f->type = type;
+
+    defs.clear();
+    sealed.clear();
+    incomplete_phis.clear();
+    constants.clear();
+    slot_types.assign(frame_slots, VarType::INT);
+
+    current = new_block();
+    seal(current);
+}
+
+void IRBuilder::end_function() {
+    ret(f->type == VarType::VOID ? ir::NO_VALUE : default_value(f->type));
+
+    std::vector<ir::Block>& blocks = f->blocks;
+    std::vector<ir::Instr>& instrs = f->instrs;
+
+    // reachable blocks, renumbered in reverse postorder
+    f->order.clear();
+    ir::dominators(*f);
+
+    std::vector<ir::BlockId> renumber(blocks.size(), ir::NO_BLOCK);
+    for (size_t i = 0; i < f->order.size(); i++)
+        renumber[f->order[i]] = static_cast<ir::BlockId>(i);
+
+    // forget the edges from unreachable blocks, with the matching phi operands
+    for (const ir::BlockId b : f->order) {
+        std::vector<ir::BlockId>& preds = blocks[b].preds;
+
+        for (size_t k = preds.size(); k-- > 0;) {
+            if (renumber[preds[k]] != ir::NO_BLOCK)
+                continue;
+
+            for (const ir::Value v : blocks[b].instrs) {
+                if (instrs[v].op == ir::Op::PHI)
+                    instrs[v].args.erase(instrs[v].args.begin() + k);
+            }
+            preds.erase(preds.begin() + k);
+        }
+    }
+
+    // a phi whose operands are all the same value (or the phi itself) is that value
+    std::vector<ir::Value> replacement(instrs.size());
+    std::iota(replacement.begin(), replacement.end(), 0);
+
+    const auto find = [&](ir::Value v) {
+        while (replacement[v] != v)
+            v = replacement[v];
+        return v;
+    };
+
+    for (bool changed = true; changed;) {
+        changed = false;
+
+        for (const ir::BlockId b : f->order) {
+            for (size_t i = 0; i < blocks[b].instrs.size(); i++) {
+                const ir::Value phi = blocks[b].instrs[i];
+                if (instrs[phi].op != ir::Op::PHI || find(phi) != phi)
+                    continue;
+
+                ir::Value same = ir::NO_VALUE;
+                bool trivial = true;
+                for (const ir::Value arg : instrs[phi].args) {
+                    const ir::Value v = find(arg);
+                    if (v == phi || v == same)
+                        continue;
+                    if (same != ir::NO_VALUE)
+                        trivial = false;
+                    same = v;
+                }
+
+                if (!trivial)
+                    continue;
+
+                // only reaches itself, the variable was never set
+                if (same == ir::NO_VALUE) {
+                    same = default_value(instrs[phi].type);
+                    for (ir::Value v = static_cast<ir::Value>(replacement.size()); v < static_cast<ir::Value>(instrs.size()); v++)
+                        replacement.push_back(v);
+                }
+
+                replacement[phi] = same;
+                changed = true;
+            }
+        }
+    }
+
+    // the values an effect, a branch or a return depends on
+    std::vector<bool> live(instrs.size(), false);
+    std::vector<ir::Value> work;
+
+    for (const ir::BlockId b : f->order) {
+        for (const ir::Value v : blocks[b].instrs) {
+            if (!ir::pure(instrs, instrs[v]) && find(v) == v) {
+                live[v] = true;
+                work.push_back(v);
+            }
+        }
+    }
+
+    while (!work.empty()) {
+        const ir::Value v = work.back();
+        work.pop_back();
+
+        for (ir::Value& arg : instrs[v].args) {
+            arg = find(arg);
+            if (!live[arg]) {
+                live[arg] = true;
+                work.push_back(arg);
+            }
+        }
+    }
+
+    // number the values left block by block
+    std::vector<ir::Block> new_blocks(f->order.size());
+    std::vector<ir::Instr> new_instrs;
+    std::vector<ir::Value> new_value(instrs.size(), ir::NO_VALUE);
+
+    for (size_t i = 0; i < f->order.size(); i++) {
+        const ir::Block& old = blocks[f->order[i]];
+        ir::Block& b = new_blocks[i];
+
+        for (const ir::BlockId p : old.preds)
+            b.preds.push_back(renumber[p]);
+        for (const ir::BlockId s : old.succs)
+            b.succs.push_back(renumber[s]);
+
+        for (const ir::Value v : old.instrs) {
+            if (!live[v] || find(v) != v)
+                continue;
+
+            new_value[v] = static_cast<ir::Value>(new_instrs.size());
+            b.instrs.push_back(new_value[v]);
+            new_instrs.push_back(std::move(instrs[v]));
+            new_instrs.back().block = static_cast<ir::BlockId>(i);
+        }
+    }
+
+    for (ir::Instr& instr : new_instrs) {
+        for (ir::Value& arg : instr.args)
+            arg = new_value[arg];
+    }
+
+    blocks = std::move(new_blocks);
+    instrs = std::move(new_instrs);
+
+    ir::dominators(*f);
+    assert(ir::verify(*f));
+}
+
+void IRBuilder::scope(const Node::Scope* sc) {
+    for (const Node::ScopeStmt* s : sc->stmts)
+        scope_stmt(s);
+}
+
+void IRBuilder::scope_stmt(const Node::ScopeStmt* s) {
+    struct ScopeStmtVisitor {
+        IRBuilder& builder;
+
+        void operator()(const Node::StmtReturn* stmt_return) const {
+            builder.ret(builder.expr(stmt_return->expr));
+        }
+
+        void operator()(const Node::StmtImplicitVar* stmt_var) const {
+            builder.assign(stmt_var->slot, builder.expr(stmt_var->expr));
+        }
+
+        void operator()(const Node::StmtExplicitVar* stmt_var) const {
+            builder.assign(stmt_var->slot, builder.default_value(stmt_var->type));
+        }
+
+        void operator()(const Node::StmtVarAssign* var_assign) const {
+            builder.assign(var_assign->slot, builder.expr(var_assign->expr));
+        }
+
+        void operator()(const Node::FuncCall* fcall) const {
+            builder.call(fcall);
+        }
+
+        void operator()(const Node::VarIncr* i) const {
+            builder.step(i->ident, 1);
+        }
+
+        void operator()(const Node::VarDecr* d) const {
+            builder.step(d->ident, -1);
+        }
+
+        void operator()(const Node::Scope* s) const {
+            builder.scope(s);
+        }
+
+        void operator()(const Node::StmtWhile* w) const {
+            // the header is sealed once the body jumped back to it
+            const ir::BlockId header = builder.new_block();
+            builder.jump(header);
+            builder.current = header;
+
+            const ir::BlockId body = builder.new_block();
+            const ir::BlockId exit = builder.new_block();
+            builder.branch(w->expr, body, exit);
+            builder.seal(body);
+            builder.seal(exit);
+
+            builder.current = body;
+            builder.scope(w->scope);
+            builder.jump(header);
+            builder.seal(header);
+
+            builder.current = exit;
+        }
+
+        void operator()(const Node::StmtIf* stmt_if) const {
+            const ir::BlockId then = builder.new_block();
+            const ir::BlockId join = builder.new_block();
+            const ir::BlockId next = stmt_if->pred.has_value() ? builder.new_block() : join;
+
+            builder.branch(stmt_if->expr, then, next);
+            builder.seal(then);
+
+            builder.current = then;
+            builder.scope(stmt_if->scope);
+            builder.jump(join);
+
+            if (stmt_if->pred.has_value()) {
+                builder.seal(next);
+                builder.current = next;
+                builder.if_pred(stmt_if->pred.value(), join);
+            }
+
+            builder.seal(join);
+            builder.current = join;
+        }
+    };
+
+    std::visit(ScopeStmtVisitor{ *this }, s->var);
+}
+
+void IRBuilder::if_pred(const Node::IfPred* pred, ir::BlockId join) {
+    struct PredVisitor {
+        IRBuilder& builder;
+        ir::BlockId join;
+
+        void operator()(const Node::IfPredElif* elif_pred) const {
+            const ir::BlockId then = builder.new_block();
+            const ir::BlockId next = elif_pred->pred.has_value() ? builder.new_block() : join;
+
+            builder.branch(elif_pred->expr, then, next);
+            builder.seal(then);
+
+            builder.current = then;
+            builder.scope(elif_pred->scope);
+            builder.jump(join);
+
+            if (elif_pred->pred.has_value()) {
+                builder.seal(next);
+                builder.current = next;
+                builder.if_pred(elif_pred->pred.value(), join);
+            }
+        }
+
+        void operator()(const Node::IfPredElse* else_pred) const {
+            builder.scope(else_pred->scope);
+            builder.jump(join);
+        }
+    };
+
+    std::visit(PredVisitor{ *this, join }, pred->var);
+}
+
+void IRBuilder::branch(const Node::Expr* cond, ir::BlockId if_true, ir::BlockId if_false) {
+    if (const auto t = std::get_if<Node::Term*>(&cond->var)) {
+        if (const auto paren = std::get_if<Node::TermParen*>(&(*t)->var))
+            return branch((*paren)->expr, if_true, if_false);
+    }
+
+    if (const auto e = std::get_if<Node::ExprNot*>(&cond->var))
+        return branch((*e)->expr, if_false, if_true);
+
+    // short circuit: the right side is only evaluated on the path where it decides
+    if (const auto bin = std::get_if<Node::BinExpr*>(&cond->var); bin != nullptr
+        && ((*bin)->op == BinOp::AND || (*bin)->op == BinOp::OR)) {
+        const ir::BlockId rhs = new_block();
+
+        if ((*bin)->op == BinOp::AND)
+            branch((*bin)->lside, rhs, if_false);
+        else
+            branch((*bin)->lside, if_true, rhs);
+
+        seal(rhs);
+        current = rhs;
+        return branch((*bin)->rside, if_true, if_false);
+    }
+
+    const ir::Value v = expr(cond);
+
+    if (f->instrs[v].op == ir::Op::CONST)
+        return jump(f->instrs[v].imm ? if_true : if_false);
+
+    emit({ .op = ir::Op::BRANCH, .args = { v } });
+    link(current, if_true);
+    link(current, if_false);
+}
+
+ir::Value IRBuilder::expr(const Node::Expr* e) {
+    struct ExprVisitor {
+        IRBuilder& builder;
+        VarType type;
+
+        ir::Value operator()(const Node::Term* t) const {
+            return builder.term(t);
+        }
+
+        ir::Value operator()(const Node::BinExpr* bin_e) const {
+            return builder.bin_expr(bin_e, type);
+        }
+
+        ir::Value operator()(const Node::ExprNot* e) const {
+            const ir::Value v = builder.expr(e->expr);
+            return builder.emit({ .op = ir::Op::NOT, .type = VarType::BOOL, .args = { v } });
+        }
+
+        ir::Value operator()(const Node::VarIncr* i) const {
+            return builder.step(i->ident, 1);
+        }
+
+        ir::Value operator()(const Node::VarDecr* d) const {
+            return builder.step(d->ident, -1);
+        }
+    };
+
+    return std::visit(ExprVisitor{ *this, e->type }, e->var);
+}
+
+ir::Value IRBuilder::bin_expr(const Node::BinExpr* bin, VarType type) {
+    if (bin->op != BinOp::AND && bin->op != BinOp::OR) {
+        const ir::Value l = expr(bin->lside);
+        const ir::Value r = expr(bin->rside);
+        return emit({ .op = ir::Op::BIN, .type = type, .bin = bin->op, .args = { l, r } });
+    }
+
+    // short circuit: the left side when it decides, else the right side
+    const ir::Value l = expr(bin->lside);
+    const ir::BlockId rhs = new_block();
+    const ir::BlockId join = new_block();
+
+    emit({ .op = ir::Op::BRANCH, .args = { l } });
+    if (bin->op == BinOp::AND) {
+        link(current, rhs);
+        link(current, join);
+    }
+    else {
+        link(current, join);
+        link(current, rhs);
+    }
+    seal(rhs);
+
+    current = rhs;
+    const ir::Value r = expr(bin->rside);
+    jump(join);
+    seal(join);
+
+    current = join;
+    const ir::Value phi = new_phi(join, VarType::BOOL);
+    f->instrs[phi].args = { l, r };
+    return phi;
+}
+
+ir::Value IRBuilder::term(const Node::Term* t) {
+    struct TermVisitor {
+        IRBuilder& builder;
+
+        ir::Value operator()(const Node::TermBooleanLiteral* term_bool_lit) const {
+            return builder.constant(VarType::BOOL, term_bool_lit->bool_lit.val.value(), term_bool_lit->value);
+        }
+
+        ir::Value operator()(const Node::TermIntegerLiteral* term_int_lit) const {
+            return builder.constant(VarType::INT, term_int_lit->int_lit.val.value(), term_int_lit->value);
+        }
+
+        ir::Value operator()(const Node::TermCharLiteral* term_char_lit) const {
+            const std::string_view lit = term_char_lit->char_lit.val.value();
+            return builder.constant(VarType::CHAR, lit, lit[0]);
+        }
+
+        ir::Value operator()(const Node::TermStringLiteral* term_string_lit) const {
+            return builder.constant(VarType::STRING, term_string_lit->string_lit.val.value(), 0);
+        }
+
+        ir::Value operator()(const Node::TermIdentifier* term_ident) const {
+            return builder.read(term_ident->slot, term_ident->type);
+        }
+
+        ir::Value operator()(const Node::FuncCall* fcall) const {
+            return builder.call(fcall);
+        }
+
+        ir::Value operator()(const Node::TermParen* term_paren) const {
+            return builder.expr(term_paren->expr);
+        }
+    };
+
+    return std::visit(TermVisitor{ *this }, t->var);
+}
+
+ir::Value IRBuilder::read(VarSlot slot, VarType type) {
+    if (slot.global)
+        return emit({ .op = ir::Op::GLOBAL, .type = type, .index = slot.index });
+
+    slot_types[slot.index] = type;
+    return read_var(slot.index, current);
+}
+
+void IRBuilder::assign(VarSlot slot, ir::Value v) {
+    if (slot.global) {
+        emit({ .op = ir::Op::SET_GLOBAL, .index = slot.index, .args = { v } });
+        return;
+    }
+
+    slot_types[slot.index] = f->instrs[v].type;
+    write_var(slot.index, current, v);
+}
+
+ir::Value IRBuilder::step(const Node::TermIdentifier* ident, int delta) {
+    const ir::Value old = read(ident->slot, VarType::INT);
+    const ir::Value one = constant(VarType::INT, "1", 1);
+
+    assign(ident->slot, emit({ .op = ir::Op::BIN, .type = VarType::INT,
+        .bin = delta > 0 ? BinOp::ADD : BinOp::SUB, .args = { old, one } }));
+    return old;
+}
+
+ir::Value IRBuilder::call(const Node::FuncCall* fcall) {
+    const std::string_view name = fcall->ident.val.value();
+
+    if (fcall->func != nullptr) {
+        const auto callee = functions.find(fcall->func);
+        if (callee == functions.end())
+            exit_with("unknown function `" + std::string(name) + "`");
+
+        return emit({ .op = ir::Op::CALL, .type = fcall->func->type, .index = callee->second });
+    }
+
+    if (name == "print" || name == "println") {
+        // each argument is written as soon as it is computed, like `std::cout << a << b` does: a call in
+        // a later argument prints after it
+        for (const Node::Expr* arg : fcall->args) {
+            if (arg->type == VarType::VOID)
+                exit_with("cannot print a void expression");
+            const ir::Value v = expr(arg);
+            emit({ .op = ir::Op::PRINT, .args = { v } });
+        }
+
+        if (name == "println")
+            emit({ .op = ir::Op::PRINT, .newline = true });
+        return ir::NO_VALUE;
+    }
+
+    if (name == "itoc" || name == "ctoi") {
+        if (fcall->args.size() != 1)
+            exit_with("function `" + std::string(name) + "` require one argument");
+
+        const ir::Value arg = expr(fcall->args[0]);
+        if (name == "itoc")
+            return emit({ .op = ir::Op::ITOC, .type = VarType::CHAR, .args = { arg } });
+        return emit({ .op = ir::Op::CTOI, .type = VarType::INT, .args = { arg } });
+    }
+
+    exit_with("unknown function `" + std::string(name) + "`");
+}
+
+ir::Module IRBuilder::build(const Node::Prog& p) {
+    module = {};
+    functions.clear();
+    module.globals.resize(p.global_slots);
+
+    // functions are numbered in declaration order after the initializers (0)
+    std::vector<const Node::FuncDeclaration*> decls;
+
+    for (const Node::ProgStmt* s : p.stmts) {
+        if (const auto fdecl = std::get_if<Node::FuncDeclaration*>(&s->var)) {
+            decls.push_back(*fdecl);
+            functions[*fdecl] = static_cast<int32_t>(decls.size());
+
+            if ((*fdecl)->ident.val.value() == "main")
+                module.main = static_cast<int32_t>(decls.size());
+        }
+        else if (const auto v = std::get_if<Node::StmtImplicitVar*>(&s->var))
+            module.globals[(*v)->slot.index] = { (*v)->identifier.val.value(), (*v)->expr->type };
+        else if (const auto v = std::get_if<Node::StmtExplicitVar*>(&s->var))
+            module.globals[(*v)->slot.index] = { (*v)->ident.val.value(), (*v)->type };
+    }
+
+    if (module.main < 0)
+        exit_with("no `main` function");
+
+    // the functions are built in place, the vector must not grow meanwhile
+    module.functions.resize(decls.size() + 1);
+
+    // globals start at their default value, the implicit ones are then initialized in declaration order
+    begin_function(0, "<init>", VarType::VOID, 0);
+    for (const Node::ProgStmt* s : p.stmts) {
+        if (const auto v = std::get_if<Node::StmtImplicitVar*>(&s->var))
+            assign((*v)->slot, expr((*v)->expr));
+    }
+    end_function();
+
+    for (size_t i = 0; i < decls.size(); i++) {
+        begin_function(static_cast<int32_t>(i + 1), decls[i]->ident.val.value(), decls[i]->type, decls[i]->frame_slots);
+        scope(decls[i]->scope);
+        end_function();
+    }
+
+    return std::move(module);
+}
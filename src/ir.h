@@ -0,0 +1,195 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "parser.h"
+
+/// @brief mid-level representation in SSA form: a function is a graph of basic blocks whose
+/// instructions each define at most one typed value; locals are renamed into values and merged by phi nodes,
+/// globals stay in memory (a call can change them)
+namespace ir {
+    /// @brief index of an instruction in its function, which is also the value it defines
+    using Value = int32_t;
+    /// @brief index of a block in its function
+    using BlockId = int32_t;
+
+    constexpr Value NO_VALUE = -1;
+    constexpr BlockId NO_BLOCK = -1;
+
+    enum class Op : uint8_t {
+        /// @brief literal, `text` as written in the source and `imm` its value (int, bool and char)
+        CONST,
+        /// @brief read the global `index`
+        GLOBAL,
+        /// @brief write args[0] to the global `index`
+        SET_GLOBAL,
+        /// @brief args[0] `bin` args[1] (&& and || are lowered to branches)
+        BIN,
+        NOT,
+        ITOC,
+        CTOI,
+        /// @brief call the function `index` of the module
+        CALL,
+        /// @brief write every operand, then a newline and a flush if `newline` (println)
+        PRINT,
+        /// @brief one operand per predecessor of its block, in the same order
+        PHI,
+
+        // terminators, the last instruction of every block; the targets are the successors of the block
+
+        /// @brief go to succs[0]
+        JUMP,
+        /// @brief go to succs[0] if args[0] is true, else to succs[1]
+        BRANCH,
+        /// @brief return args[0] (no operand for void functions)
+        RET
+    };
+
+    struct Instr {
+        Op op;
+        /// @brief type of the value defined (VOID if none)
+        VarType type{ VarType::VOID };
+        BinOp bin{};
+        int32_t index = -1;
+        std::string_view text{};
+        int64_t imm = 0;
+        bool newline = false;
+        std::vector<Value> args{};
+        BlockId block = NO_BLOCK;
+    };
+
+    struct Block {
+        /// @brief phis first, terminator last
+        std::vector<Value> instrs;
+        std::vector<BlockId> preds;
+        std::vector<BlockId> succs;
+        /// @brief immediate dominator (NO_BLOCK for the entry), see `dominators`
+        BlockId idom = NO_BLOCK;
+        /// @brief blocks immediately dominated, the dominator tree
+        std::vector<BlockId> children;
+    };
+
+    struct Function {
+        std::string_view name;
+        VarType type{ VarType::VOID };
+        std::vector<Instr> instrs;
+        /// @brief block 0 is the entry, every block is reachable from it
+        std::vector<Block> blocks;
+        /// @brief blocks in reverse postorder (a block comes before its successors, back edges aside)
+        std::vector<BlockId> order;
+    };
+
+    struct Global {
+        /// @brief empty for a slot whose declaration was removed
+        std::string_view name;
+        VarType type{ VarType::VOID };
+    };
+
+    struct Module {
+        /// @brief by slot index
+        std::vector<Global> globals;
+        /// @brief function 0 runs the global initializers, the others are in declaration order
+        std::vector<Function> functions;
+        /// @brief index of main
+        int32_t main = -1;
+    };
+
+    /// @brief compute the reverse postorder, the immediate dominators and the dominator tree of a function
+    void dominators(Function& f);
+
+    /// @brief true if every path from the entry to b goes through a (a block dominates itself)
+    bool dominates(const Function& f, BlockId a, BlockId b);
+
+    /// @brief check the SSA properties: every operand is defined by an instruction dominating its use
+    /// (for a phi, the end of the matching predecessor) and the edges of the blocks are consistent
+    bool verify(const Function& f);
+}
+
+/// @brief builds the SSA form of a program (the construction of Braun et al.: the value of a local is
+/// looked up backwards through the predecessors, with phis placed where paths merge)
+class IRBuilder {
+private:
+    ir::Module module;
+    ir::Function* f = nullptr;
+    ir::BlockId current = ir::NO_BLOCK;
+
+    std::unordered_map<const Node::FuncDeclaration*, int32_t> functions;
+
+    /// @brief type of every local slot of the function being built
+    std::vector<VarType> slot_types;
+    /// @brief value of the locals at the end of each block (so far), by slot
+    std::vector<std::unordered_map<int, ir::Value>> defs;
+    /// @brief a block is sealed once all its predecessors are known
+    std::vector<bool> sealed;
+    /// @brief phis created in unsealed blocks, their operands are added when the block is sealed
+    std::vector<std::vector<std::pair<int, ir::Value>>> incomplete_phis;
+    /// @brief constants of the function being built by type and text, each is defined once in the entry block
+    std::unordered_map<std::string, ir::Value> constants;
+
+    [[noreturn]] void exit_with(const std::string& err_msg);
+
+    ir::BlockId new_block();
+
+    /// @brief add an edge, the terminator of `from` decides which successor it is
+    void link(ir::BlockId from, ir::BlockId to);
+
+    /// @brief end the current block with a jump
+    void jump(ir::BlockId to);
+
+    /// @brief end the current block with a return, what follows is unreachable
+    void ret(ir::Value v);
+
+    void seal(ir::BlockId b);
+
+    ir::Value emit(ir::Instr instr);
+
+    ir::Value constant(VarType type, std::string_view text, int64_t imm);
+
+    /// @brief value of a variable the program never set (the default of its type)
+    ir::Value default_value(VarType type);
+
+    void write_var(int slot, ir::BlockId b, ir::Value v);
+
+    ir::Value read_var(int slot, ir::BlockId b);
+
+    ir::Value read_var_recursive(int slot, ir::BlockId b);
+
+    ir::Value new_phi(ir::BlockId b, VarType type);
+
+    void add_phi_operands(int slot, ir::Value phi);
+
+    void begin_function(int32_t index, std::string_view name, VarType type, int frame_slots);
+
+    /// @brief return the default value when falling off the end, drop the unreachable blocks, the phis merging
+    /// a single value and the unused values, then number what is left in reverse postorder
+    void end_function();
+
+    void scope(const Node::Scope* sc);
+
+    void scope_stmt(const Node::ScopeStmt* s);
+
+    /// @param join block every branch ends in
+    void if_pred(const Node::IfPred* pred, ir::BlockId join);
+
+    /// @brief lower a condition then branch on it, the current block becomes `if_false`
+    void branch(const Node::Expr* cond, ir::BlockId if_true, ir::BlockId if_false);
+
+    ir::Value expr(const Node::Expr* e);
+
+    ir::Value bin_expr(const Node::BinExpr* bin, VarType type);
+
+    ir::Value term(const Node::Term* t);
+
+    ir::Value read(VarSlot slot, VarType type);
+
+    void assign(VarSlot slot, ir::Value v);
+
+    /// @return the value before the update
+    ir::Value step(const Node::TermIdentifier* ident, int delta);
+
+    ir::Value call(const Node::FuncCall* fcall);
+
+public:
+    ir::Module build(const Node::Prog& p);
+};
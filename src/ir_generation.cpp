@@ -0,0 +1,233 @@
+#include "ir_generation.h"
+
+std::string IRGenerator::function_name(const ir::Module& m, int32_t index) {
+    if (index == 0)
+        return "init_globals";
+
+    return "f_" + std::string(m.functions[index].name);
+}
+
+bool IRGenerator::has_var(ir::Value v) const {
+    const ir::Instr& instr = f->instrs[v];
+    // an unused operation left by the cleanup is a division kept for its trap, g++ would drop it without a variable
+    return instr.op != ir::Op::CONST && instr.type != VarType::VOID && (uses[v] > 0 || instr.op == ir::Op::BIN);
+}
+
+std::string IRGenerator::operand(ir::Value v) const {
+    const ir::Instr& instr = f->instrs[v];
+
+    if (instr.op != ir::Op::CONST)
+        return "v" + std::to_string(v);
+
+    switch (instr.type) {
+    case VarType::CHAR:
+        return "'" + std::string(instr.text) + "'";
+    case VarType::STRING:
+        return "std::string(\"" + std::string(instr.text) + "\")";
+    case VarType::INT:
+        // the decoded value, a literal past INT_MAX is wrapped as the other backends do
+        if (instr.imm == INT32_MIN)
+            return "(-2147483647 - 1)";
+        // a folded negative literal must not stick to the operator before it
+        if (instr.imm < 0)
+            return "(" + std::to_string(instr.imm) + ")";
+        return std::to_string(instr.imm);
+    default:
+        return std::string(instr.text);
+    }
+}
+
+std::string IRGenerator::prog(const ir::Module& m) {
+    module = &m;
+    output.clear();
+
+    output += "#include <iostream>\n";
+    output += "#include <string>\n";
+
+    output += "\n";
+
+    output += "using namespace std;\n";
+
+    output += "\n";
+
+    // every global starts at its default value, init_globals runs the initializers
+    for (const ir::Global& g : m.globals) {
+        if (!g.name.empty())
+            output += to_string(g.type) + " g_" + std::string(g.name) + "{};\n";
+    }
+
+    output += "\n";
+
+    for (size_t i = 0; i < m.functions.size(); i++)
+        output += to_string(m.functions[i].type) + " " + function_name(m, static_cast<int32_t>(i)) + "();\n";
+
+    for (size_t i = 0; i < m.functions.size(); i++)
+        func(static_cast<int32_t>(i));
+
+    output += "\n";
+    output += "int main()\n";
+    output += "{\n";
+    output += "  init_globals();\n";
+
+    if (m.functions[m.main].type == VarType::VOID) {
+        output += "  " + function_name(m, m.main) + "();\n";
+        output += "  return 0;\n";
+    }
+    else
+        output += "  return " + function_name(m, m.main) + "();\n";
+
+    output += "}\n";
+
+    return std::move(output);
+}
+
+void IRGenerator::func(int32_t index) {
+    f = &module->functions[index];
+
+    uses.assign(f->instrs.size(), 0);
+    for (const ir::Instr& instr : f->instrs) {
+        for (const ir::Value arg : instr.args)
+            uses[arg]++;
+    }
+
+    output += "\n";
+    output += to_string(f->type) + " " + function_name(*module, index) + "()\n";
+    output += "{\n";
+
+    // declared up front so no goto jumps over an initialization
+    for (ir::Value v = 0; v < static_cast<ir::Value>(f->instrs.size()); v++) {
+        if (!has_var(v))
+            continue;
+
+        const std::string type = to_string(f->instrs[v].type);
+        output += "  " + type + " v" + std::to_string(v) + ";\n";
+        if (f->instrs[v].op == ir::Op::PHI)
+            output += "  " + type + " p" + std::to_string(v) + ";\n";
+    }
+
+    // the labels are known once every block is generated
+    labeled.assign(f->blocks.size(), false);
+    std::vector<std::string> code(f->blocks.size());
+
+    for (size_t i = 0; i < f->order.size(); i++) {
+        const ir::BlockId next = i + 1 < f->order.size() ? f->order[i + 1] : ir::NO_BLOCK;
+        block(f->order[i], next, code[f->order[i]]);
+    }
+
+    for (const ir::BlockId b : f->order) {
+        if (labeled[b])
+            output += "b" + std::to_string(b) + ":\n";
+        output += code[b];
+    }
+
+    output += "}\n";
+}
+
+void IRGenerator::block(ir::BlockId b, ir::BlockId next, std::string& out) {
+    const std::vector<ir::Value>& instrs = f->blocks[b].instrs;
+    const std::vector<ir::BlockId>& succs = f->blocks[b].succs;
+
+    for (size_t i = 0; i + 1 < instrs.size(); i++)
+        instr(instrs[i], out);
+
+    const ir::Instr& terminator = f->instrs[instrs.back()];
+
+    switch (terminator.op) {
+    case ir::Op::JUMP:
+        phi_copies(b, succs[0], out);
+        go(succs[0], next, out);
+        break;
+    case ir::Op::BRANCH: {
+        phi_copies(b, succs[0], out);
+        phi_copies(b, succs[1], out);
+
+        const std::string cond = operand(terminator.args[0]);
+
+        // fall through to the next block when it is one of the targets
+        if (succs[0] == next) {
+            out += "  if (!" + cond + ") goto b" + std::to_string(succs[1]) + ";\n";
+            labeled[succs[1]] = true;
+        }
+        else {
+            out += "  if (" + cond + ") goto b" + std::to_string(succs[0]) + ";\n";
+            labeled[succs[0]] = true;
+            go(succs[1], next, out);
+        }
+        break;
+    }
+    default:
+        if (terminator.args.empty())
+            out += "  return;\n";
+        else
+            out += "  return " + operand(terminator.args[0]) + ";\n";
+    }
+}
+
+void IRGenerator::instr(ir::Value v, std::string& out) {
+    const ir::Instr& instr = f->instrs[v];
+    const std::string dst = "  v" + std::to_string(v) + " = ";
+
+    switch (instr.op) {
+    case ir::Op::CONST:
+        break;
+    case ir::Op::GLOBAL:
+        out += dst + "g_" + std::string(module->globals[instr.index].name) + ";\n";
+        break;
+    case ir::Op::SET_GLOBAL:
+        out += "  g_" + std::string(module->globals[instr.index].name) + " = " + operand(instr.args[0]) + ";\n";
+        break;
+    case ir::Op::BIN:
+        out += dst + operand(instr.args[0]) + " " + std::string(to_string(instr.bin)) + " " + operand(instr.args[1]) + ";\n";
+        break;
+    case ir::Op::NOT:
+        out += dst + "!" + operand(instr.args[0]) + ";\n";
+        break;
+    case ir::Op::ITOC:
+        out += dst + "(char)(" + operand(instr.args[0]) + " + '0');\n";
+        break;
+    case ir::Op::CTOI:
+        out += dst + operand(instr.args[0]) + " - '0';\n";
+        break;
+    case ir::Op::CALL:
+        // the result of a call made for its effects is dropped
+        out += has_var(v) ? dst : "  ";
+        out += function_name(*module, instr.index) + "();\n";
+        break;
+    case ir::Op::PRINT:
+        if (instr.args.empty() && !instr.newline)
+            break;
+
+        out += "  std::cout";
+        for (const ir::Value arg : instr.args)
+            out += " << " + operand(arg);
+        out += instr.newline ? " << std::endl;\n" : ";\n";
+        break;
+    case ir::Op::PHI:
+        out += dst + "p" + std::to_string(v) + ";\n";
+        break;
+    default:
+        assert(false); // terminators are generated by `block`
+    }
+}
+
+void IRGenerator::phi_copies(ir::BlockId from, ir::BlockId to, std::string& out) {
+    const ir::Block& target = f->blocks[to];
+    size_t k = 0;
+    while (target.preds[k] != from)
+        k++;
+
+    for (const ir::Value phi : target.instrs) {
+        if (f->instrs[phi].op != ir::Op::PHI)
+            break;
+
+        out += "  p" + std::to_string(phi) + " = " + operand(f->instrs[phi].args[k]) + ";\n";
+    }
+}
+
+void IRGenerator::go(ir::BlockId to, ir::BlockId next, std::string& out) {
+    if (to == next)
+        return;
+
+    out += "  goto b" + std::to_string(to) + ";\n";
+    labeled[to] = true;
+}
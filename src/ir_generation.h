@@ -0,0 +1,41 @@
+#pragma once
+
+#include "ir.h"
+
+/// @brief C++ backend reading the SSA form: every value is a local assigned once, every block a label
+/// and the control flow gotos; the operands of a phi are copied on its incoming edges
+class IRGenerator {
+private:
+    std::string output;
+
+    const ir::Module* module = nullptr;
+    /// @brief function being generated
+    const ir::Function* f = nullptr;
+    /// @brief number of uses of every value of the function being generated
+    std::vector<int> uses;
+    /// @brief blocks a goto jumps to, they get a label
+    std::vector<bool> labeled;
+
+    static std::string function_name(const ir::Module& m, int32_t index);
+
+    /// @brief true if a value is held in a variable (constants are written in place, unused results dropped)
+    bool has_var(ir::Value v) const;
+
+    /// @brief C++ expression of a value: its variable or the literal of a constant
+    std::string operand(ir::Value v) const;
+
+    void func(int32_t index);
+
+    void block(ir::BlockId b, ir::BlockId next, std::string& out);
+
+    void instr(ir::Value v, std::string& out);
+
+    /// @brief assign the operands of the phis of `to` coming from `from`
+    void phi_copies(ir::BlockId from, ir::BlockId to, std::string& out);
+
+    /// @brief jump to a block, nothing if it is the next one
+    void go(ir::BlockId to, ir::BlockId next, std::string& out);
+
+public:
+    std::string prog(const ir::Module& m);
+};
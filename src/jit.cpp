@@ -0,0 +1,495 @@
+#include "jit.h"
+
+#include <cstddef>
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define CERN_JIT 1
+#endif
+
+namespace jit {
+    Code::Code(void* memory, size_t size, std::vector<uint32_t> offsets, size_t first)
+        : memory(memory), size(size), offsets(std::move(offsets)), first(first) {
+    }
+
+    Code::~Code() {
+#ifdef CERN_JIT
+        munmap(memory, size);
+#endif
+    }
+
+    const void* Code::at(size_t pc) const {
+        return static_cast<const uint8_t*>(memory) + offsets[pc - first];
+    }
+
+#ifndef CERN_JIT
+    bool supported() {
+        return false;
+    }
+
+    std::unique_ptr<Code> compile(const bc::Program&, size_t, std::span<const std::unique_ptr<Code>>, const Hooks&) {
+        return nullptr;
+    }
+#else
+    namespace {
+        enum Reg : uint8_t {
+            RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RBP = 5, RSI = 6, RDI = 7,
+            R12 = 12, R13 = 13
+        };
+
+        // condition codes, added to 0x90 (setcc) or 0x80 (jcc)
+        enum Cond : uint8_t {
+            E = 0x4, NE = 0x5, A = 0x7, L = 0xC, GE = 0xD, LE = 0xE, G = 0xF
+        };
+
+        Cond negate(Cond c) {
+            return static_cast<Cond>(c ^ 1);
+        }
+
+        // register use of the generated code:
+        //   rbx  registers of the frame (bytecode register i is qword [rbx + 8 * i])
+        //   r12  globals
+        //   r13  context
+        //   rax, rcx, rdx, rsi, rdi  scratch
+        class Assembler {
+        public:
+            std::vector<uint8_t> code;
+
+            void byte(uint8_t b) {
+                code.push_back(b);
+            }
+
+            void imm32(int32_t v) {
+                uint8_t bytes[4];
+                std::memcpy(bytes, &v, 4);
+                code.insert(code.end(), bytes, bytes + 4);
+            }
+
+            void imm64(uint64_t v) {
+                uint8_t bytes[8];
+                std::memcpy(bytes, &v, 8);
+                code.insert(code.end(), bytes, bytes + 8);
+            }
+
+            void rex(bool w, uint8_t reg, uint8_t base) {
+                const uint8_t r = 0x40 | (w ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((base & 8) ? 1 : 0);
+                if (r != 0x40)
+                    byte(r);
+            }
+
+            // ModRM (+ SIB) for [base + disp32]
+            void mem(uint8_t reg, uint8_t base, int32_t disp) {
+                byte(0x80 | ((reg & 7) << 3) | (base & 7));
+                if ((base & 7) == RSP)
+                    byte(0x24);
+                imm32(disp);
+            }
+
+            // op reg, [base + disp] (or the reverse direction, depending on the opcode)
+            void op_mem(bool w, std::initializer_list<uint8_t> opcode, uint8_t reg, uint8_t base, int32_t disp) {
+                rex(w, reg, base);
+                for (const uint8_t b : opcode)
+                    byte(b);
+                mem(reg, base, disp);
+            }
+
+            // op dst, src on registers
+            void op_reg(bool w, uint8_t opcode, uint8_t src, uint8_t dst) {
+                rex(w, src, dst);
+                byte(opcode);
+                byte(0xC0 | ((src & 7) << 3) | (dst & 7));
+            }
+
+            size_t rel32() {
+                imm32(0);
+                return code.size() - 4;
+            }
+
+            void patch(size_t at, size_t target) {
+                const int32_t rel = static_cast<int32_t>(target) - static_cast<int32_t>(at + 4);
+                std::memcpy(code.data() + at, &rel, 4);
+            }
+        };
+
+        int32_t slot(int32_t reg) {
+            return reg * 8;
+        }
+
+        Cond condition(bc::OpCode op) {
+            switch (op) {
+            case bc::EQ:
+            case bc::EQI:
+                return E;
+            case bc::NE:
+            case bc::NEI:
+                return NE;
+            case bc::LT:
+            case bc::LTI:
+                return L;
+            case bc::LE:
+            case bc::LEI:
+                return LE;
+            case bc::GT:
+            case bc::GTI:
+                return G;
+            default:
+                return GE;
+            }
+        }
+
+        class Compiler {
+        private:
+            const bc::Program& program;
+            const size_t function;
+            std::span<const std::unique_ptr<Code>> compiled;
+            const Hooks& hooks;
+
+            Assembler as;
+
+            size_t first = 0;
+            size_t end = 0;
+
+            std::vector<uint32_t> offsets;
+            std::vector<bool> targets;
+
+            // (rel32 position, bytecode pc) of the jumps to patch
+            std::vector<std::pair<size_t, size_t>> jumps;
+            std::vector<size_t> div_errors;
+            std::vector<size_t> overflow_errors;
+
+            // rax = regs[r]
+            void load(int32_t r) {
+                as.op_mem(true, { 0x8B }, RAX, RBX, slot(r));
+            }
+
+            // regs[r] = rax
+            void store(int32_t r) {
+                as.op_mem(true, { 0x89 }, RAX, RBX, slot(r));
+            }
+
+            // movsxd rax, eax
+            void sign_extend() {
+                as.op_reg(true, 0x63, RAX, RAX);
+            }
+
+            void jump(std::initializer_list<uint8_t> opcode, size_t target) {
+                for (const uint8_t b : opcode)
+                    as.byte(b);
+                jumps.push_back({ as.rel32(), target });
+            }
+
+            void call_address(const void* fn) {
+                as.byte(0x48);
+                as.byte(0xB8); // mov rax, imm64
+                as.imm64(reinterpret_cast<uint64_t>(fn));
+                as.byte(0xFF);
+                as.byte(0xD0); // call rax
+            }
+
+            void epilogue() {
+                as.byte(0x41);
+                as.byte(0x5D); // pop r13
+                as.byte(0x41);
+                as.byte(0x5C); // pop r12
+                as.byte(0x5B); // pop rbx
+                as.byte(0xC3); // ret
+            }
+
+            // rdi = context
+            void context_arg() {
+                as.op_reg(true, 0x89, R13, RDI);
+            }
+
+            void fail(int32_t error) {
+                context_arg();
+                as.byte(0xBE); // mov esi, imm32
+                as.imm32(error);
+                call_address(reinterpret_cast<const void*>(hooks.fail));
+            }
+
+            // compare then set or branch, the flags come from `cmp rax, rhs`
+            void compare(const bc::Instr& i, bool immediate) {
+                load(i.b);
+                if (immediate) {
+                    as.byte(0x48);
+                    as.byte(0x3D); // cmp rax, imm32
+                    as.imm32(i.c);
+                }
+                else
+                    as.op_mem(true, { 0x3B }, RAX, RBX, slot(i.c));
+            }
+
+            void set_flag(Cond c, int32_t dst) {
+                as.byte(0x0F);
+                as.byte(0x90 + c);
+                as.byte(0xC0); // setcc al
+                as.byte(0x0F);
+                as.byte(0xB6);
+                as.byte(0xC0); // movzx eax, al
+                store(dst);
+            }
+
+            /// @return number of bytecode instructions emitted (a comparison takes the branch on its result)
+            size_t instr(size_t pc);
+
+        public:
+            Compiler(const bc::Program& program, size_t function, std::span<const std::unique_ptr<Code>> compiled,
+                const Hooks& hooks)
+                : program(program), function(function), compiled(compiled), hooks(hooks) {
+            }
+
+            std::unique_ptr<Code> compile();
+        };
+
+        size_t Compiler::instr(size_t pc) {
+            const bc::Instr& i = program.code[pc];
+
+            switch (i.op) {
+            case bc::LOADI:
+                as.op_mem(true, { 0xC7 }, 0, RBX, slot(i.a)); // mov qword [rbx + a], imm32
+                as.imm32(i.b);
+                break;
+            case bc::MOV:
+                load(i.b);
+                store(i.a);
+                break;
+            case bc::GETG:
+                as.op_mem(true, { 0x8B }, RAX, R12, slot(i.b));
+                store(i.a);
+                break;
+            case bc::SETG:
+                load(i.b);
+                as.op_mem(true, { 0x89 }, RAX, R12, slot(i.a));
+                break;
+            case bc::ADD:
+            case bc::SUB:
+            case bc::MUL: {
+                // 32 bit arithmetic, sign extended like the C++ backend's int
+                as.op_mem(false, { 0x8B }, RAX, RBX, slot(i.b));
+                if (i.op == bc::ADD)
+                    as.op_mem(false, { 0x03 }, RAX, RBX, slot(i.c));
+                else if (i.op == bc::SUB)
+                    as.op_mem(false, { 0x2B }, RAX, RBX, slot(i.c));
+                else
+                    as.op_mem(false, { 0x0F, 0xAF }, RAX, RBX, slot(i.c));
+                sign_extend();
+                store(i.a);
+                break;
+            }
+            case bc::DIV:
+                // 64 bit division of the sign extended operands: INT_MIN / -1 does not trap
+                load(i.b);
+                as.op_mem(true, { 0x8B }, RCX, RBX, slot(i.c));
+                as.op_reg(true, 0x85, RCX, RCX); // test rcx, rcx
+                as.byte(0x0F);
+                as.byte(0x80 + E);
+                div_errors.push_back(as.rel32());
+                as.byte(0x48);
+                as.byte(0x99); // cqo
+                as.op_reg(true, 0xF7, 7, RCX); // idiv rcx
+                sign_extend();
+                store(i.a);
+                break;
+            case bc::ADDI:
+                as.op_mem(false, { 0x8B }, RAX, RBX, slot(i.b));
+                as.byte(0x05); // add eax, imm32
+                as.imm32(i.c);
+                sign_extend();
+                store(i.a);
+                break;
+            case bc::MULI:
+                as.op_mem(false, { 0x69 }, RAX, RBX, slot(i.b)); // imul eax, [rbx + b], imm32
+                as.imm32(i.c);
+                sign_extend();
+                store(i.a);
+                break;
+            case bc::EQ:
+            case bc::NE:
+            case bc::LT:
+            case bc::LE:
+            case bc::GT:
+            case bc::GE:
+            case bc::EQI:
+            case bc::NEI:
+            case bc::LTI:
+            case bc::LEI:
+            case bc::GTI:
+            case bc::GEI: {
+                compare(i, i.op >= bc::EQI);
+                set_flag(condition(i.op), i.a);
+
+                // branch on the flags when the next instruction tests the result
+                const size_t next = pc + 1;
+                if (next < end && !targets[next]) {
+                    const bc::Instr& j = program.code[next];
+                    if ((j.op == bc::JMPF || j.op == bc::JMPT) && j.a == i.a) {
+                        offsets[next - first] = static_cast<uint32_t>(as.code.size());
+                        const Cond c = j.op == bc::JMPT ? condition(i.op) : negate(condition(i.op));
+                        jump({ 0x0F, static_cast<uint8_t>(0x80 + c) }, j.b);
+                        return 2;
+                    }
+                }
+                break;
+            }
+            case bc::NOT:
+            case bc::TEST:
+                as.op_mem(true, { 0x83 }, 7, RBX, slot(i.b)); // cmp qword [rbx + b], 0
+                as.byte(0);
+                set_flag(i.op == bc::NOT ? E : NE, i.a);
+                break;
+            case bc::ITOC:
+                load(i.b);
+                as.byte(0x05); // add eax, '0'
+                as.imm32('0');
+                as.byte(0x48);
+                as.byte(0x0F);
+                as.byte(0xBE);
+                as.byte(0xC0); // movsx rax, al
+                store(i.a);
+                break;
+            case bc::CTOI:
+                load(i.b);
+                as.byte(0x2D); // sub eax, '0'
+                as.imm32('0');
+                sign_extend();
+                store(i.a);
+                break;
+            case bc::JMP:
+                jump({ 0xE9 }, i.a);
+                break;
+            case bc::JMPF:
+            case bc::JMPT:
+                as.op_mem(true, { 0x83 }, 7, RBX, slot(i.a)); // cmp qword [rbx + a], 0
+                as.byte(0);
+                jump({ 0x0F, static_cast<uint8_t>(0x80 + (i.op == bc::JMPF ? E : NE)) }, i.b);
+                break;
+            case bc::CALL: {
+                const int32_t frame = program.functions[function].frame_size;
+
+                as.op_mem(true, { 0x8D }, RDI, RBX, slot(frame)); // lea rdi, [rbx + frame]
+                if (const Code* callee = compiled[i.b].get()) {
+                    as.op_reg(true, 0x89, R13, RSI); // mov rsi, r13
+                    as.byte(0x48);
+                    as.byte(0xBA); // mov rdx, imm64
+                    as.imm64(reinterpret_cast<uint64_t>(callee->start()));
+                    call_address(reinterpret_cast<const void*>(callee->entry()));
+                }
+                else {
+                    as.op_reg(true, 0x89, RDI, RDX); // mov rdx, rdi
+                    context_arg();
+                    as.byte(0xBE); // mov esi, imm32
+                    as.imm32(i.b);
+                    call_address(reinterpret_cast<const void*>(hooks.call));
+                }
+                store(i.a);
+                break;
+            }
+            case bc::RET:
+                load(i.a);
+                epilogue();
+                break;
+            case bc::RETV:
+                as.byte(0x31);
+                as.byte(0xC0); // xor eax, eax
+                epilogue();
+                break;
+            case bc::PRINTI:
+            case bc::PRINTC:
+            case bc::PRINTS:
+            case bc::PRINTLN:
+                if (i.op != bc::PRINTLN)
+                    as.op_mem(true, { 0x8B }, RDX, RBX, slot(i.a));
+                context_arg();
+                as.byte(0xBE);
+                as.imm32(i.op);
+                call_address(reinterpret_cast<const void*>(hooks.print));
+                break;
+            default:
+                // HALT only ends the initialization code, which is never compiled
+                as.byte(0x0F);
+                as.byte(0x0B); // ud2
+            }
+
+            return 1;
+        }
+
+        std::unique_ptr<Code> Compiler::compile() {
+            const bc::Function& f = program.functions[function];
+
+            first = f.entry;
+            end = f.end;
+            offsets.assign(end - first, 0);
+
+            targets.assign(end, false);
+            for (size_t pc = first; pc < end; pc++) {
+                const bc::Instr& i = program.code[pc];
+                if (i.op == bc::JMP)
+                    targets[i.a] = true;
+                else if (i.op == bc::JMPF || i.op == bc::JMPT)
+                    targets[i.b] = true;
+            }
+
+            // prologue: save the callee-saved registers (keeps rsp 16 bytes aligned for calls),
+            // check the frame fits in the stack then jump to the requested instruction
+            as.byte(0x53); // push rbx
+            as.byte(0x41);
+            as.byte(0x54); // push r12
+            as.byte(0x41);
+            as.byte(0x55); // push r13
+            as.op_reg(true, 0x89, RDI, RBX); // mov rbx, rdi
+            as.op_reg(true, 0x89, RSI, R13); // mov r13, rsi
+            as.op_mem(true, { 0x8B }, R12, R13, offsetof(Context, globals));
+            as.op_mem(true, { 0x8D }, RAX, RBX, slot(f.frame_size)); // lea rax, [rbx + frame]
+            as.op_mem(true, { 0x3B }, RAX, R13, offsetof(Context, stack_end)); // cmp rax, stack_end
+            as.byte(0x0F);
+            as.byte(0x80 + A);
+            overflow_errors.push_back(as.rel32());
+            as.byte(0xFF);
+            as.byte(0xE2); // jmp rdx
+
+            for (size_t pc = first; pc < end;) {
+                offsets[pc - first] = static_cast<uint32_t>(as.code.size());
+                pc += instr(pc);
+            }
+
+            const size_t div_error = as.code.size();
+            fail(DIVISION_BY_ZERO);
+            const size_t overflow_error = as.code.size();
+            fail(STACK_OVERFLOW);
+
+            for (const auto& [at, target] : jumps)
+                as.patch(at, offsets[target - first]);
+            for (const size_t at : div_errors)
+                as.patch(at, div_error);
+            for (const size_t at : overflow_errors)
+                as.patch(at, overflow_error);
+
+            const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+            const size_t size = (as.code.size() + page - 1) / page * page;
+
+            void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (memory == MAP_FAILED)
+                return nullptr;
+
+            std::memcpy(memory, as.code.data(), as.code.size());
+            if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+                munmap(memory, size);
+                return nullptr;
+            }
+
+            return std::make_unique<Code>(memory, size, std::move(offsets), first);
+        }
+    }
+
+    bool supported() {
+        return true;
+    }
+
+    std::unique_ptr<Code> compile(const bc::Program& program, size_t function,
+        std::span<const std::unique_ptr<Code>> compiled, const Hooks& hooks) {
+        return Compiler(program, function, compiled, hooks).compile();
+    }
+#endif
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "bytecode.h"
+
+/// @brief compiles hot bytecode functions to x86-64 machine code in executable memory;
+/// the generated code keeps the VM register file, so the VM can switch to it in the middle of a loop
+namespace jit {
+    /// @brief runtime state read by the generated code (its layout is part of the generated code)
+    struct Context {
+        int64_t* globals;
+        /// @brief end of the register stack, a call whose frame does not fit fails
+        const int64_t* stack_end;
+        /// @brief owner of the context, passed back to the hooks
+        void* vm;
+    };
+
+    /// @brief VM services called from the generated code
+    struct Hooks {
+        /// @brief run a function which has no machine code, its frame starts at base
+        int64_t (*call)(Context* ctx, int32_t function, int64_t* base);
+        /// @brief execute a PRINTI, PRINTC, PRINTS or PRINTLN instruction
+        void (*print)(Context* ctx, int32_t op, int64_t value);
+        /// @brief report a runtime error (division by zero or stack overflow), does not return
+        void (*fail)(Context* ctx, int32_t error);
+    };
+
+    enum Error : int32_t {
+        DIVISION_BY_ZERO,
+        STACK_OVERFLOW
+    };
+
+    /// @brief machine code of one function, mapped read + exec
+    class Code {
+    private:
+        void* memory;
+        size_t size;
+        /// @brief offset of the machine code of every instruction of the function
+        std::vector<uint32_t> offsets;
+        size_t first;
+
+    public:
+        /// @param regs first register of the frame
+        /// @param at where to start: `start()` or the address of an instruction (loop entry while running)
+        using Entry = int64_t (*)(int64_t* regs, Context* ctx, const void* at);
+
+        Code(void* memory, size_t size, std::vector<uint32_t> offsets, size_t first);
+
+        Code(const Code&) = delete;
+
+        Code& operator=(const Code&) = delete;
+
+        ~Code();
+
+        Entry entry() const { return reinterpret_cast<Entry>(memory); }
+
+        /// @brief machine address of the bytecode instruction at pc
+        const void* at(size_t pc) const;
+
+        const void* start() const { return at(first); }
+    };
+
+    /// @brief true if machine code can be generated for this host
+    bool supported();
+
+    /// @brief compile a function of the program
+    /// @param compiled machine code of the functions compiled so far (nullptr if none), called directly
+    /// @return nullptr if executable memory cannot be mapped
+    std::unique_ptr<Code> compile(const bc::Program& program, size_t function,
+        std::span<const std::unique_ptr<Code>> compiled, const Hooks& hooks);
+}
@@ -1,30 +1,121 @@
+#include <charconv>
 #include <iostream>
 #include <fstream>
-#include <sstream>
+#include <string_view>
+#include <vector>
 
+#include "cache.h"
 #include "generation.h"
+#include "interpreter.h"
+#include "ir_generation.h"
+#include "modules.h"
+#include "native.h"
+#include "optimizer.h"
+#include "vm.h"
 
-int main(int argc, char *argv[])
+namespace
 {
-    if (argc != 2)
+    void usage()
     {
-        std::cerr << "usage: cern <file.ce>" << std::endl;
-        return EXIT_FAILURE;
+        std::cerr << "usage: cern [--native | --run [--no-jit] | --interpret | --via-ir] [--no-opt] [--inline-threshold <n>]" << std::endl;
+        std::cerr << "            [--report-removed] [--incremental] [--no-cache] [--verbose] <file.ce | -> [file.ce ...]" << std::endl;
+        std::cerr << "  --native                build the executable with the x86-64 backend (as + ld) instead of g++" << std::endl;
+        std::cerr << "  --run                   run the program in the bytecode VM, nothing is written to disk" << std::endl;
+        std::cerr << "  --no-jit                with --run, never compile hot functions to machine code" << std::endl;
+        std::cerr << "  --interpret             run the program by walking its syntax tree, nothing is written to disk" << std::endl;
+        std::cerr << "  --via-ir                generate the C++ from the SSA form of the program instead of its syntax tree" << std::endl;
+        std::cerr << "  --no-opt                keep the syntax tree as parsed (no folding, inlining, loop, common subexpression or dead code optimization)" << std::endl;
+        std::cerr << "  --inline-threshold <n>  inline the functions whose body has at most n nodes (default 16, 0 disables)" << std::endl;
+        std::cerr << "  --report-removed        list the functions, globals and statements removed as dead code" << std::endl;
+        std::cerr << "  --incremental           build each function as an object of its own, only the changed ones are compiled again" << std::endl;
+        std::cerr << "  --no-cache              always build, without reading or filling the cache of the builds" << std::endl;
+        std::cerr << "  --verbose               print the hits, misses and stores of the cache of the builds" << std::endl;
+        exit(EXIT_FAILURE);
     }
+}
 
-    std::string contents;
+int main(int argc, char *argv[])
+{
+    std::vector<std::string> paths;
+    bool native_backend = false;
+    bool run = false;
+    bool interpret = false;
+    bool via_ir = false;
+    bool jit = true;
+    bool optimize = true;
+    bool report = false;
+    bool incremental = false;
+    bool cache = true;
+    bool verbose = false;
+    int inline_threshold = 16;
+
+    for (int i = 1; i < argc; i++)
     {
-        std::ifstream infile(argv[1]);
-        std::stringstream content_stream;
-        content_stream << infile.rdbuf();
-        contents = content_stream.str();
+        const std::string_view arg = argv[i];
+
+        if (arg == "--native")
+            native_backend = true;
+        else if (arg == "--run")
+            run = true;
+        else if (arg == "--interpret")
+            interpret = true;
+        else if (arg == "--via-ir")
+            via_ir = true;
+        else if (arg == "--no-jit")
+            jit = false;
+        else if (arg == "--no-opt")
+            optimize = false;
+        else if (arg == "--report-removed")
+            report = true;
+        else if (arg == "--incremental")
+            incremental = true;
+        else if (arg == "--no-cache")
+            cache = false;
+        else if (arg == "--verbose")
+            verbose = true;
+        else if (arg == "--inline-threshold" && i + 1 < argc)
+        {
+            const std::string_view n = argv[++i];
+            const auto [end, ec] = std::from_chars(n.data(), n.data() + n.size(), inline_threshold);
+            if (ec != std::errc() || end != n.data() + n.size() || inline_threshold < 0)
+                usage();
+        }
+        else if (arg.starts_with("--"))
+            usage();
+        else
+            paths.emplace_back(arg);
     }
 
-    Tokenizer tokenizer(std::move(contents));
-    std::vector<Token> tokens = tokenizer.tokenize();
+    if (paths.empty() || native_backend + run + interpret + via_ir + incremental > 1 || (!jit && !run))
+        usage();
+
+    // the files and their trees live in the loader
+    ModuleLoader loader;
+    loader.open(paths);
 
-    Parser parser(std::move(tokens));
-    std::optional<Node::Prog> prog = parser.parse_prog();
+    // a build only depends on the sources, the compiler and the options shaping the output; the runs write
+    // nothing and the reports would be skipped on a hit
+    BuildCache builds(verbose, cache);
+    const bool cached = cache && !run && !interpret && !report;
+    const std::string_view native_outputs[] = { "main.s", "app" };
+    const std::string_view cpp_outputs[] = { "main.cpp", "app" };
+    const std::string_view incremental_outputs[] = { "app" };
+    const std::span<const std::string_view> outputs = native_backend ? native_outputs
+        : incremental ? std::span<const std::string_view>(incremental_outputs) : cpp_outputs;
+
+    if (cached)
+    {
+        builds.add_compiler();
+        builds.add(std::string(native_backend ? "native" : via_ir ? "via-ir" : incremental ? "incremental" : "cpp")
+            + (optimize ? " opt " + std::to_string(inline_threshold) : " no-opt"));
+        for (const std::string_view source : loader.sources())
+            builds.add(source);
+
+        if (builds.restore(outputs))
+            return EXIT_SUCCESS;
+    }
+
+    std::optional<Node::Prog> prog = loader.parse();
 
     if (!prog.has_value())
     {
@@ -32,13 +123,77 @@ int main(int argc, char *argv[])
         exit(EXIT_FAILURE);
     }
 
+    // the rewritten nodes live in the optimizer, it is kept as long as the tree
+    Optimizer optimizer;
+    if (optimize)
+    {
+        optimizer.fold(prog.value());
+        optimizer.inline_calls(prog.value(), inline_threshold);
+        // the inlined bodies may fold further, and the functions inlined everywhere are now unused
+        optimizer.fold(prog.value());
+        optimizer.loops(prog.value());
+        optimizer.cse(prog.value());
+        optimizer.eliminate(prog.value());
+    }
+
+    if (report)
+    {
+        for (const std::string &removed : optimizer.removed())
+            std::cerr << "[Optimizer] removed " << removed << std::endl;
+    }
+
+    if (run)
+        return vm::run(BytecodeCompiler().compile(prog.value()), jit);
+
+    if (interpret)
+        return Interpreter().run(prog.value());
+
+    if (native_backend)
+    {
+        {
+            std::ofstream outfile("main.s");
+            outfile << NativeGenerator().prog(prog.value());
+        }
+
+        if (!native::build("main.s", "main.o", "app"))
+        {
+            std::cerr << "[Error] assembling or linking failed" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        if (cached)
+            builds.store(outputs);
+        return EXIT_SUCCESS;
+    }
+
+    if (incremental)
+    {
+        if (!builds.build(Generator().units(prog.value()), "app"))
+        {
+            std::cerr << "[Error] compiling or linking failed" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        if (cached)
+            builds.store(outputs);
+        return EXIT_SUCCESS;
+    }
+
     {
         std::ofstream outfile("main.cpp");
-        outfile << gen::prog(std::move(prog.value()));
+        if (via_ir)
+            outfile << IRGenerator().prog(IRBuilder().build(prog.value()));
+        else
+            outfile << Generator().prog(prog.value());
     }
 
-    //system("g++ -std=c++23 main.cpp -o app");
-    system("g++ -std=c++23 -Wall -Wextra main.cpp -o app"); // to remove
+    if (!native::run({ "g++", "-std=c++23", "-Wall", "-Wextra", "main.cpp", "-o", "app" }))
+    {
+        std::cerr << "[Error] compiling or linking failed" << std::endl;
+        return EXIT_FAILURE;
+    }
 
+    if (cached)
+        builds.store(outputs);
     return EXIT_SUCCESS;
 }
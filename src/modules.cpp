@@ -0,0 +1,223 @@
+#include "modules.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+
+ModuleLoader::Module::Module(const std::string& path, std::string key, int index)
+    : path(path), key(std::move(key)), source(path),
+      tokenizer(source.view(), path == "-" ? std::string_view{} : std::string_view(this->path)),
+      parser(tokenizer, index) {
+}
+
+size_t ModuleLoader::load_module(const std::string& path) {
+    std::error_code ec;
+    std::string key = path == "-" ? path : std::filesystem::weakly_canonical(path, ec).string();
+    if (ec)
+        key = path;
+
+    for (size_t i = 0; i < modules.size(); i++) {
+        if (modules[i]->key == key)
+            return i;
+    }
+
+    modules.push_back(std::make_unique<Module>(path, std::move(key), static_cast<int>(modules.size())));
+    return modules.size() - 1;
+}
+
+void ModuleLoader::discover() {
+    // the loop also reaches the modules loaded on the way
+    for (size_t i = 0; i < modules.size(); i++) {
+        const std::filesystem::path dir = modules[i]->path == "-"
+            ? std::filesystem::path()
+            : std::filesystem::path(modules[i]->path).parent_path();
+
+        for (const std::string_view import : modules[i]->parser.parse_imports()) {
+            const size_t imported = load_module((dir / import).string());
+
+            modules[i]->imports.push_back(imported);
+            modules[imported]->dependents.push_back(i);
+            modules[i]->parser.import(modules[imported]->parser);
+        }
+    }
+}
+
+void ModuleLoader::check_cycles() const {
+    enum class State { NEW, OPEN, DONE };
+    std::vector<State> states(modules.size(), State::NEW);
+
+    // depth first, a module met again while it is open imports itself
+    auto visit = [&](auto& self, size_t m) -> void {
+        states[m] = State::OPEN;
+
+        for (const size_t imported : modules[m]->imports) {
+            if (states[imported] == State::OPEN)
+                exit_with_error("[Error] import cycle through " + modules[imported]->path);
+            if (states[imported] == State::NEW)
+                self(self, imported);
+        }
+
+        states[m] = State::DONE;
+    };
+
+    for (size_t m = 0; m < modules.size(); m++) {
+        if (states[m] == State::NEW)
+            visit(visit, m);
+    }
+}
+
+void ModuleLoader::parse_all() {
+    // a single file needs no thread
+    if (modules.size() == 1) {
+        modules[0]->prog = modules[0]->parser.parse_prog();
+        return;
+    }
+
+    std::mutex lock;
+    std::condition_variable changed;
+    std::vector<size_t> ready;
+    std::vector<size_t> waiting(modules.size());
+    size_t parsed = 0;
+
+    for (size_t m = 0; m < modules.size(); m++) {
+        waiting[m] = modules[m]->imports.size();
+        if (waiting[m] == 0)
+            ready.push_back(m);
+    }
+
+    // a worker takes any ready module, the trees do not depend on the order
+    auto worker = [&] {
+        std::unique_lock guard(lock);
+
+        while (true) {
+            changed.wait(guard, [&] { return !ready.empty() || parsed == modules.size(); });
+            if (ready.empty())
+                return;
+
+            Module& module = *modules[ready.back()];
+            ready.pop_back();
+
+            guard.unlock();
+            module.prog = module.parser.parse_prog();
+            guard.lock();
+
+            parsed++;
+            for (const size_t d : module.dependents) {
+                if (--waiting[d] == 0)
+                    ready.push_back(d);
+            }
+            changed.notify_all();
+        }
+    };
+
+    const size_t count = std::min<size_t>(modules.size(), std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::jthread> threads;
+    for (size_t i = 0; i < count; i++)
+        threads.emplace_back(worker);
+}
+
+std::vector<size_t> ModuleLoader::merge_order() const {
+    // depth of a module: 0 without imports, one more than its deepest import otherwise
+    std::vector<int> depths(modules.size(), -1);
+
+    auto depth = [&](auto& self, size_t m) -> int {
+        if (depths[m] < 0) {
+            int d = 0;
+            for (const size_t imported : modules[m]->imports)
+                d = std::max(d, self(self, imported) + 1);
+            depths[m] = d;
+        }
+        return depths[m];
+    };
+
+    std::vector<size_t> order(modules.size());
+    for (size_t m = 0; m < modules.size(); m++) {
+        order[m] = m;
+        depth(depth, m);
+    }
+
+    std::ranges::stable_sort(order, {}, [&](size_t m) { return depths[m]; });
+    return order;
+}
+
+void ModuleLoader::check_names(const std::vector<size_t>& order) const {
+    IdentifierMap<size_t> owners;
+
+    auto declare = [&](size_t m, const Token& ident) {
+        const auto [it, inserted] = owners.try_emplace(std::string(ident.val.value()), m);
+        if (!inserted) {
+            exit_with_error("[Error] identifier '" + std::string(ident.val.value()) + "' already used on "
+                + modules[m]->tokenizer.location(ident.line) + ", declared in " + modules[it->second]->path);
+        }
+    };
+
+    for (const size_t m : order) {
+        for (const Node::ProgStmt* s : modules[m]->prog->stmts) {
+            if (const auto f = std::get_if<Node::FuncDeclaration*>(&s->var))
+                declare(m, (*f)->ident);
+            else if (const auto v = std::get_if<Node::StmtImplicitVar*>(&s->var))
+                declare(m, (*v)->identifier);
+            else
+                declare(m, std::get<Node::StmtExplicitVar*>(s->var)->ident);
+        }
+    }
+
+    // the inlined functions of a file end up in the others, they must read the same globals there
+    for (const size_t m : order) {
+        for (const Token& ident : modules[m]->parser.locals()) {
+            const auto it = owners.find(ident.val.value());
+            if (it != owners.end() && it->second != m) {
+                exit_with_error("[Error] identifier '" + std::string(ident.val.value()) + "' already used on "
+                    + modules[m]->tokenizer.location(ident.line) + ", declared in " + modules[it->second]->path);
+            }
+        }
+    }
+}
+
+void ModuleLoader::open(const std::vector<std::string>& paths) {
+    for (const std::string& path : paths)
+        load_module(path);
+
+    discover();
+    check_cycles();
+}
+
+std::vector<std::string_view> ModuleLoader::sources() const {
+    std::vector<std::string_view> views;
+    for (const std::unique_ptr<Module>& module : modules)
+        views.push_back(module->source.view());
+    return views;
+}
+
+std::optional<Node::Prog> ModuleLoader::parse() {
+    parse_all();
+
+    for (const std::unique_ptr<Module>& module : modules) {
+        if (!module->prog.has_value())
+            return {};
+    }
+
+    // within a file the parser already rejects the names used twice
+    const std::vector<size_t> order = merge_order();
+    if (modules.size() > 1)
+        check_names(order);
+
+    // the globals of each file follow the ones of the files before it
+    Node::Prog prog{ ArenaVector<Node::ProgStmt*>(&allocator) };
+    std::vector<int> bases(modules.size());
+
+    for (const size_t m : order) {
+        bases[m] = prog.global_slots;
+        prog.global_slots += modules[m]->prog->global_slots;
+
+        for (Node::ProgStmt* s : modules[m]->prog->stmts)
+            prog.stmts.push_back(s);
+    }
+
+    for (const std::unique_ptr<Module>& module : modules)
+        module->parser.relocate_globals(bases);
+
+    return prog;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "parser.h"
+#include "source.h"
+
+/// @brief the source files of a program: the files given and the ones they import (`import "file.ce"` at the
+/// top of a file, relative to its directory); each file is lexed and parsed on a worker thread into the arena of
+/// its own parser as soon as the files it imports are parsed, then the trees are merged into one program
+/// @note the names declared at the top level of a file are visible in the files importing it; they are shared
+/// by the whole program, so no other declaration of any file may take them
+class ModuleLoader {
+private:
+    struct Module {
+        /// @brief as given or as imported, named in the errors
+        std::string path;
+        /// @brief canonical path, two imports of one file load it once
+        std::string key;
+        SourceFile source;
+        Tokenizer tokenizer;
+        Parser parser;
+        /// @brief modules imported, by index
+        std::vector<size_t> imports;
+        /// @brief modules importing this one, parsed once all their imports are
+        std::vector<size_t> dependents;
+        std::optional<Node::Prog> prog;
+
+        Module(const std::string& path, std::string key, int index);
+    };
+
+    std::vector<std::unique_ptr<Module>> modules;
+
+    /// @brief holds the statements of the merged program
+    ArenaAllocator allocator;
+
+    /// @brief index of the module of a path, loaded the first time it is seen
+    size_t load_module(const std::string& path);
+
+    /// @brief read the imports of every module, loading the files they name
+    void discover();
+
+    /// @brief exit with an error if a file imports itself, directly or not
+    void check_cycles() const;
+
+    /// @brief parse every module on a pool of threads, each once its imports are parsed
+    void parse_all();
+
+    /// @brief modules in an order where every file comes after the files it imports, then as given
+    std::vector<size_t> merge_order() const;
+
+    /// @brief exit with an error if a name is declared at the top level of two files, or a local takes the name
+    /// of a top-level declaration of another file
+    void check_names(const std::vector<size_t>& order) const;
+
+public:
+    /// @brief read some files and all they import, exit with an error on an import cycle
+    void open(const std::vector<std::string>& paths);
+
+    /// @brief content of every file opened, the order only depends on the paths given and the contents
+    std::vector<std::string_view> sources() const;
+
+    /// @brief parse and merge the files opened
+    /// @return the merged tree (nothing if a file is not a valid program), valid as long as the loader lives
+    std::optional<Node::Prog> parse();
+};
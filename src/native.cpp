@@ -0,0 +1,631 @@
+#include "native.h"
+
+#include <cerrno>
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace {
+    // stdout is buffered like std::cout: flushed when full, by println (std::endl) and before exiting
+    constexpr std::string_view runtime = R"(
+    .bss
+    .lcomm cern_out_buf, 4096
+    .data
+cern_out_len:
+    .quad 0
+cern_empty:
+    .byte 0
+    .text
+cern_flush:
+    mov rdx, qword ptr [rip + cern_out_len]
+    test rdx, rdx
+    jz .Lflush_done
+    mov eax, 1
+    mov edi, 1
+    lea rsi, [rip + cern_out_buf]
+    syscall
+    mov qword ptr [rip + cern_out_len], 0
+.Lflush_done:
+    ret
+
+cern_putc:
+    mov rax, qword ptr [rip + cern_out_len]
+    cmp rax, 4096
+    jb .Lputc_store
+    push rdi
+    call cern_flush
+    pop rdi
+    xor eax, eax
+.Lputc_store:
+    lea rcx, [rip + cern_out_buf]
+    mov byte ptr [rcx + rax], dil
+    inc rax
+    mov qword ptr [rip + cern_out_len], rax
+    ret
+
+cern_puts:
+    push rbx
+    mov rbx, rdi
+.Lputs_loop:
+    movzx edi, byte ptr [rbx]
+    test dil, dil
+    jz .Lputs_done
+    call cern_putc
+    inc rbx
+    jmp .Lputs_loop
+.Lputs_done:
+    pop rbx
+    ret
+
+cern_puti:
+    push rbx
+    push r12
+    sub rsp, 24
+    movsxd rax, edi
+    lea r12, [rsp + 24]
+    mov rbx, r12
+    xor r8d, r8d
+    test rax, rax
+    jns .Lputi_digits
+    neg rax
+    mov r8d, 1
+.Lputi_digits:
+    mov r9d, 10
+.Lputi_loop:
+    xor edx, edx
+    div r9
+    add dl, 48
+    dec rbx
+    mov byte ptr [rbx], dl
+    test rax, rax
+    jnz .Lputi_loop
+    test r8d, r8d
+    jz .Lputi_write
+    dec rbx
+    mov byte ptr [rbx], 45
+.Lputi_write:
+    cmp rbx, r12
+    je .Lputi_done
+    movzx edi, byte ptr [rbx]
+    call cern_putc
+    inc rbx
+    jmp .Lputi_write
+.Lputi_done:
+    add rsp, 24
+    pop r12
+    pop rbx
+    ret
+)";
+
+    std::string label_name(std::string_view prefix, std::string_view ident) {
+        std::string s(prefix);
+        s += ident;
+        return s;
+    }
+}
+
+void NativeGenerator::exit_with(const std::string& err_msg) {
+    std::cerr << "[Native Error] " << err_msg << std::endl;
+    exit(EXIT_FAILURE);
+}
+
+std::string NativeGenerator::new_label() {
+    return ".L" + std::to_string(label_count++);
+}
+
+void NativeGenerator::emit(std::string_view instr) {
+    *out += "    ";
+    *out += instr;
+    *out += "\n";
+}
+
+const NativeGenerator::Variable& NativeGenerator::variable(std::string_view name) {
+    for (auto it = locals.rbegin(); it != locals.rend(); it++) {
+        if (const auto var = it->find(name); var != it->end())
+            return var->second;
+    }
+
+    if (const auto var = globals.find(name); var != globals.end())
+        return var->second;
+
+    exit_with("unknown variable `" + std::string(name) + "`");
+}
+
+std::string NativeGenerator::location(const Variable& var) {
+    if (var.global)
+        return "qword ptr [rip + cern_g" + std::to_string(var.offset) + "]";
+    return "qword ptr [rbp - " + std::to_string(var.offset) + "]";
+}
+
+std::string NativeGenerator::string_label(std::string_view lit) {
+    if (const auto it = string_labels.find(lit); it != string_labels.end())
+        return it->second;
+
+    std::string label = ".Lstr" + std::to_string(string_labels.size());
+    rodata += label + ":\n    .asciz \"";
+    rodata += lit;
+    rodata += "\"\n";
+
+    return string_labels[lit] = label;
+}
+
+std::string NativeGenerator::prog(const Node::Prog& p) {
+    bool has_main = false;
+    VarType main_type = VarType::VOID;
+
+    out = &init;
+
+    for (const Node::ProgStmt* s : p.stmts) {
+        if (const auto f = std::get_if<Node::FuncDeclaration*>(&s->var)) {
+            func(*f);
+
+            if ((*f)->ident.val.value() == "main") {
+                has_main = true;
+                main_type = (*f)->type;
+            }
+        }
+        else if (const auto v = std::get_if<Node::StmtImplicitVar*>(&s->var))
+            global((*v)->identifier, (*v)->expr->type, (*v)->expr);
+        else if (const auto v = std::get_if<Node::StmtExplicitVar*>(&s->var))
+            global((*v)->ident, (*v)->type, nullptr);
+    }
+
+    if (!has_main)
+        exit_with("no `main` function");
+
+    std::string s;
+    s += "    .intel_syntax noprefix\n";
+    s += runtime;
+
+    s += "    .section .rodata\n";
+    s += rodata;
+
+    s += "    .data\n";
+    s += data;
+
+    s += "    .text\n";
+    s += text;
+
+    s += "    .globl _start\n";
+    s += "_start:\n";
+    s += init;
+    s += "    call cern_f_main\n";
+    if (main_type == VarType::VOID)
+        s += "    xor ebx, ebx\n";
+    else
+        s += "    mov ebx, eax\n";
+    s += "    call cern_flush\n";
+    s += "    mov edi, ebx\n";
+    s += "    mov eax, 231\n";
+    s += "    syscall\n";
+
+    return s;
+}
+
+void NativeGenerator::global(const Token& ident, VarType type, const Node::Expr* e) {
+    const int index = static_cast<int>(globals.size());
+    const Variable& var = globals[ident.val.value()] = { type, true, index };
+
+    data += "cern_g" + std::to_string(index) + ":\n";
+    data += type == VarType::STRING ? "    .quad cern_empty\n" : "    .quad 0\n";
+
+    if (e != nullptr) {
+        expr(e);
+        emit("mov " + location(var) + ", rax");
+    }
+}
+
+void NativeGenerator::local(const Token& ident, VarType type, const Node::Expr* e) {
+    if (e != nullptr)
+        expr(e);
+    else if (type == VarType::STRING)
+        emit("lea rax, [rip + cern_empty]");
+    else
+        emit("xor eax, eax");
+
+    frame_size += 8;
+    const Variable& var = locals.back()[ident.val.value()] = { type, false, frame_size };
+    emit("mov " + location(var) + ", rax");
+}
+
+void NativeGenerator::func(const Node::FuncDeclaration* f) {
+    std::string body;
+    out = &body;
+    frame_size = 0;
+    return_label = new_label();
+
+    scope(f->scope);
+
+    // keep rsp 16 bytes aligned inside the function
+    const int frame = (frame_size + 15) / 16 * 16;
+
+    text += label_name("cern_f_", f->ident.val.value()) + ":\n";
+    text += "    push rbp\n";
+    text += "    mov rbp, rsp\n";
+    if (frame > 0)
+        text += "    sub rsp, " + std::to_string(frame) + "\n";
+    text += body;
+    text += return_label + ":\n";
+    text += "    leave\n";
+    text += "    ret\n\n";
+
+    out = &init;
+}
+
+void NativeGenerator::scope(const Node::Scope* sc) {
+    locals.emplace_back();
+
+    for (const Node::ScopeStmt* s : sc->stmts)
+        scope_stmt(s);
+
+    locals.pop_back();
+}
+
+void NativeGenerator::scope_stmt(const Node::ScopeStmt* s) {
+    struct ScopeStmtVisitor {
+        NativeGenerator& gen;
+
+        void operator()(const Node::StmtReturn* stmt_return) const {
+            gen.expr(stmt_return->expr);
+            gen.emit("jmp " + gen.return_label);
+        }
+
+        void operator()(const Node::StmtImplicitVar* stmt_var) const {
+            gen.local(stmt_var->identifier, stmt_var->expr->type, stmt_var->expr);
+        }
+
+        void operator()(const Node::StmtExplicitVar* stmt_var) const {
+            gen.local(stmt_var->ident, stmt_var->type, nullptr);
+        }
+
+        void operator()(const Node::StmtVarAssign* var_assign) const {
+            gen.expr(var_assign->expr);
+            gen.emit("mov " + gen.location(gen.variable(var_assign->ident.val.value())) + ", rax");
+        }
+
+        void operator()(const Node::FuncCall* fcall) const {
+            gen.call(fcall);
+        }
+
+        void operator()(const Node::VarIncr* i) const {
+            gen.step(i->ident, 1);
+        }
+
+        void operator()(const Node::VarDecr* d) const {
+            gen.step(d->ident, -1);
+        }
+
+        void operator()(const Node::Scope* s) const {
+            gen.scope(s);
+        }
+
+        void operator()(const Node::StmtWhile* w) const {
+            const std::string cond = gen.new_label();
+            const std::string end = gen.new_label();
+
+            *gen.out += cond + ":\n";
+            gen.expr(w->expr);
+            gen.emit("test eax, eax");
+            gen.emit("je " + end);
+            gen.scope(w->scope);
+            gen.emit("jmp " + cond);
+            *gen.out += end + ":\n";
+        }
+
+        void operator()(const Node::StmtIf* stmt_if) const {
+            const std::string next = gen.new_label();
+            const std::string end = gen.new_label();
+
+            gen.expr(stmt_if->expr);
+            gen.emit("test eax, eax");
+            gen.emit("je " + next);
+            gen.scope(stmt_if->scope);
+            gen.emit("jmp " + end);
+            *gen.out += next + ":\n";
+
+            if (stmt_if->pred.has_value())
+                gen.if_pred(stmt_if->pred.value(), end);
+
+            *gen.out += end + ":\n";
+        }
+    };
+
+    std::visit(ScopeStmtVisitor{ *this }, s->var);
+}
+
+void NativeGenerator::if_pred(const Node::IfPred* pred, const std::string& end_label) {
+    struct PredVisitor {
+        NativeGenerator& gen;
+        const std::string& end_label;
+
+        void operator()(const Node::IfPredElif* elif_pred) const {
+            const std::string next = gen.new_label();
+
+            gen.expr(elif_pred->expr);
+            gen.emit("test eax, eax");
+            gen.emit("je " + next);
+            gen.scope(elif_pred->scope);
+            gen.emit("jmp " + end_label);
+            *gen.out += next + ":\n";
+
+            if (elif_pred->pred.has_value())
+                gen.if_pred(elif_pred->pred.value(), end_label);
+        }
+
+        void operator()(const Node::IfPredElse* else_pred) const {
+            gen.scope(else_pred->scope);
+        }
+    };
+
+    std::visit(PredVisitor{ *this, end_label }, pred->var);
+}
+
+void NativeGenerator::expr(const Node::Expr* e) {
+    struct ExprVisitor {
+        NativeGenerator& gen;
+
+        void operator()(const Node::Term* t) const {
+            gen.term(t);
+        }
+
+        void operator()(const Node::BinExpr* bin_e) const {
+            gen.bin_expr(bin_e);
+        }
+
+        void operator()(const Node::ExprNot* e) const {
+            gen.expr(e->expr);
+            gen.emit("test eax, eax");
+            gen.emit("sete al");
+            gen.emit("movzx eax, al");
+        }
+
+        void operator()(const Node::VarIncr* i) const {
+            gen.step(i->ident, 1);
+        }
+
+        void operator()(const Node::VarDecr* d) const {
+            gen.step(d->ident, -1);
+        }
+    };
+
+    std::visit(ExprVisitor{ *this }, e->var);
+}
+
+void NativeGenerator::bin_expr(const Node::BinExpr* bin) {
+    if (bin->lside->type == VarType::STRING || bin->rside->type == VarType::STRING)
+        exit_with("string operations are not supported by the native backend");
+
+    // short circuit
+    if (bin->op == BinOp::AND || bin->op == BinOp::OR) {
+        const std::string shortcut = new_label();
+        const std::string end = new_label();
+        const std::string jump = bin->op == BinOp::AND ? "je " : "jne ";
+
+        expr(bin->lside);
+        emit("test eax, eax");
+        emit(jump + shortcut);
+        expr(bin->rside);
+        emit("test eax, eax");
+        emit(jump + shortcut);
+        emit(bin->op == BinOp::AND ? "mov eax, 1" : "xor eax, eax");
+        emit("jmp " + end);
+        *out += shortcut + ":\n";
+        emit(bin->op == BinOp::AND ? "xor eax, eax" : "mov eax, 1");
+        *out += end + ":\n";
+        return;
+    }
+
+    expr(bin->lside);
+    emit("push rax");
+    expr(bin->rside);
+    emit("mov rcx, rax");
+    emit("pop rax");
+
+    const auto compare = [this](std::string_view set) {
+        emit("cmp eax, ecx");
+        emit(std::string(set) + " al");
+        emit("movzx eax, al");
+    };
+
+    switch (bin->op) {
+    case BinOp::ADD:
+        emit("add eax, ecx");
+        break;
+    case BinOp::SUB:
+        emit("sub eax, ecx");
+        break;
+    case BinOp::MULTI:
+        emit("imul eax, ecx");
+        break;
+    case BinOp::DIV:
+        emit("cdq");
+        emit("idiv ecx");
+        break;
+    case BinOp::IS_EQUAL:
+        compare("sete");
+        break;
+    case BinOp::IS_NOT_EQUAL:
+        compare("setne");
+        break;
+    case BinOp::GREATER_OR_EQUAL:
+        compare("setge");
+        break;
+    case BinOp::GREATER:
+        compare("setg");
+        break;
+    case BinOp::LOWER_OR_EQUAL:
+        compare("setle");
+        break;
+    case BinOp::LOWER:
+        compare("setl");
+        break;
+    default:
+        assert(false); // unreachable
+    }
+
+    emit("movsxd rax, eax");
+}
+
+void NativeGenerator::term(const Node::Term* t) {
+    struct TermVisitor {
+        NativeGenerator& gen;
+
+        void operator()(const Node::TermBooleanLiteral* term_bool_lit) const {
+            gen.emit(term_bool_lit->value ? "mov eax, 1" : "xor eax, eax");
+        }
+
+        void operator()(const Node::TermIntegerLiteral* term_int_lit) const {
+            gen.emit("mov eax, " + std::to_string(term_int_lit->value));
+            gen.emit("movsxd rax, eax");
+        }
+
+        void operator()(const Node::TermCharLiteral* term_char_lit) const {
+            gen.emit("mov eax, " + std::to_string(static_cast<int>(term_char_lit->char_lit.val.value()[0])));
+        }
+
+        void operator()(const Node::TermStringLiteral* term_string_lit) const {
+            gen.emit("lea rax, [rip + " + gen.string_label(term_string_lit->string_lit.val.value()) + "]");
+        }
+
+        void operator()(const Node::TermIdentifier* term_ident) const {
+            gen.emit("mov rax, " + gen.location(gen.variable(term_ident->ident.val.value())));
+        }
+
+        void operator()(const Node::FuncCall* fcall) const {
+            gen.call(fcall);
+        }
+
+        void operator()(const Node::TermParen* term_paren) const {
+            gen.expr(term_paren->expr);
+        }
+    };
+
+    std::visit(TermVisitor{ *this }, t->var);
+}
+
+void NativeGenerator::step(const Node::TermIdentifier* ident, int delta) {
+    const std::string loc = location(variable(ident->ident.val.value()));
+
+    emit("mov rax, " + loc);
+    emit(std::string("lea ecx, [rax ") + (delta > 0 ? "+" : "-") + " 1]");
+    emit("movsxd rcx, ecx");
+    emit("mov " + loc + ", rcx");
+}
+
+void NativeGenerator::call(const Node::FuncCall* fcall) {
+    const std::string_view name = fcall->ident.val.value();
+
+    if (name == "print" || name == "println") {
+        for (const Node::Expr* arg : fcall->args) {
+            expr(arg);
+            emit("mov rdi, rax");
+
+            switch (arg->type) {
+            case VarType::INT:
+            case VarType::BOOL:
+                emit("call cern_puti");
+                break;
+            case VarType::CHAR:
+                emit("call cern_putc");
+                break;
+            case VarType::STRING:
+                emit("call cern_puts");
+                break;
+            default:
+                exit_with("cannot print a void expression");
+            }
+        }
+
+        if (name == "println") {
+            emit("mov edi, 10");
+            emit("call cern_putc");
+            emit("call cern_flush");
+        }
+        return;
+    }
+
+    if (name == "itoc" || name == "ctoi") {
+        if (fcall->args.size() != 1)
+            exit_with("function `" + std::string(name) + "` require one argument");
+
+        expr(fcall->args[0]);
+        emit(name == "itoc" ? "add eax, 48" : "sub eax, 48");
+        emit(name == "itoc" ? "movsx rax, al" : "movsxd rax, eax");
+        return;
+    }
+
+    if (!fcall->args.empty())
+        exit_with("function `" + std::string(name) + "` takes no argument");
+
+    emit("call " + label_name("cern_f_", name));
+}
+
+namespace native {
+    bool run(std::vector<std::string> args) {
+        std::vector<char*> argv;
+        for (std::string& a : args)
+            argv.push_back(a.data());
+        argv.push_back(nullptr);
+
+        pid_t pid;
+        if (posix_spawnp(&pid, argv[0], nullptr, nullptr, argv.data(), environ) != 0)
+            return false;
+
+        int status = 0;
+        if (waitpid(pid, &status, 0) < 0)
+            return false;
+
+        return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+
+    bool capture(std::vector<std::string> args, std::string& out) {
+        std::vector<char*> argv;
+        for (std::string& a : args)
+            argv.push_back(a.data());
+        argv.push_back(nullptr);
+
+        int fds[2];
+        if (pipe2(fds, O_CLOEXEC) != 0)
+            return false;
+
+        // the write end becomes its stdout, its stderr goes nowhere
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+        posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+
+        pid_t pid;
+        const int err = posix_spawnp(&pid, argv[0], &actions, nullptr, argv.data(), environ);
+        posix_spawn_file_actions_destroy(&actions);
+        close(fds[1]);
+
+        if (err != 0) {
+            close(fds[0]);
+            return false;
+        }
+
+        char buf[4096];
+        for (ssize_t n; (n = read(fds[0], buf, sizeof(buf))) != 0;) {
+            if (n > 0)
+                out.append(buf, static_cast<size_t>(n));
+            else if (errno != EINTR)
+                break;
+        }
+        close(fds[0]);
+
+        int status = 0;
+        if (waitpid(pid, &status, 0) < 0)
+            return false;
+
+        return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+
+    bool build(const std::string& asm_path, const std::string& obj_path, const std::string& exe_path) {
+        return run({ "as", "--64", "-o", obj_path, asm_path })
+            && run({ "ld", "-o", exe_path, obj_path });
+    }
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "parser.h"
+
+/// @brief x86-64 Linux backend: lowers a program to GNU assembly (intel syntax)
+/// linked against a small syscall based runtime, so no C++ toolchain is needed
+class NativeGenerator {
+private:
+    /// @brief a variable is either a global (label) or a local (offset from rbp)
+    struct Variable {
+        VarType type;
+        bool global;
+        int offset;
+    };
+
+    /// @brief buffer receiving the instructions being generated (function body or global init)
+    std::string* out = nullptr;
+    /// @brief read-only data (string literals)
+    std::string rodata;
+    /// @brief mutable data (globals)
+    std::string data;
+    /// @brief code of the functions
+    std::string text;
+    /// @brief code initializing the globals, run before main
+    std::string init;
+
+    std::unordered_map<std::string_view, Variable> globals;
+    /// @brief locals of the function being generated, one map per open scope
+    std::vector<std::unordered_map<std::string_view, Variable>> locals;
+    /// @brief bytes of stack used by the locals of the function being generated
+    int frame_size = 0;
+
+    std::unordered_map<std::string_view, std::string> string_labels;
+    size_t label_count = 0;
+    std::string return_label;
+
+    [[noreturn]] void exit_with(const std::string& err_msg);
+
+    std::string new_label();
+
+    void emit(std::string_view instr);
+
+    const Variable& variable(std::string_view name);
+
+    /// @brief operand addressing a variable
+    std::string location(const Variable& var);
+
+    std::string string_label(std::string_view lit);
+
+    void func(const Node::FuncDeclaration* f);
+
+    void global(const Token& ident, VarType type, const Node::Expr* e);
+
+    void local(const Token& ident, VarType type, const Node::Expr* e);
+
+    void scope(const Node::Scope* sc);
+
+    void scope_stmt(const Node::ScopeStmt* s);
+
+    void if_pred(const Node::IfPred* pred, const std::string& end_label);
+
+    /// @brief the value of an expression ends up in rax (sign extended for int and char)
+    void expr(const Node::Expr* e);
+
+    void bin_expr(const Node::BinExpr* bin);
+
+    void term(const Node::Term* t);
+
+    /// @brief increment or decrement a variable, its old value is left in rax
+    void step(const Node::TermIdentifier* ident, int delta);
+
+    void call(const Node::FuncCall* fcall);
+
+public:
+    /// @brief generate the assembly of a whole program
+    std::string prog(const Node::Prog& p);
+};
+
+namespace native {
+    /// @brief run a program found in the PATH and wait for it
+    /// @param args the program then its arguments, passed as they are (no shell)
+    /// @return false if it could not start or did not exit with 0
+    bool run(std::vector<std::string> args);
+
+    /// @brief run a program found in the PATH like `run`, and collect what it prints on stdout
+    /// @param out its output is appended to it, its stderr is discarded
+    /// @return false if it could not start or did not exit with 0
+    bool capture(std::vector<std::string> args, std::string& out);
+
+    /// @brief assemble and link generated assembly into an executable with `as` and `ld`
+    /// @return false if one of the tools failed
+    bool build(const std::string& asm_path, const std::string& obj_path, const std::string& exe_path);
+}
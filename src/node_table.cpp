@@ -0,0 +1,222 @@
+#include "node_table.h"
+
+NodeTable::NodeTable(const Node::Prog& p)
+    : global_slots(p.global_slots) {
+    // every function gets its FUNC node first, a body may call a function declared after it
+    for (const Node::ProgStmt* s : p.stmts) {
+        if (const auto f = std::get_if<Node::FuncDeclaration*>(&s->var)) {
+            const Index n = add(Kind::FUNC, (*f)->type, NONE, NONE, (*f)->frame_slots, add_token((*f)->ident));
+            function_nodes.emplace(*f, n);
+            functions.push_back(n);
+
+            if ((*f)->ident.val.value() == "main")
+                main = n;
+        }
+    }
+
+    for (const Node::ProgStmt* s : p.stmts) {
+        if (const auto f = std::get_if<Node::FuncDeclaration*>(&s->var))
+            rhs[function_nodes.at(*f)] = scope((*f)->scope);
+        else if (const auto v = std::get_if<Node::StmtImplicitVar*>(&s->var))
+            globals.push_back(add(Kind::DECLARE, (*v)->expr->type, expr((*v)->expr), NONE, encode((*v)->slot)));
+    }
+}
+
+NodeTable::Index NodeTable::add(Kind kind, VarType type, Index l, Index r, int32_t imm, Index token) {
+    kinds.push_back(kind);
+    types.push_back(type);
+    lhs.push_back(l);
+    rhs.push_back(r);
+    imms.push_back(imm);
+    token_ids.push_back(token);
+
+    return static_cast<Index>(kinds.size() - 1);
+}
+
+NodeTable::Index NodeTable::add_token(const Token& t) {
+    tokens.push_back(t);
+    return static_cast<Index>(tokens.size() - 1);
+}
+
+int32_t NodeTable::encode(VarSlot slot) {
+    return slot.global ? -slot.index - 1 : slot.index;
+}
+
+NodeTable::Index NodeTable::expr(const Node::Expr* e) {
+    struct ExprVisitor {
+        NodeTable& table;
+        VarType type;
+
+        Index operator()(const Node::Term* t) const {
+            return table.term(t, type);
+        }
+
+        Index operator()(const Node::BinExpr* bin) const {
+            const Index l = table.expr(bin->lside);
+            const Index r = table.expr(bin->rside);
+            return table.add(Kind::BIN, type, l, r, static_cast<int32_t>(bin->op));
+        }
+
+        Index operator()(const Node::ExprNot* e) const {
+            return table.add(Kind::NOT, type, table.expr(e->expr));
+        }
+
+        Index operator()(const Node::VarIncr* i) const {
+            return table.add(Kind::INCR, type, NONE, NONE, encode(i->ident->slot));
+        }
+
+        Index operator()(const Node::VarDecr* d) const {
+            return table.add(Kind::DECR, type, NONE, NONE, encode(d->ident->slot));
+        }
+    };
+
+    return std::visit(ExprVisitor{ *this, e->type }, e->var);
+}
+
+NodeTable::Index NodeTable::term(const Node::Term* t, VarType type) {
+    struct TermVisitor {
+        NodeTable& table;
+        VarType type;
+
+        Index operator()(const Node::TermBooleanLiteral* term_bool_lit) const {
+            return table.add(Kind::BOOL_LIT, type, NONE, NONE, term_bool_lit->value);
+        }
+
+        Index operator()(const Node::TermIntegerLiteral* term_int_lit) const {
+            return table.add(Kind::INT_LIT, type, NONE, NONE, term_int_lit->value);
+        }
+
+        Index operator()(const Node::TermCharLiteral* term_char_lit) const {
+            return table.add(Kind::CHAR_LIT, type, NONE, NONE, term_char_lit->char_lit.val.value()[0]);
+        }
+
+        Index operator()(const Node::TermStringLiteral* term_string_lit) const {
+            return table.add(Kind::STRING_LIT, type, NONE, NONE, 0, table.add_token(term_string_lit->string_lit));
+        }
+
+        Index operator()(const Node::TermIdentifier* term_ident) const {
+            return table.add(Kind::VAR, type, NONE, NONE, encode(term_ident->slot));
+        }
+
+        Index operator()(const Node::FuncCall* fcall) const {
+            return table.call(fcall, type);
+        }
+
+        // the grouping is in the shape of the tree already
+        Index operator()(const Node::TermParen* term_paren) const {
+            return table.expr(term_paren->expr);
+        }
+    };
+
+    return std::visit(TermVisitor{ *this, type }, t->var);
+}
+
+NodeTable::Index NodeTable::call(const Node::FuncCall* fcall, VarType type) {
+    std::vector<Index> args;
+    args.reserve(fcall->args.size());
+    for (const Node::Expr* arg : fcall->args)
+        args.push_back(expr(arg));
+
+    const Index first = static_cast<Index>(lists.size());
+    const Index count = static_cast<Index>(args.size());
+    lists.insert(lists.end(), args.begin(), args.end());
+
+    if (fcall->func != nullptr)
+        return add(Kind::CALL, type, first, count, function_nodes.at(fcall->func), add_token(fcall->ident));
+
+    const std::string_view name = fcall->ident.val.value();
+    const Kind kind = name == "print" ? Kind::PRINT
+        : name == "println" ? Kind::PRINTLN
+        : name == "itoc" ? Kind::ITOC
+        : Kind::CTOI;
+
+    return add(kind, type, first, count, 0, add_token(fcall->ident));
+}
+
+NodeTable::Index NodeTable::scope(const Node::Scope* sc) {
+    // the statements are flattened before the range of the scope is taken, their own scopes fill `lists` too
+    std::vector<Index> stmts;
+    stmts.reserve(sc->stmts.size());
+    for (const Node::ScopeStmt* s : sc->stmts)
+        stmts.push_back(scope_stmt(s));
+
+    const Index first = static_cast<Index>(lists.size());
+    lists.insert(lists.end(), stmts.begin(), stmts.end());
+
+    return add(Kind::SCOPE, sc->type, first, static_cast<Index>(stmts.size()));
+}
+
+NodeTable::Index NodeTable::scope_stmt(const Node::ScopeStmt* s) {
+    struct ScopeStmtVisitor {
+        NodeTable& table;
+
+        Index operator()(const Node::StmtReturn* stmt_return) const {
+            return table.add(Kind::RETURN, stmt_return->expr->type, table.expr(stmt_return->expr));
+        }
+
+        Index operator()(const Node::StmtImplicitVar* stmt_var) const {
+            const Index value = table.expr(stmt_var->expr);
+            return table.add(Kind::DECLARE, stmt_var->expr->type, value, NONE, encode(stmt_var->slot));
+        }
+
+        Index operator()(const Node::StmtExplicitVar* stmt_var) const {
+            return table.add(Kind::DECLARE, stmt_var->type, NONE, NONE, encode(stmt_var->slot));
+        }
+
+        Index operator()(const Node::StmtVarAssign* var_assign) const {
+            const Index value = table.expr(var_assign->expr);
+            return table.add(Kind::ASSIGN, var_assign->expr->type, value, NONE, encode(var_assign->slot));
+        }
+
+        Index operator()(const Node::FuncCall* fcall) const {
+            return table.call(fcall, fcall->type);
+        }
+
+        Index operator()(const Node::VarIncr* i) const {
+            return table.add(Kind::INCR, VarType::INT, NONE, NONE, encode(i->ident->slot));
+        }
+
+        Index operator()(const Node::VarDecr* d) const {
+            return table.add(Kind::DECR, VarType::INT, NONE, NONE, encode(d->ident->slot));
+        }
+
+        Index operator()(const Node::Scope* s) const {
+            return table.scope(s);
+        }
+
+        Index operator()(const Node::StmtWhile* w) const {
+            const Index cond = table.expr(w->expr);
+            const Index body = table.scope(w->scope);
+            return table.add(Kind::WHILE, VarType::VOID, cond, body);
+        }
+
+        Index operator()(const Node::StmtIf* stmt_if) const {
+            const Index cond = table.expr(stmt_if->expr);
+            const Index body = table.scope(stmt_if->scope);
+            const Index other = stmt_if->pred.has_value() ? table.if_pred(stmt_if->pred.value()) : NONE;
+            return table.add(Kind::IF, VarType::VOID, cond, body, other);
+        }
+    };
+
+    return std::visit(ScopeStmtVisitor{ *this }, s->var);
+}
+
+NodeTable::Index NodeTable::if_pred(const Node::IfPred* pred) {
+    struct PredVisitor {
+        NodeTable& table;
+
+        // an elif is an if nested in the else branch
+        Index operator()(const Node::IfPredElif* elif_pred) const {
+            const Index cond = table.expr(elif_pred->expr);
+            const Index body = table.scope(elif_pred->scope);
+            const Index other = elif_pred->pred.has_value() ? table.if_pred(elif_pred->pred.value()) : NONE;
+            return table.add(Kind::IF, VarType::VOID, cond, body, other);
+        }
+
+        Index operator()(const Node::IfPredElse* else_pred) const {
+            return table.scope(else_pred->scope);
+        }
+    };
+
+    return std::visit(PredVisitor{ *this }, pred->var);
+}
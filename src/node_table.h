@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "parser.h"
+
+/// @brief the syntax tree of a program flattened into a table: node i is the i-th entry of each array (struct of
+/// arrays), its operands are the indices of other nodes; the children of a node come before it (but the FUNC nodes,
+/// added first so every call can refer to its callee), so a pass reading the tree walks contiguous memory instead
+/// of chasing pointers through the arena
+/// @note built from the tree once it is optimized (the parser and the optimizer work on the pointer tree), the
+/// table never changes afterwards
+class NodeTable {
+public:
+    using Index = int32_t;
+
+    static constexpr Index NONE = -1;
+
+    enum class Kind : uint8_t {
+        // expressions, `type` is their value type
+
+        /// @brief imm: the value (0 or 1, the char, the int wrapped on 32 bits)
+        BOOL_LIT,
+        CHAR_LIT,
+        INT_LIT,
+        /// @brief token: the literal, as written
+        STRING_LIT,
+        /// @brief imm: the slot of the variable read, see `slot`
+        VAR,
+        /// @brief imm: the FUNC node called; lhs, rhs: the arguments in `lists` (the first one, the count)
+        CALL,
+        /// @brief imm: the operator (a BinOp); lhs, rhs: the operands
+        BIN,
+        /// @brief lhs: the operand
+        NOT,
+        /// @brief imm: the slot of the variable, its value before the step is the value of the node
+        INCR,
+        DECR,
+        /// @brief the buildin functions; lhs, rhs: the arguments in `lists` (the first one, the count)
+        PRINT,
+        PRINTLN,
+        ITOC,
+        CTOI,
+
+        // statements; a call, a step or a print as a statement is the expression node
+
+        /// @brief lhs, rhs: the statements in `lists` (the first one, the count)
+        SCOPE,
+        /// @brief imm: the slot of the variable; lhs: its initial value (NONE for a zeroed one)
+        DECLARE,
+        /// @brief imm: the slot of the variable; lhs: the value
+        ASSIGN,
+        /// @brief lhs: the value
+        RETURN,
+        /// @brief lhs: the condition; rhs: the body (a SCOPE)
+        WHILE,
+        /// @brief lhs: the condition; rhs: the body (a SCOPE); imm: the else branch (an IF for an elif, a SCOPE
+        /// for an else, NONE if there is none)
+        IF,
+        /// @brief rhs: the body (a SCOPE); imm: the number of local slots of a call frame; token: the name
+        FUNC
+    };
+
+    std::vector<Kind> kinds;
+    std::vector<VarType> types;
+    std::vector<Index> lhs;
+    std::vector<Index> rhs;
+    /// @brief immediate operand, its meaning depends on the kind
+    std::vector<int32_t> imms;
+    /// @brief index in `tokens` of the token of the node (NONE if it needs none)
+    std::vector<Index> token_ids;
+
+    /// @brief children of the nodes with a variable number of them, each node owns a contiguous range
+    std::vector<Index> lists;
+    std::vector<Token> tokens;
+
+    /// @brief declarations of the globals with an initial value, in declaration order
+    std::vector<Index> globals;
+    int global_slots = 0;
+    /// @brief FUNC nodes, in declaration order
+    std::vector<Index> functions;
+    /// @brief FUNC node of main (NONE if there is none)
+    Index main = NONE;
+
+    /// @brief flatten a program
+    explicit NodeTable(const Node::Prog& p);
+
+    size_t size() const { return kinds.size(); }
+
+    /// @brief slot of the variable of a VAR, INCR, DECR, DECLARE or ASSIGN node
+    VarSlot slot(Index n) const {
+        return imms[n] >= 0 ? VarSlot{ imms[n], false } : VarSlot{ -imms[n] - 1, true };
+    }
+
+    /// @brief value of the token of a node
+    std::string_view text(Index n) const { return tokens[token_ids[n]].val.value(); }
+
+private:
+    /// @brief FUNC node of each function, known before any body is flattened so a call finds its callee
+    std::unordered_map<const Node::FuncDeclaration*, Index> function_nodes;
+
+    Index add(Kind kind, VarType type, Index l = NONE, Index r = NONE, int32_t imm = 0, Index token = NONE);
+
+    Index add_token(const Token& t);
+
+    static int32_t encode(VarSlot slot);
+
+    Index expr(const Node::Expr* e);
+
+    Index term(const Node::Term* t, VarType type);
+
+    Index call(const Node::FuncCall* fcall, VarType type);
+
+    Index scope(const Node::Scope* sc);
+
+    Index scope_stmt(const Node::ScopeStmt* s);
+
+    Index if_pred(const Node::IfPred* pred);
+};
@@ -0,0 +1,1797 @@
+#include "optimizer.h"
+
+#include <algorithm>
+#include <charconv>
+#include <climits>
+
+std::optional<int64_t> Optimizer::constant(const Node::Expr* e) {
+    const auto t = std::get_if<Node::Term*>(&e->var);
+    if (t == nullptr)
+        return {};
+
+    if (const auto lit = std::get_if<Node::TermBooleanLiteral*>(&(*t)->var))
+        return (*lit)->value;
+
+    if (const auto lit = std::get_if<Node::TermIntegerLiteral*>(&(*t)->var)) {
+        // past INT_MAX the C++ literal is a long while the VM wraps it, keep it as written
+        const std::string_view text = (*lit)->int_lit.val.value();
+        int64_t value = 0;
+        const auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (ec != std::errc() || end != text.data() + text.size() || value > INT_MAX || value <= INT_MIN)
+            return {};
+        return value;
+    }
+
+    return {};
+}
+
+std::optional<int64_t> Optimizer::evaluate(BinOp op, int64_t l, int64_t r) {
+    int64_t value;
+
+    switch (op) {
+    case BinOp::ADD:
+        value = l + r;
+        break;
+    case BinOp::SUB:
+        value = l - r;
+        break;
+    case BinOp::MULTI:
+        value = l * r;
+        break;
+    case BinOp::DIV:
+        if (r == 0)
+            return {};
+        value = l / r;
+        break;
+    case BinOp::AND:
+        return l && r;
+    case BinOp::OR:
+        return l || r;
+    case BinOp::IS_EQUAL:
+        return l == r;
+    case BinOp::IS_NOT_EQUAL:
+        return l != r;
+    case BinOp::GREATER_OR_EQUAL:
+        return l >= r;
+    case BinOp::GREATER:
+        return l > r;
+    case BinOp::LOWER_OR_EQUAL:
+        return l <= r;
+    case BinOp::LOWER:
+        return l < r;
+    default:
+        return {};
+    }
+
+    // an overflow wraps differently depending on the backend, it is left to run time
+    // (INT_MIN is not folded either: `-2147483648` is a long in C++)
+    if (value > INT_MAX || value <= INT_MIN)
+        return {};
+    return value;
+}
+
+void Optimizer::set_constant(Node::Expr* e, int64_t value) {
+    Node::Term* t;
+
+    if (e->type == VarType::BOOL) {
+        const Token lit{ TokenType::BOOLEAN_LITEARL, 0, value ? "true" : "false" };
+        t = allocator.emplace<Node::Term>(allocator.emplace<Node::TermBooleanLiteral>(lit, value != 0));
+    }
+    else {
+        // the token value points into the arena like the others point into the source
+        char digits[16];
+        const auto [end, ec] = std::to_chars(digits, digits + sizeof(digits), value);
+        const size_t size = end - digits;
+
+        char* text = static_cast<char*>(allocator.allocate(size, 1));
+        std::copy(digits, end, text);
+
+        const Token lit{ TokenType::INTEGER_LITERAL, 0, std::string_view(text, size) };
+        t = allocator.emplace<Node::Term>(allocator.emplace<Node::TermIntegerLiteral>(lit, static_cast<int32_t>(value)));
+    }
+
+    t->type = e->type;
+    e->var = t;
+}
+
+void Optimizer::fold(Node::Prog& prog) {
+    for (Node::ProgStmt* s : prog.stmts) {
+        if (const auto f = std::get_if<Node::FuncDeclaration*>(&s->var))
+            scope((*f)->scope);
+        else if (const auto v = std::get_if<Node::StmtImplicitVar*>(&s->var))
+            expr((*v)->expr);
+    }
+}
+
+void Optimizer::scope(Node::Scope* sc) {
+    std::erase_if(sc->stmts, [this](Node::ScopeStmt* s) { return !scope_stmt(s); });
+}
+
+bool Optimizer::scope_stmt(Node::ScopeStmt* s) {
+    struct ScopeStmtVisitor {
+        Optimizer& opt;
+        Node::ScopeStmt* s;
+
+        bool operator()(Node::StmtReturn* stmt_return) const {
+            opt.expr(stmt_return->expr);
+            return true;
+        }
+
+        bool operator()(Node::StmtImplicitVar* stmt_var) const {
+            opt.expr(stmt_var->expr);
+            return true;
+        }
+
+        bool operator()(Node::StmtExplicitVar*) const {
+            return true;
+        }
+
+        bool operator()(Node::StmtVarAssign* var_assign) const {
+            opt.expr(var_assign->expr);
+            return true;
+        }
+
+        bool operator()(Node::FuncCall* fcall) const {
+            for (Node::Expr* arg : fcall->args)
+                opt.expr(arg);
+            return true;
+        }
+
+        bool operator()(Node::VarIncr*) const {
+            return true;
+        }
+
+        bool operator()(Node::VarDecr*) const {
+            return true;
+        }
+
+        bool operator()(Node::Scope* sc) const {
+            opt.scope(sc);
+            return true;
+        }
+
+        bool operator()(Node::StmtWhile* w) const {
+            opt.expr(w->expr);
+            opt.scope(w->scope);
+            return true;
+        }
+
+        bool operator()(Node::StmtIf* stmt_if) const {
+            opt.expr(stmt_if->expr);
+            opt.scope(stmt_if->scope);
+            stmt_if->pred = opt.if_pred(stmt_if->pred);
+
+            const auto cond = constant(stmt_if->expr);
+            if (!cond.has_value())
+                return true;
+
+            // always taken: only its scope is left
+            if (cond.value()) {
+                s->var = stmt_if->scope;
+                return true;
+            }
+
+            // never taken: the first remaining predicate (never constant) takes its place
+            if (!stmt_if->pred.has_value())
+                return false;
+
+            const Node::IfPred* pred = stmt_if->pred.value();
+            if (const auto elif_pred = std::get_if<Node::IfPredElif*>(&pred->var)) {
+                stmt_if->expr = (*elif_pred)->expr;
+                stmt_if->scope = (*elif_pred)->scope;
+                stmt_if->pred = (*elif_pred)->pred;
+            }
+            else
+                s->var = std::get<Node::IfPredElse*>(pred->var)->scope;
+
+            return true;
+        }
+    };
+
+    return std::visit(ScopeStmtVisitor{ *this, s }, s->var);
+}
+
+std::optional<Node::IfPred*> Optimizer::if_pred(std::optional<Node::IfPred*> pred) {
+    if (!pred.has_value())
+        return pred;
+
+    if (const auto else_pred = std::get_if<Node::IfPredElse*>(&pred.value()->var)) {
+        scope((*else_pred)->scope);
+        return pred;
+    }
+
+    Node::IfPredElif* elif_pred = std::get<Node::IfPredElif*>(pred.value()->var);
+
+    expr(elif_pred->expr);
+    scope(elif_pred->scope);
+    elif_pred->pred = if_pred(elif_pred->pred);
+
+    const auto cond = constant(elif_pred->expr);
+    if (!cond.has_value())
+        return pred;
+
+    // always taken: it becomes the else branch, the ones after it are dead
+    if (cond.value())
+        return allocator.emplace<Node::IfPred>(allocator.emplace<Node::IfPredElse>(elif_pred->scope));
+
+    return elif_pred->pred;
+}
+
+void Optimizer::expr(Node::Expr* e) {
+    struct ExprVisitor {
+        Optimizer& opt;
+        Node::Expr* e;
+
+        void operator()(Node::Term* t) const {
+            opt.term(e, t);
+        }
+
+        void operator()(Node::BinExpr* bin) const {
+            opt.bin_expr(e, bin);
+        }
+
+        void operator()(Node::ExprNot* n) const {
+            opt.expr(n->expr);
+
+            if (const auto value = constant(n->expr)) {
+                opt.set_constant(e, !value.value());
+                return;
+            }
+
+            // !!b
+            if (const auto inner = std::get_if<Node::ExprNot*>(&n->expr->var))
+                e->var = (*inner)->expr->var;
+        }
+
+        void operator()(Node::VarIncr*) const {
+        }
+
+        void operator()(Node::VarDecr*) const {
+        }
+    };
+
+    std::visit(ExprVisitor{ *this, e }, e->var);
+}
+
+void Optimizer::bin_expr(Node::Expr* e, Node::BinExpr* bin) {
+    expr(bin->lside);
+    expr(bin->rside);
+
+    const auto l = constant(bin->lside);
+    const auto r = constant(bin->rside);
+
+    if (l.has_value() && r.has_value()) {
+        if (const auto value = evaluate(bin->op, l.value(), r.value())) {
+            set_constant(e, value.value());
+            return;
+        }
+    }
+
+    // an operand takes the place of the operation (the expression keeps its type);
+    // + and - also accept bools and strings, only int operands are kept as they are
+    const auto keep = [e](const Node::Expr* operand) { e->var = operand->var; };
+    const bool l_int = bin->lside->type == VarType::INT;
+    const bool r_int = bin->rside->type == VarType::INT;
+
+    switch (bin->op) {
+    case BinOp::AND:
+        if (l.has_value()) {
+            if (l.value())
+                keep(bin->rside);
+            else
+                set_constant(e, 0);
+        }
+        else if (r == 1)
+            keep(bin->lside);
+        break;
+    case BinOp::OR:
+        if (l.has_value()) {
+            if (l.value())
+                set_constant(e, 1);
+            else
+                keep(bin->rside);
+        }
+        else if (r == 0)
+            keep(bin->lside);
+        break;
+    case BinOp::ADD:
+        if (l == 0 && r_int)
+            keep(bin->rside);
+        else if (r == 0 && l_int)
+            keep(bin->lside);
+        break;
+    case BinOp::SUB:
+        if (r == 0 && l_int)
+            keep(bin->lside);
+        break;
+    case BinOp::MULTI:
+        if (l == 1)
+            keep(bin->rside);
+        else if (r == 1)
+            keep(bin->lside);
+        break;
+    case BinOp::DIV:
+        if (r == 1)
+            keep(bin->lside);
+        break;
+    default:
+        break;
+    }
+}
+
+void Optimizer::term(Node::Expr* e, Node::Term* t) {
+    if (const auto fcall = std::get_if<Node::FuncCall*>(&t->var)) {
+        for (Node::Expr* arg : (*fcall)->args)
+            expr(arg);
+    }
+    else if (const auto paren = std::get_if<Node::TermParen*>(&t->var)) {
+        expr((*paren)->expr);
+
+        // a term needs no parentheses
+        if (std::holds_alternative<Node::Term*>((*paren)->expr->var))
+            e->var = (*paren)->expr->var;
+    }
+}
+
+bool Optimizer::has_effects(const Node::Expr* e) {
+    struct ExprVisitor {
+        bool operator()(const Node::Term* t) const {
+            if (std::holds_alternative<Node::FuncCall*>(t->var))
+                return true;
+            if (const auto paren = std::get_if<Node::TermParen*>(&t->var))
+                return has_effects((*paren)->expr);
+            return false;
+        }
+
+        bool operator()(const Node::BinExpr* bin) const {
+            // a division traps on a zero divisor, unless it is a non-zero literal
+            if (bin->op == BinOp::DIV && constant(bin->rside).value_or(0) == 0)
+                return true;
+            return has_effects(bin->lside) || has_effects(bin->rside);
+        }
+
+        bool operator()(const Node::ExprNot* n) const {
+            return has_effects(n->expr);
+        }
+
+        bool operator()(const Node::VarIncr*) const {
+            return true;
+        }
+
+        bool operator()(const Node::VarDecr*) const {
+            return true;
+        }
+    };
+
+    return std::visit(ExprVisitor{}, e->var);
+}
+
+void Optimizer::use_func(const Node::FuncDeclaration* f) {
+    // buildin functions have no declaration
+    if (f != nullptr && live_funcs.insert(f).second)
+        pending.push_back(f);
+}
+
+void Optimizer::use_var(VarSlot slot) {
+    if (slot.global)
+        live_globals[slot.index] = true;
+}
+
+void Optimizer::eliminate(Node::Prog& prog) {
+    const Node::FuncDeclaration* main = nullptr;
+    for (const Node::ProgStmt* s : prog.stmts) {
+        if (const auto f = std::get_if<Node::FuncDeclaration*>(&s->var); f && (*f)->ident.val.value() == "main")
+            main = *f;
+    }
+
+    // without main the backends report the error on the whole program
+    if (main == nullptr)
+        return;
+
+    live_funcs.clear();
+    pending.clear();
+    live_globals.assign(prog.global_slots, false);
+    removals.clear();
+
+    // the initializers run before main whether the global is used or not
+    for (const Node::ProgStmt* s : prog.stmts) {
+        if (const auto v = std::get_if<Node::StmtImplicitVar*>(&s->var); v && has_effects((*v)->expr))
+            use_var((*v)->slot);
+    }
+    use_func(main);
+
+    // a live initializer makes the globals and functions it uses live, which makes more code live
+    std::vector<bool> walked(prog.global_slots, false);
+    bool changed = true;
+
+    while (changed) {
+        changed = false;
+
+        while (!pending.empty()) {
+            current = pending.back();
+            pending.pop_back();
+            live_scope(current->scope);
+        }
+        current = nullptr;
+
+        for (const Node::ProgStmt* s : prog.stmts) {
+            const auto v = std::get_if<Node::StmtImplicitVar*>(&s->var);
+            if (v == nullptr || !live_globals[(*v)->slot.index] || walked[(*v)->slot.index])
+                continue;
+
+            walked[(*v)->slot.index] = true;
+            live_expr((*v)->expr);
+            changed = true;
+        }
+    }
+
+    std::erase_if(prog.stmts, [this](const Node::ProgStmt* s) {
+        if (const auto f = std::get_if<Node::FuncDeclaration*>(&s->var)) {
+            if (live_funcs.contains(*f))
+                return false;
+            removals.push_back("func `" + std::string((*f)->ident.val.value()) + "` (line "
+                + std::to_string((*f)->ident.line) + ")");
+            return true;
+        }
+
+        const auto v = std::get_if<Node::StmtImplicitVar*>(&s->var);
+        const Token& ident = v ? (*v)->identifier : std::get<Node::StmtExplicitVar*>(s->var)->ident;
+        const VarSlot slot = v ? (*v)->slot : std::get<Node::StmtExplicitVar*>(s->var)->slot;
+
+        if (live_globals[slot.index])
+            return false;
+        removals.push_back("var `" + std::string(ident.val.value()) + "` (line " + std::to_string(ident.line) + ")");
+        return true;
+    });
+}
+
+bool Optimizer::live_scope(Node::Scope* sc) {
+    for (size_t i = 0; i < sc->stmts.size(); i++) {
+        if (!live_stmt(sc->stmts[i]))
+            continue;
+
+        // nothing after a statement which always returns can run
+        const size_t dead = sc->stmts.size() - i - 1;
+        if (dead > 0) {
+            removals.push_back(std::to_string(dead) + (dead == 1 ? " statement" : " statements")
+                + " after a return in func `" + std::string(current->ident.val.value()) + "`");
+            sc->stmts.erase(sc->stmts.begin() + i + 1, sc->stmts.end());
+        }
+        return true;
+    }
+
+    return false;
+}
+
+bool Optimizer::live_stmt(Node::ScopeStmt* s) {
+    struct ScopeStmtVisitor {
+        Optimizer& opt;
+
+        bool operator()(const Node::StmtReturn* stmt_return) const {
+            opt.live_expr(stmt_return->expr);
+            return true;
+        }
+
+        bool operator()(const Node::StmtImplicitVar* stmt_var) const {
+            opt.live_expr(stmt_var->expr);
+            return false;
+        }
+
+        bool operator()(const Node::StmtExplicitVar*) const {
+            return false;
+        }
+
+        bool operator()(const Node::StmtVarAssign* var_assign) const {
+            opt.use_var(var_assign->slot);
+            opt.live_expr(var_assign->expr);
+            return false;
+        }
+
+        bool operator()(const Node::FuncCall* fcall) const {
+            opt.use_func(fcall->func);
+            for (const Node::Expr* arg : fcall->args)
+                opt.live_expr(arg);
+            return false;
+        }
+
+        bool operator()(const Node::VarIncr* i) const {
+            opt.use_var(i->ident->slot);
+            return false;
+        }
+
+        bool operator()(const Node::VarDecr* d) const {
+            opt.use_var(d->ident->slot);
+            return false;
+        }
+
+        bool operator()(Node::Scope* sc) const {
+            return opt.live_scope(sc);
+        }
+
+        bool operator()(const Node::StmtWhile* w) const {
+            // the body may not run at all
+            opt.live_expr(w->expr);
+            opt.live_scope(w->scope);
+            return false;
+        }
+
+        bool operator()(const Node::StmtIf* stmt_if) const {
+            opt.live_expr(stmt_if->expr);
+            const bool returns = opt.live_scope(stmt_if->scope);
+
+            if (!stmt_if->pred.has_value())
+                return false;
+            return opt.live_pred(stmt_if->pred.value()) && returns;
+        }
+    };
+
+    return std::visit(ScopeStmtVisitor{ *this }, s->var);
+}
+
+bool Optimizer::live_pred(Node::IfPred* pred) {
+    if (const auto else_pred = std::get_if<Node::IfPredElse*>(&pred->var))
+        return live_scope((*else_pred)->scope);
+
+    const Node::IfPredElif* elif_pred = std::get<Node::IfPredElif*>(pred->var);
+
+    live_expr(elif_pred->expr);
+    const bool returns = live_scope(elif_pred->scope);
+
+    if (!elif_pred->pred.has_value())
+        return false;
+    return live_pred(elif_pred->pred.value()) && returns;
+}
+
+void Optimizer::live_expr(const Node::Expr* e) {
+    struct ExprVisitor {
+        Optimizer& opt;
+
+        void operator()(const Node::Term* t) const {
+            if (const auto ident = std::get_if<Node::TermIdentifier*>(&t->var))
+                opt.use_var((*ident)->slot);
+            else if (const auto fcall = std::get_if<Node::FuncCall*>(&t->var)) {
+                opt.use_func((*fcall)->func);
+                for (const Node::Expr* arg : (*fcall)->args)
+                    opt.live_expr(arg);
+            }
+            else if (const auto paren = std::get_if<Node::TermParen*>(&t->var))
+                opt.live_expr((*paren)->expr);
+        }
+
+        void operator()(const Node::BinExpr* bin) const {
+            opt.live_expr(bin->lside);
+            opt.live_expr(bin->rside);
+        }
+
+        void operator()(const Node::ExprNot* n) const {
+            opt.live_expr(n->expr);
+        }
+
+        void operator()(const Node::VarIncr* i) const {
+            opt.use_var(i->ident->slot);
+        }
+
+        void operator()(const Node::VarDecr* d) const {
+            opt.use_var(d->ident->slot);
+        }
+    };
+
+    std::visit(ExprVisitor{ *this }, e->var);
+}
+
+namespace {
+    // slot of a variable copied into the caller's frame
+    VarSlot moved(VarSlot slot, int offset) {
+        return slot.global ? slot : VarSlot{ slot.index + offset, false };
+    }
+}
+
+int Optimizer::cost(const Node::Scope* sc) {
+    int n = 1;
+    for (const Node::ScopeStmt* s : sc->stmts)
+        n += cost(s);
+    return n;
+}
+
+int Optimizer::cost(const Node::ScopeStmt* s) {
+    struct ScopeStmtVisitor {
+        int operator()(const Node::StmtReturn* stmt_return) const {
+            return 1 + cost(stmt_return->expr);
+        }
+
+        int operator()(const Node::StmtImplicitVar* stmt_var) const {
+            return 1 + cost(stmt_var->expr);
+        }
+
+        int operator()(const Node::StmtExplicitVar*) const {
+            return 1;
+        }
+
+        int operator()(const Node::StmtVarAssign* var_assign) const {
+            return 1 + cost(var_assign->expr);
+        }
+
+        int operator()(const Node::FuncCall* fcall) const {
+            int n = 1;
+            for (const Node::Expr* arg : fcall->args)
+                n += cost(arg);
+            return n;
+        }
+
+        int operator()(const Node::VarIncr*) const {
+            return 1;
+        }
+
+        int operator()(const Node::VarDecr*) const {
+            return 1;
+        }
+
+        int operator()(const Node::Scope* sc) const {
+            return cost(sc);
+        }
+
+        int operator()(const Node::StmtWhile* w) const {
+            return 1 + cost(w->expr) + cost(w->scope);
+        }
+
+        int operator()(const Node::StmtIf* stmt_if) const {
+            int n = 1 + cost(stmt_if->expr) + cost(stmt_if->scope);
+
+            for (std::optional<Node::IfPred*> pred = stmt_if->pred; pred.has_value();) {
+                if (const auto elif_pred = std::get_if<Node::IfPredElif*>(&pred.value()->var)) {
+                    n += 1 + cost((*elif_pred)->expr) + cost((*elif_pred)->scope);
+                    pred = (*elif_pred)->pred;
+                }
+                else {
+                    n += 1 + cost(std::get<Node::IfPredElse*>(pred.value()->var)->scope);
+                    break;
+                }
+            }
+
+            return n;
+        }
+    };
+
+    return std::visit(ScopeStmtVisitor{}, s->var);
+}
+
+int Optimizer::cost(const Node::Expr* e) {
+    struct ExprVisitor {
+        int operator()(const Node::Term* t) const {
+            if (const auto fcall = std::get_if<Node::FuncCall*>(&t->var)) {
+                int n = 1;
+                for (const Node::Expr* arg : (*fcall)->args)
+                    n += cost(arg);
+                return n;
+            }
+            if (const auto paren = std::get_if<Node::TermParen*>(&t->var))
+                return 1 + cost((*paren)->expr);
+            return 1;
+        }
+
+        int operator()(const Node::BinExpr* bin) const {
+            return 1 + cost(bin->lside) + cost(bin->rside);
+        }
+
+        int operator()(const Node::ExprNot* n) const {
+            return 1 + cost(n->expr);
+        }
+
+        int operator()(const Node::VarIncr*) const {
+            return 1;
+        }
+
+        int operator()(const Node::VarDecr*) const {
+            return 1;
+        }
+    };
+
+    return std::visit(ExprVisitor{}, e->var);
+}
+
+bool Optimizer::has_return(const Node::Scope* sc) {
+    for (const Node::ScopeStmt* s : sc->stmts) {
+        if (std::holds_alternative<Node::StmtReturn*>(s->var))
+            return true;
+        if (const auto inner = std::get_if<Node::Scope*>(&s->var); inner && has_return(*inner))
+            return true;
+        if (const auto w = std::get_if<Node::StmtWhile*>(&s->var); w && has_return((*w)->scope))
+            return true;
+
+        const auto stmt_if = std::get_if<Node::StmtIf*>(&s->var);
+        if (stmt_if == nullptr)
+            continue;
+        if (has_return((*stmt_if)->scope))
+            return true;
+
+        for (std::optional<Node::IfPred*> pred = (*stmt_if)->pred; pred.has_value();) {
+            if (const auto elif_pred = std::get_if<Node::IfPredElif*>(&pred.value()->var)) {
+                if (has_return((*elif_pred)->scope))
+                    return true;
+                pred = (*elif_pred)->pred;
+            }
+            else
+                return has_return(std::get<Node::IfPredElse*>(pred.value()->var)->scope);
+        }
+    }
+
+    return false;
+}
+
+const Node::Expr* Optimizer::returned_expr(const Node::FuncDeclaration* f) {
+    if (f->scope->stmts.size() != 1)
+        return nullptr;
+
+    const auto stmt_return = std::get_if<Node::StmtReturn*>(&f->scope->stmts[0]->var);
+    return stmt_return != nullptr ? (*stmt_return)->expr : nullptr;
+}
+
+Node::Scope* Optimizer::clone(const Node::Scope* sc, int offset) {
+    auto copy = allocator.emplace<Node::Scope>(ArenaVector<Node::ScopeStmt*>(&allocator), sc->type);
+
+    for (const Node::ScopeStmt* s : sc->stmts)
+        copy->stmts.push_back(clone(s, offset));
+
+    return copy;
+}
+
+Node::ScopeStmt* Optimizer::clone(const Node::ScopeStmt* s, int offset) {
+    struct ScopeStmtVisitor {
+        Optimizer& opt;
+        int offset;
+
+        using Var = decltype(Node::ScopeStmt::var);
+
+        Var operator()(const Node::StmtReturn* stmt_return) const {
+            return opt.allocator.emplace<Node::StmtReturn>(opt.clone(stmt_return->expr, offset));
+        }
+
+        Var operator()(const Node::StmtImplicitVar* stmt_var) const {
+            return opt.allocator.emplace<Node::StmtImplicitVar>(
+                stmt_var->identifier, opt.clone(stmt_var->expr, offset), moved(stmt_var->slot, offset));
+        }
+
+        Var operator()(const Node::StmtExplicitVar* stmt_var) const {
+            return opt.allocator.emplace<Node::StmtExplicitVar>(
+                stmt_var->ident, stmt_var->type, moved(stmt_var->slot, offset));
+        }
+
+        Var operator()(const Node::StmtVarAssign* var_assign) const {
+            return opt.allocator.emplace<Node::StmtVarAssign>(
+                var_assign->ident, opt.clone(var_assign->expr, offset), moved(var_assign->slot, offset));
+        }
+
+        Var operator()(const Node::FuncCall* fcall) const {
+            return opt.clone(fcall, offset);
+        }
+
+        Var operator()(const Node::VarIncr* i) const {
+            return opt.allocator.emplace<Node::VarIncr>(opt.clone(i->ident, offset));
+        }
+
+        Var operator()(const Node::VarDecr* d) const {
+            return opt.allocator.emplace<Node::VarDecr>(opt.clone(d->ident, offset));
+        }
+
+        Var operator()(const Node::Scope* sc) const {
+            return opt.clone(sc, offset);
+        }
+
+        Var operator()(const Node::StmtWhile* w) const {
+            return opt.allocator.emplace<Node::StmtWhile>(opt.clone(w->expr, offset), opt.clone(w->scope, offset));
+        }
+
+        Var operator()(const Node::StmtIf* stmt_if) const {
+            auto copy = opt.allocator.emplace<Node::StmtIf>(
+                opt.clone(stmt_if->expr, offset), opt.clone(stmt_if->scope, offset));
+            if (stmt_if->pred.has_value())
+                copy->pred = opt.clone(stmt_if->pred.value(), offset);
+            return copy;
+        }
+    };
+
+    return allocator.emplace<Node::ScopeStmt>(std::visit(ScopeStmtVisitor{ *this, offset }, s->var), s->type);
+}
+
+Node::IfPred* Optimizer::clone(const Node::IfPred* pred, int offset) {
+    if (const auto else_pred = std::get_if<Node::IfPredElse*>(&pred->var))
+        return allocator.emplace<Node::IfPred>(allocator.emplace<Node::IfPredElse>(clone((*else_pred)->scope, offset)));
+
+    const Node::IfPredElif* elif_pred = std::get<Node::IfPredElif*>(pred->var);
+    auto copy = allocator.emplace<Node::IfPredElif>(clone(elif_pred->expr, offset), clone(elif_pred->scope, offset));
+    if (elif_pred->pred.has_value())
+        copy->pred = clone(elif_pred->pred.value(), offset);
+
+    return allocator.emplace<Node::IfPred>(copy);
+}
+
+Node::Expr* Optimizer::clone(const Node::Expr* e, int offset) {
+    struct TermVisitor {
+        Optimizer& opt;
+        int offset;
+
+        using Var = decltype(Node::Term::var);
+
+        // literals are never rewritten in place, the copy shares them
+        Var operator()(Node::TermBooleanLiteral* lit) const {
+            return lit;
+        }
+
+        Var operator()(Node::TermIntegerLiteral* lit) const {
+            return lit;
+        }
+
+        Var operator()(Node::TermCharLiteral* lit) const {
+            return lit;
+        }
+
+        Var operator()(Node::TermStringLiteral* lit) const {
+            return lit;
+        }
+
+        Var operator()(const Node::TermIdentifier* ident) const {
+            return opt.clone(ident, offset);
+        }
+
+        Var operator()(const Node::FuncCall* fcall) const {
+            return opt.clone(fcall, offset);
+        }
+
+        Var operator()(const Node::TermParen* paren) const {
+            return opt.allocator.emplace<Node::TermParen>(opt.clone(paren->expr, offset));
+        }
+    };
+
+    struct ExprVisitor {
+        Optimizer& opt;
+        int offset;
+
+        using Var = decltype(Node::Expr::var);
+
+        Var operator()(const Node::Term* t) const {
+            return opt.allocator.emplace<Node::Term>(std::visit(TermVisitor{ opt, offset }, t->var), t->type);
+        }
+
+        Var operator()(const Node::BinExpr* bin) const {
+            return opt.allocator.emplace<Node::BinExpr>(bin->op, opt.clone(bin->lside, offset), opt.clone(bin->rside, offset));
+        }
+
+        Var operator()(const Node::ExprNot* n) const {
+            return opt.allocator.emplace<Node::ExprNot>(opt.clone(n->expr, offset));
+        }
+
+        Var operator()(const Node::VarIncr* i) const {
+            return opt.allocator.emplace<Node::VarIncr>(opt.clone(i->ident, offset));
+        }
+
+        Var operator()(const Node::VarDecr* d) const {
+            return opt.allocator.emplace<Node::VarDecr>(opt.clone(d->ident, offset));
+        }
+    };
+
+    return allocator.emplace<Node::Expr>(std::visit(ExprVisitor{ *this, offset }, e->var), e->type);
+}
+
+Node::TermIdentifier* Optimizer::clone(const Node::TermIdentifier* ident, int offset) {
+    return allocator.emplace<Node::TermIdentifier>(ident->ident, ident->type, moved(ident->slot, offset));
+}
+
+Node::FuncCall* Optimizer::clone(const Node::FuncCall* fcall, int offset) {
+    auto copy = allocator.emplace<Node::FuncCall>(fcall->ident, ArenaVector<Node::Expr*>(&allocator), fcall->type, fcall->func);
+
+    for (const Node::Expr* arg : fcall->args)
+        copy->args.push_back(clone(arg, offset));
+
+    return copy;
+}
+
+void Optimizer::inline_calls(Node::Prog& prog, int threshold) {
+    inline_threshold = threshold;
+
+    // a function only calls the ones declared before it (there is no recursion): the calls in
+    // its callees are already inlined when its turn comes
+    for (Node::ProgStmt* s : prog.stmts) {
+        inline_budget = 4 * threshold;
+
+        if (const auto f = std::get_if<Node::FuncDeclaration*>(&s->var)) {
+            caller = *f;
+            inline_scope(caller->scope);
+        }
+        else if (const auto v = std::get_if<Node::StmtImplicitVar*>(&s->var)) {
+            caller = nullptr;
+            inline_expr((*v)->expr);
+        }
+    }
+
+    caller = nullptr;
+}
+
+bool Optimizer::take_budget(int cost) {
+    if (cost > inline_threshold || cost > inline_budget)
+        return false;
+
+    inline_budget -= cost;
+    return true;
+}
+
+void Optimizer::inline_scope(Node::Scope* sc) {
+    for (Node::ScopeStmt* s : sc->stmts) {
+        struct ScopeStmtVisitor {
+            Optimizer& opt;
+            Node::ScopeStmt* s;
+
+            void operator()(Node::StmtReturn* stmt_return) const {
+                opt.inline_expr(stmt_return->expr);
+            }
+
+            void operator()(Node::StmtImplicitVar* stmt_var) const {
+                opt.inline_expr(stmt_var->expr);
+            }
+
+            void operator()(Node::StmtExplicitVar*) const {
+            }
+
+            void operator()(Node::StmtVarAssign* var_assign) const {
+                opt.inline_expr(var_assign->expr);
+            }
+
+            void operator()(Node::FuncCall* fcall) const {
+                for (Node::Expr* arg : fcall->args)
+                    opt.inline_expr(arg);
+
+                // the body takes the place of the call as a nested scope, its locals get
+                // fresh slots at the end of the caller's frame
+                const Node::FuncDeclaration* f = fcall->func;
+                if (f == nullptr || opt.caller == nullptr || has_return(f->scope) || !opt.take_budget(cost(f->scope)))
+                    return;
+
+                const int offset = opt.caller->frame_slots;
+                opt.caller->frame_slots += f->frame_slots;
+                s->var = opt.clone(f->scope, offset);
+            }
+
+            void operator()(Node::VarIncr*) const {
+            }
+
+            void operator()(Node::VarDecr*) const {
+            }
+
+            void operator()(Node::Scope* sc) const {
+                opt.inline_scope(sc);
+            }
+
+            void operator()(Node::StmtWhile* w) const {
+                opt.inline_expr(w->expr);
+                opt.inline_scope(w->scope);
+            }
+
+            void operator()(Node::StmtIf* stmt_if) const {
+                opt.inline_expr(stmt_if->expr);
+                opt.inline_scope(stmt_if->scope);
+                if (stmt_if->pred.has_value())
+                    opt.inline_pred(stmt_if->pred.value());
+            }
+        };
+
+        std::visit(ScopeStmtVisitor{ *this, s }, s->var);
+    }
+}
+
+void Optimizer::inline_pred(Node::IfPred* pred) {
+    if (const auto else_pred = std::get_if<Node::IfPredElse*>(&pred->var)) {
+        inline_scope((*else_pred)->scope);
+        return;
+    }
+
+    Node::IfPredElif* elif_pred = std::get<Node::IfPredElif*>(pred->var);
+
+    inline_expr(elif_pred->expr);
+    inline_scope(elif_pred->scope);
+    if (elif_pred->pred.has_value())
+        inline_pred(elif_pred->pred.value());
+}
+
+void Optimizer::inline_expr(Node::Expr* e) {
+    struct ExprVisitor {
+        Optimizer& opt;
+        Node::Expr* e;
+
+        void operator()(Node::Term* t) const {
+            if (const auto paren = std::get_if<Node::TermParen*>(&t->var)) {
+                opt.inline_expr((*paren)->expr);
+                return;
+            }
+
+            const auto fcall = std::get_if<Node::FuncCall*>(&t->var);
+            if (fcall == nullptr)
+                return;
+
+            for (Node::Expr* arg : (*fcall)->args)
+                opt.inline_expr(arg);
+
+            // `return expr` declares no local, the expression is copied as it is
+            const Node::FuncDeclaration* f = (*fcall)->func;
+            const Node::Expr* returned = f != nullptr ? returned_expr(f) : nullptr;
+            if (returned != nullptr && opt.take_budget(cost(f->scope)))
+                e->var = opt.clone(returned, 0)->var;
+        }
+
+        void operator()(Node::BinExpr* bin) const {
+            opt.inline_expr(bin->lside);
+            opt.inline_expr(bin->rside);
+        }
+
+        void operator()(Node::ExprNot* n) const {
+            opt.inline_expr(n->expr);
+        }
+
+        void operator()(Node::VarIncr*) const {
+        }
+
+        void operator()(Node::VarDecr*) const {
+        }
+    };
+
+    std::visit(ExprVisitor{ *this, e }, e->var);
+}
+
+std::string Optimizer::key(const Node::Expr* e) {
+    struct TermVisitor {
+        // the kind and size of a literal come first, no two literals share a key
+        static std::string literal(char kind, std::string_view text) {
+            return kind + std::to_string(text.size()) + ":" + std::string(text);
+        }
+
+        std::string operator()(const Node::TermBooleanLiteral* lit) const {
+            return literal('b', lit->bool_lit.val.value());
+        }
+
+        std::string operator()(const Node::TermIntegerLiteral* lit) const {
+            return literal('i', lit->int_lit.val.value());
+        }
+
+        std::string operator()(const Node::TermCharLiteral* lit) const {
+            return literal('c', lit->char_lit.val.value());
+        }
+
+        std::string operator()(const Node::TermStringLiteral* lit) const {
+            return literal('s', lit->string_lit.val.value());
+        }
+
+        std::string operator()(const Node::TermIdentifier* ident) const {
+            return (ident->slot.global ? "g" : "l") + std::to_string(ident->slot.index);
+        }
+
+        std::string operator()(const Node::FuncCall* fcall) const {
+            std::string k(fcall->ident.val.value());
+            k += "(";
+            for (size_t i = 0; i < fcall->args.size(); i++) {
+                if (i > 0)
+                    k += ",";
+                k += key(fcall->args[i]);
+            }
+            return k + ")";
+        }
+
+        std::string operator()(const Node::TermParen* paren) const {
+            return key(paren->expr);
+        }
+    };
+
+    struct ExprVisitor {
+        std::string operator()(const Node::Term* t) const {
+            return std::visit(TermVisitor{}, t->var);
+        }
+
+        std::string operator()(const Node::BinExpr* bin) const {
+            return "(" + key(bin->lside) + std::string(to_string(bin->op)) + key(bin->rside) + ")";
+        }
+
+        std::string operator()(const Node::ExprNot* n) const {
+            return "!" + key(n->expr);
+        }
+
+        std::string operator()(const Node::VarIncr* i) const {
+            return "++" + TermVisitor{}(i->ident);
+        }
+
+        std::string operator()(const Node::VarDecr* d) const {
+            return "--" + TermVisitor{}(d->ident);
+        }
+    };
+
+    return std::visit(ExprVisitor{}, e->var);
+}
+
+Node::TermIdentifier* Optimizer::temp(std::string_view prefix, VarType type) {
+    // identifiers start with a letter, the `_` of the prefix keeps the temporaries apart from them
+    const std::string name = std::string(prefix) + std::to_string(temp_count++);
+
+    char* text = static_cast<char*>(allocator.allocate(name.size(), 1));
+    std::copy(name.begin(), name.end(), text);
+
+    const Token ident{ TokenType::IDENTIFIER, 0, std::string_view(text, name.size()) };
+    return allocator.emplace<Node::TermIdentifier>(ident, type, VarSlot{ caller->frame_slots++, false });
+}
+
+Node::Expr* Optimizer::read(Node::TermIdentifier* ident) {
+    return allocator.emplace<Node::Expr>(allocator.emplace<Node::Term>(ident, ident->type), ident->type);
+}
+
+void Optimizer::count_write(VarSlot slot) {
+    if (slot.global)
+        globals_stable = false;
+    else if (static_cast<size_t>(slot.index) < writes.size())
+        writes[slot.index]++;
+}
+
+void Optimizer::count_writes(const Node::Scope* sc) {
+    struct ScopeStmtVisitor {
+        Optimizer& opt;
+
+        void operator()(const Node::StmtReturn* stmt_return) const {
+            opt.count_writes(stmt_return->expr);
+        }
+
+        void operator()(const Node::StmtImplicitVar* stmt_var) const {
+            opt.count_writes(stmt_var->expr);
+            opt.count_write(stmt_var->slot);
+        }
+
+        void operator()(const Node::StmtExplicitVar* stmt_var) const {
+            opt.count_write(stmt_var->slot);
+        }
+
+        void operator()(const Node::StmtVarAssign* var_assign) const {
+            opt.count_writes(var_assign->expr);
+            opt.count_write(var_assign->slot);
+        }
+
+        void operator()(const Node::FuncCall* fcall) const {
+            if (fcall->func != nullptr)
+                opt.globals_stable = false;
+            for (const Node::Expr* arg : fcall->args)
+                opt.count_writes(arg);
+        }
+
+        void operator()(const Node::VarIncr* i) const {
+            opt.count_write(i->ident->slot);
+        }
+
+        void operator()(const Node::VarDecr* d) const {
+            opt.count_write(d->ident->slot);
+        }
+
+        void operator()(const Node::Scope* sc) const {
+            opt.count_writes(sc);
+        }
+
+        void operator()(const Node::StmtWhile* w) const {
+            opt.count_writes(w->expr);
+            opt.count_writes(w->scope);
+        }
+
+        void operator()(const Node::StmtIf* stmt_if) const {
+            opt.count_writes(stmt_if->expr);
+            opt.count_writes(stmt_if->scope);
+
+            for (std::optional<Node::IfPred*> pred = stmt_if->pred; pred.has_value();) {
+                if (const auto elif_pred = std::get_if<Node::IfPredElif*>(&pred.value()->var)) {
+                    opt.count_writes((*elif_pred)->expr);
+                    opt.count_writes((*elif_pred)->scope);
+                    pred = (*elif_pred)->pred;
+                }
+                else {
+                    opt.count_writes(std::get<Node::IfPredElse*>(pred.value()->var)->scope);
+                    break;
+                }
+            }
+        }
+    };
+
+    for (const Node::ScopeStmt* s : sc->stmts)
+        std::visit(ScopeStmtVisitor{ *this }, s->var);
+}
+
+void Optimizer::count_writes(const Node::Expr* e) {
+    struct ExprVisitor {
+        Optimizer& opt;
+
+        void operator()(const Node::Term* t) const {
+            if (const auto fcall = std::get_if<Node::FuncCall*>(&t->var)) {
+                if ((*fcall)->func != nullptr)
+                    opt.globals_stable = false;
+                for (const Node::Expr* arg : (*fcall)->args)
+                    opt.count_writes(arg);
+            }
+            else if (const auto paren = std::get_if<Node::TermParen*>(&t->var))
+                opt.count_writes((*paren)->expr);
+        }
+
+        void operator()(const Node::BinExpr* bin) const {
+            opt.count_writes(bin->lside);
+            opt.count_writes(bin->rside);
+        }
+
+        void operator()(const Node::ExprNot* n) const {
+            opt.count_writes(n->expr);
+        }
+
+        void operator()(const Node::VarIncr* i) const {
+            opt.count_write(i->ident->slot);
+        }
+
+        void operator()(const Node::VarDecr* d) const {
+            opt.count_write(d->ident->slot);
+        }
+    };
+
+    std::visit(ExprVisitor{ *this }, e->var);
+}
+
+bool Optimizer::simple(const Node::Expr* e) {
+    const auto t = std::get_if<Node::Term*>(&e->var);
+    return t && !std::holds_alternative<Node::FuncCall*>((*t)->var) && !std::holds_alternative<Node::TermParen*>((*t)->var);
+}
+
+bool Optimizer::invariant(const Node::Expr* e) const {
+    struct TermVisitor {
+        const Optimizer& opt;
+
+        bool operator()(const Node::TermBooleanLiteral*) const {
+            return true;
+        }
+
+        bool operator()(const Node::TermIntegerLiteral*) const {
+            return true;
+        }
+
+        bool operator()(const Node::TermCharLiteral*) const {
+            return true;
+        }
+
+        bool operator()(const Node::TermStringLiteral*) const {
+            return true;
+        }
+
+        bool operator()(const Node::TermIdentifier* ident) const {
+            if (ident->slot.global)
+                return opt.globals_stable;
+            return static_cast<size_t>(ident->slot.index) < opt.writes.size() && opt.writes[ident->slot.index] == 0;
+        }
+
+        bool operator()(const Node::FuncCall* fcall) const {
+            // only the buildin conversions have no effect
+            const std::string_view name = fcall->ident.val.value();
+            if (fcall->func != nullptr || (name != "itoc" && name != "ctoi"))
+                return false;
+
+            return std::ranges::all_of(fcall->args, [this](const Node::Expr* arg) { return opt.invariant(arg); });
+        }
+
+        bool operator()(const Node::TermParen* paren) const {
+            return opt.invariant(paren->expr);
+        }
+    };
+
+    struct ExprVisitor {
+        const Optimizer& opt;
+
+        bool operator()(const Node::Term* t) const {
+            return std::visit(TermVisitor{ opt }, t->var);
+        }
+
+        bool operator()(const Node::BinExpr* bin) const {
+            return bin->op != BinOp::DIV && opt.invariant(bin->lside) && opt.invariant(bin->rside);
+        }
+
+        bool operator()(const Node::ExprNot* n) const {
+            return opt.invariant(n->expr);
+        }
+
+        bool operator()(const Node::VarIncr*) const {
+            return false;
+        }
+
+        bool operator()(const Node::VarDecr*) const {
+            return false;
+        }
+    };
+
+    return std::visit(ExprVisitor{ *this }, e->var);
+}
+
+void Optimizer::loops(Node::Prog& prog) {
+    // the global initializers have no loop
+    for (Node::ProgStmt* s : prog.stmts) {
+        if (const auto f = std::get_if<Node::FuncDeclaration*>(&s->var)) {
+            caller = *f;
+            loop_scope(caller->scope);
+        }
+    }
+
+    caller = nullptr;
+}
+
+void Optimizer::loop_scope(Node::Scope* sc) {
+    for (size_t i = 0; i < sc->stmts.size(); i++) {
+        Node::ScopeStmt* s = sc->stmts[i];
+
+        if (const auto inner = std::get_if<Node::Scope*>(&s->var))
+            loop_scope(*inner);
+        else if (const auto stmt_if = std::get_if<Node::StmtIf*>(&s->var)) {
+            loop_scope((*stmt_if)->scope);
+
+            for (std::optional<Node::IfPred*> pred = (*stmt_if)->pred; pred.has_value();) {
+                if (const auto elif_pred = std::get_if<Node::IfPredElif*>(&pred.value()->var)) {
+                    loop_scope((*elif_pred)->scope);
+                    pred = (*elif_pred)->pred;
+                }
+                else {
+                    loop_scope(std::get<Node::IfPredElse*>(pred.value()->var)->scope);
+                    break;
+                }
+            }
+        }
+        else if (const auto w = std::get_if<Node::StmtWhile*>(&s->var)) {
+            // the inner loops first: what they hoist lands in this body, and may be hoisted again from here
+            loop_scope((*w)->scope);
+
+            const std::vector<Node::ScopeStmt*> before = loop(*w);
+            sc->stmts.insert(sc->stmts.begin() + i, before.begin(), before.end());
+            i += before.size();
+        }
+    }
+}
+
+std::vector<Node::ScopeStmt*> Optimizer::loop(Node::StmtWhile* w) {
+    writes.assign(caller->frame_slots, 0);
+    globals_stable = true;
+    count_writes(w->expr);
+    count_writes(w->scope);
+
+    // a step at the top level of the body runs once per iteration, it must be the only write of the variable
+    inductions.clear();
+    for (const Node::ScopeStmt* s : w->scope->stmts) {
+        const auto i = std::get_if<Node::VarIncr*>(&s->var);
+        const auto d = std::get_if<Node::VarDecr*>(&s->var);
+        if (i == nullptr && d == nullptr)
+            continue;
+
+        const VarSlot slot = i ? (*i)->ident->slot : (*d)->ident->slot;
+        if (!slot.global && writes[slot.index] == 1)
+            inductions[slot.index] = i ? 1 : -1;
+    }
+
+    hoisted.clear();
+    preheader.clear();
+    induction_updates.clear();
+    forwarded.clear();
+
+    hoist_expr(w->expr);
+    hoist_scope(w->scope);
+
+    for (auto& [slot, updates] : induction_updates) {
+        const auto step = std::ranges::find_if(w->scope->stmts, [slot](const Node::ScopeStmt* s) {
+            if (const auto i = std::get_if<Node::VarIncr*>(&s->var))
+                return !(*i)->ident->slot.global && (*i)->ident->slot.index == slot;
+            if (const auto d = std::get_if<Node::VarDecr*>(&s->var))
+                return !(*d)->ident->slot.global && (*d)->ident->slot.index == slot;
+            return false;
+        });
+
+        w->scope->stmts.insert(step + 1, updates.begin(), updates.end());
+    }
+
+    return std::move(preheader);
+}
+
+void Optimizer::hoist_scope(Node::Scope* sc) {
+    struct ScopeStmtVisitor {
+        Optimizer& opt;
+
+        void operator()(Node::StmtReturn* stmt_return) const {
+            opt.hoist_expr(stmt_return->expr);
+        }
+
+        void operator()(Node::StmtImplicitVar* stmt_var) const {
+            opt.hoist_expr(stmt_var->expr);
+
+            // a temporary of an inner loop now copying one of this loop, or a literal: its reads take the value
+            const size_t slot = stmt_var->slot.index;
+            if (stmt_var->identifier.val.value().starts_with('_') && slot < opt.writes.size() && opt.writes[slot] == 1
+                && simple(stmt_var->expr))
+                opt.forwarded.emplace(slot, stmt_var->expr);
+        }
+
+        void operator()(Node::StmtExplicitVar*) const {
+        }
+
+        void operator()(Node::StmtVarAssign* var_assign) const {
+            opt.hoist_expr(var_assign->expr);
+        }
+
+        void operator()(Node::FuncCall* fcall) const {
+            for (Node::Expr* arg : fcall->args)
+                opt.hoist_expr(arg);
+        }
+
+        void operator()(Node::VarIncr*) const {
+        }
+
+        void operator()(Node::VarDecr*) const {
+        }
+
+        void operator()(Node::Scope* sc) const {
+            opt.hoist_scope(sc);
+        }
+
+        void operator()(Node::StmtWhile* w) const {
+            opt.hoist_expr(w->expr);
+            opt.hoist_scope(w->scope);
+        }
+
+        void operator()(Node::StmtIf* stmt_if) const {
+            opt.hoist_expr(stmt_if->expr);
+            opt.hoist_scope(stmt_if->scope);
+
+            for (std::optional<Node::IfPred*> pred = stmt_if->pred; pred.has_value();) {
+                if (const auto elif_pred = std::get_if<Node::IfPredElif*>(&pred.value()->var)) {
+                    opt.hoist_expr((*elif_pred)->expr);
+                    opt.hoist_scope((*elif_pred)->scope);
+                    pred = (*elif_pred)->pred;
+                }
+                else {
+                    opt.hoist_scope(std::get<Node::IfPredElse*>(pred.value()->var)->scope);
+                    break;
+                }
+            }
+        }
+    };
+
+    for (Node::ScopeStmt* s : sc->stmts)
+        std::visit(ScopeStmtVisitor{ *this }, s->var);
+
+    std::erase_if(sc->stmts, [this](const Node::ScopeStmt* s) {
+        const auto stmt_var = std::get_if<Node::StmtImplicitVar*>(&s->var);
+        return stmt_var && forwarded.contains((*stmt_var)->slot.index);
+    });
+}
+
+void Optimizer::hoist_expr(Node::Expr* e) {
+    if (const auto t = std::get_if<Node::Term*>(&e->var)) {
+        const auto ident = std::get_if<Node::TermIdentifier*>(&(*t)->var);
+        if (ident && !(*ident)->slot.global) {
+            if (const auto it = forwarded.find((*ident)->slot.index); it != forwarded.end())
+                e->var = clone(it->second, 0)->var;
+        }
+    }
+
+    // slot of an induction variable read by an operand
+    const auto induction = [this](const Node::Expr* operand) -> std::optional<int> {
+        const auto t = std::get_if<Node::Term*>(&operand->var);
+        const auto ident = t ? std::get_if<Node::TermIdentifier*>(&(*t)->var) : nullptr;
+        if (ident == nullptr || (*ident)->slot.global || !inductions.contains((*ident)->slot.index))
+            return {};
+        return (*ident)->slot.index;
+    };
+
+    std::string k;
+    Node::TermIdentifier* t = nullptr;
+
+    if (const auto bin = std::get_if<Node::BinExpr*>(&e->var); bin && (*bin)->op == BinOp::MULTI) {
+        std::optional<int> slot = induction((*bin)->lside);
+        const Node::Expr* step = (*bin)->rside;
+        if (!slot.has_value()) {
+            slot = induction((*bin)->rside);
+            step = (*bin)->lside;
+        }
+
+        // i * k is i0 * k before the loop, and grows by k at each step of i
+        // (k a literal: a multiplication by a variable costs less than the update of a temporary once g++ builds it)
+        if (slot.has_value() && constant(step).has_value()) {
+            k = key(e);
+            if (const auto it = hoisted.find(k); it != hoisted.end())
+                t = it->second;
+            else {
+                t = temp("_iv", VarType::INT);
+                preheader.push_back(allocator.emplace<Node::ScopeStmt>(
+                    allocator.emplace<Node::StmtImplicitVar>(t->ident, clone(e, 0), t->slot)));
+
+                const BinOp op = inductions[slot.value()] > 0 ? BinOp::ADD : BinOp::SUB;
+                Node::Expr* next = allocator.emplace<Node::Expr>(
+                    allocator.emplace<Node::BinExpr>(op, read(t), clone(step, 0)), VarType::INT);
+                induction_updates[slot.value()].push_back(allocator.emplace<Node::ScopeStmt>(
+                    allocator.emplace<Node::StmtVarAssign>(t->ident, next, t->slot)));
+
+                hoisted.emplace(k, t);
+            }
+
+            e->var = read(t)->var;
+            return;
+        }
+    }
+
+    // computed once before the loop (reading a variable or a literal costs nothing already)
+    if (!simple(e) && invariant(e)) {
+        k = key(e);
+        if (const auto it = hoisted.find(k); it != hoisted.end())
+            t = it->second;
+        else {
+            t = temp("_licm", e->type);
+            preheader.push_back(allocator.emplace<Node::ScopeStmt>(allocator.emplace<Node::StmtImplicitVar>(
+                t->ident, allocator.emplace<Node::Expr>(e->var, e->type), t->slot)));
+            hoisted.emplace(k, t);
+        }
+
+        e->var = read(t)->var;
+        return;
+    }
+
+    struct ExprVisitor {
+        Optimizer& opt;
+
+        void operator()(Node::Term* t) const {
+            if (const auto fcall = std::get_if<Node::FuncCall*>(&t->var)) {
+                for (Node::Expr* arg : (*fcall)->args)
+                    opt.hoist_expr(arg);
+            }
+            else if (const auto paren = std::get_if<Node::TermParen*>(&t->var))
+                opt.hoist_expr((*paren)->expr);
+        }
+
+        void operator()(Node::BinExpr* bin) const {
+            opt.hoist_expr(bin->lside);
+            opt.hoist_expr(bin->rside);
+        }
+
+        void operator()(Node::ExprNot* n) const {
+            opt.hoist_expr(n->expr);
+        }
+
+        void operator()(Node::VarIncr*) const {
+        }
+
+        void operator()(Node::VarDecr*) const {
+        }
+    };
+
+    std::visit(ExprVisitor{ *this }, e->var);
+}
+
+void Optimizer::reads(const Node::Expr* e, std::vector<VarSlot>& out) {
+    struct ExprVisitor {
+        std::vector<VarSlot>& out;
+
+        void operator()(const Node::Term* t) const {
+            if (const auto ident = std::get_if<Node::TermIdentifier*>(&t->var))
+                out.push_back((*ident)->slot);
+            else if (const auto fcall = std::get_if<Node::FuncCall*>(&t->var)) {
+                for (const Node::Expr* arg : (*fcall)->args)
+                    reads(arg, out);
+            }
+            else if (const auto paren = std::get_if<Node::TermParen*>(&t->var))
+                reads((*paren)->expr, out);
+        }
+
+        void operator()(const Node::BinExpr* bin) const {
+            reads(bin->lside, out);
+            reads(bin->rside, out);
+        }
+
+        void operator()(const Node::ExprNot* n) const {
+            reads(n->expr, out);
+        }
+
+        void operator()(const Node::VarIncr* i) const {
+            out.push_back(i->ident->slot);
+        }
+
+        void operator()(const Node::VarDecr* d) const {
+            out.push_back(d->ident->slot);
+        }
+    };
+
+    std::visit(ExprVisitor{ out }, e->var);
+}
+
+void Optimizer::cse(Node::Prog& prog) {
+    // the global initializers are single expressions, each function body is numbered scope by scope
+    for (Node::ProgStmt* s : prog.stmts) {
+        if (const auto f = std::get_if<Node::FuncDeclaration*>(&s->var)) {
+            caller = *f;
+            cse_scope(caller->scope);
+        }
+    }
+
+    caller = nullptr;
+}
+
+void Optimizer::cse_scope(Node::Scope* sc) {
+    struct ScopeStmtVisitor {
+        Optimizer& opt;
+
+        // a variable is written once its value is computed, the expression sees the old value
+        void assign(Node::Expr* e, VarSlot slot) const {
+            opt.count_writes(e);
+            opt.cse_expr(e);
+            opt.count_write(slot);
+            opt.cse_invalidate();
+        }
+
+        void operator()(Node::StmtReturn* stmt_return) const {
+            opt.count_writes(stmt_return->expr);
+            opt.cse_expr(stmt_return->expr);
+        }
+
+        void operator()(Node::StmtImplicitVar* stmt_var) const {
+            assign(stmt_var->expr, stmt_var->slot);
+        }
+
+        void operator()(Node::StmtExplicitVar* stmt_var) const {
+            opt.count_write(stmt_var->slot);
+            opt.cse_invalidate();
+        }
+
+        void operator()(Node::StmtVarAssign* var_assign) const {
+            assign(var_assign->expr, var_assign->slot);
+        }
+
+        void operator()(Node::FuncCall* fcall) const {
+            for (Node::Expr* arg : fcall->args)
+                opt.count_writes(arg);
+            for (Node::Expr* arg : fcall->args)
+                opt.cse_expr(arg);
+
+            // the callee runs once the arguments are computed
+            if (fcall->func != nullptr)
+                opt.globals_stable = false;
+            opt.cse_invalidate();
+        }
+
+        void operator()(Node::VarIncr* i) const {
+            opt.count_write(i->ident->slot);
+            opt.cse_invalidate();
+        }
+
+        void operator()(Node::VarDecr* d) const {
+            opt.count_write(d->ident->slot);
+            opt.cse_invalidate();
+        }
+
+        // the nested scopes are numbered on their own, nothing is known after them
+
+        void operator()(Node::Scope* sc) const {
+            opt.cse_scope(sc);
+            opt.table->values.clear();
+        }
+
+        void operator()(Node::StmtWhile* w) const {
+            opt.cse_scope(w->scope);
+            opt.table->values.clear();
+        }
+
+        void operator()(Node::StmtIf* stmt_if) const {
+            // the condition runs once, before any branch
+            opt.count_writes(stmt_if->expr);
+            opt.cse_expr(stmt_if->expr);
+            opt.cse_scope(stmt_if->scope);
+
+            for (std::optional<Node::IfPred*> pred = stmt_if->pred; pred.has_value();) {
+                if (const auto elif_pred = std::get_if<Node::IfPredElif*>(&pred.value()->var)) {
+                    opt.cse_scope((*elif_pred)->scope);
+                    pred = (*elif_pred)->pred;
+                }
+                else {
+                    opt.cse_scope(std::get<Node::IfPredElse*>(pred.value()->var)->scope);
+                    break;
+                }
+            }
+
+            opt.table->values.clear();
+        }
+    };
+
+    ValueTable scope_table;
+    scope_table.decls.resize(sc->stmts.size());
+    ValueTable* const outer = std::exchange(table, &scope_table);
+
+    for (size_t i = 0; i < sc->stmts.size(); i++) {
+        table->stmt = i;
+        writes.assign(caller->frame_slots, 0);
+        globals_stable = true;
+
+        std::visit(ScopeStmtVisitor{ *this }, sc->stmts[i]->var);
+    }
+
+    // the temporaries are declared before the statement of their first occurrence, the ones an expression
+    // reads before it
+    for (size_t i = sc->stmts.size(); i-- > 0;) {
+        std::vector<std::pair<int, Node::ScopeStmt*>>& decls = table->decls[i];
+        if (decls.empty())
+            continue;
+
+        std::ranges::sort(decls, {}, &std::pair<int, Node::ScopeStmt*>::first);
+        for (auto it = decls.rbegin(); it != decls.rend(); it++)
+            sc->stmts.insert(sc->stmts.begin() + i, it->second);
+    }
+
+    table = outer;
+}
+
+void Optimizer::cse_expr(Node::Expr* e) {
+    const bool candidate = !simple(e) && invariant(e);
+    std::string k;
+    std::vector<VarSlot> read_slots;
+
+    if (candidate) {
+        k = key(e);
+
+        if (const auto it = table->values.find(k); it != table->values.end()) {
+            NumberedValue& v = it->second;
+
+            // seen again: the first occurrence moves to the temporary
+            if (v.temp == nullptr) {
+                v.temp = temp("_cse", v.node->type);
+
+                Node::Expr* value = allocator.emplace<Node::Expr>(v.node->var, v.node->type);
+                table->decls[v.stmt].push_back({ v.order, allocator.emplace<Node::ScopeStmt>(
+                    allocator.emplace<Node::StmtImplicitVar>(v.temp->ident, value, v.temp->slot)) });
+                v.node->var = read(v.temp)->var;
+            }
+
+            e->var = read(v.temp)->var;
+            return;
+        }
+    }
+
+    // read before the children are rewritten: once they read temporaries, the variables behind are hidden
+    if (candidate)
+        reads(e, read_slots);
+
+    struct ExprVisitor {
+        Optimizer& opt;
+
+        void operator()(Node::Term* t) const {
+            if (const auto fcall = std::get_if<Node::FuncCall*>(&t->var)) {
+                for (Node::Expr* arg : (*fcall)->args)
+                    opt.cse_expr(arg);
+            }
+            else if (const auto paren = std::get_if<Node::TermParen*>(&t->var))
+                opt.cse_expr((*paren)->expr);
+        }
+
+        void operator()(Node::BinExpr* bin) const {
+            opt.cse_expr(bin->lside);
+            opt.cse_expr(bin->rside);
+        }
+
+        void operator()(Node::ExprNot* n) const {
+            opt.cse_expr(n->expr);
+        }
+
+        void operator()(Node::VarIncr*) const {
+        }
+
+        void operator()(Node::VarDecr*) const {
+        }
+    };
+
+    std::visit(ExprVisitor{ *this }, e->var);
+
+    // numbered after the expressions it contains, so their temporaries are declared first
+    if (candidate) {
+        NumberedValue v{ e, table->stmt, table->order++, std::move(read_slots) };
+        table->values.emplace(std::move(k), std::move(v));
+    }
+}
+
+void Optimizer::cse_invalidate() {
+    std::erase_if(table->values, [this](const auto& entry) {
+        return std::ranges::any_of(entry.second.reads, [this](VarSlot slot) {
+            if (slot.global)
+                return !globals_stable;
+            return static_cast<size_t>(slot.index) < writes.size() && writes[slot.index] > 0;
+        });
+    });
+}
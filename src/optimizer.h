@@ -0,0 +1,226 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "parser.h"
+
+/// @brief rewrites the syntax tree in place between parsing and the backends,
+/// so the C++ generator, the native backend, the VM and the interpreter all get the simplified tree
+class Optimizer {
+private:
+    /// @brief storage of the nodes made by the rewrites (the rest of the tree stays in the parser's arena)
+    ArenaAllocator allocator;
+
+    /// @brief value of an int or bool literal (a bool is 0 or 1)
+    /// @return nothing for any other expression, or for an int literal which is not a C++ int
+    static std::optional<int64_t> constant(const Node::Expr* e);
+
+    /// @brief value of a binary operation on constants
+    /// @return nothing when it is left to run time (division by zero, int overflow)
+    static std::optional<int64_t> evaluate(BinOp op, int64_t l, int64_t r);
+
+    /// @brief replace an expression by a literal of its type
+    void set_constant(Node::Expr* e, int64_t value);
+
+    void scope(Node::Scope* sc);
+
+    /// @return false if the statement is dead and must be removed
+    bool scope_stmt(Node::ScopeStmt* s);
+
+    /// @brief fold the predicates of an if statement
+    /// @return the predicate chain without the branches that cannot run
+    std::optional<Node::IfPred*> if_pred(std::optional<Node::IfPred*> pred);
+
+    void expr(Node::Expr* e);
+
+    void bin_expr(Node::Expr* e, Node::BinExpr* bin);
+
+    void term(Node::Expr* e, Node::Term* t);
+
+    /// @brief functions reached from main, the ones in `pending` are still to walk
+    std::unordered_set<const Node::FuncDeclaration*> live_funcs;
+    std::vector<const Node::FuncDeclaration*> pending;
+    /// @brief globals read or written by live code, by slot index
+    std::vector<bool> live_globals;
+
+    /// @brief function being walked, for the report
+    const Node::FuncDeclaration* current = nullptr;
+
+    /// @brief what `eliminate` dropped, one line each
+    std::vector<std::string> removals;
+
+    /// @brief true if an expression can have an effect (a call, `++`, `--`, or a division which could trap)
+    static bool has_effects(const Node::Expr* e);
+
+    void use_func(const Node::FuncDeclaration* f);
+
+    void use_var(VarSlot slot);
+
+    /// @brief drop the statements of a live scope which cannot run and mark what the rest uses
+    /// @return true if the scope always returns
+    bool live_scope(Node::Scope* sc);
+
+    /// @return true if the statement always returns
+    bool live_stmt(Node::ScopeStmt* s);
+
+    /// @return true if every branch of the predicate chain returns (so it ends with an else)
+    bool live_pred(Node::IfPred* pred);
+
+    void live_expr(const Node::Expr* e);
+
+    /// @brief bodies costing more are never inlined
+    int inline_threshold = 0;
+    /// @brief how much the function being inlined into may still grow
+    int inline_budget = 0;
+    /// @brief function whose calls are being inlined (nullptr for the global initializers)
+    Node::FuncDeclaration* caller = nullptr;
+
+    /// @brief size of the tree, in nodes
+    static int cost(const Node::Scope* sc);
+
+    static int cost(const Node::ScopeStmt* s);
+
+    static int cost(const Node::Expr* e);
+
+    /// @brief true if a scope contains a return statement (at any depth)
+    static bool has_return(const Node::Scope* sc);
+
+    /// @brief expression returned by a function whose body is only `return expr`
+    static const Node::Expr* returned_expr(const Node::FuncDeclaration* f);
+
+    /// @brief copy of a tree, its local slots moved by `offset` (so they get a place in the caller's frame)
+    Node::Scope* clone(const Node::Scope* sc, int offset);
+
+    Node::ScopeStmt* clone(const Node::ScopeStmt* s, int offset);
+
+    Node::IfPred* clone(const Node::IfPred* pred, int offset);
+
+    Node::Expr* clone(const Node::Expr* e, int offset);
+
+    Node::TermIdentifier* clone(const Node::TermIdentifier* ident, int offset);
+
+    Node::FuncCall* clone(const Node::FuncCall* fcall, int offset);
+
+    /// @brief spend the budget on a body of the given cost
+    /// @return false if it does not fit
+    bool take_budget(int cost);
+
+    void inline_scope(Node::Scope* sc);
+
+    void inline_pred(Node::IfPred* pred);
+
+    void inline_expr(Node::Expr* e);
+
+    /// @brief number of temporaries made so far, their names (which no identifier can take) are unique
+    int temp_count = 0;
+
+    /// @brief times each local of the function is written by the code being optimized (a loop, or a statement
+    /// for the value numbering), by slot
+    std::vector<int> writes;
+    /// @brief false if that code writes a global or calls a function (which may write one)
+    bool globals_stable = true;
+    /// @brief induction variables of the loop: locals only updated by one `++` or `--` statement of its body
+    std::unordered_map<int, int> inductions;
+    /// @brief temporaries holding the expressions taken out of the loop, by `key`
+    std::unordered_map<std::string, Node::TermIdentifier*> hoisted;
+    /// @brief declarations of these temporaries, they go before the loop
+    std::vector<Node::ScopeStmt*> preheader;
+    /// @brief updates of the strength reduced products, they go after the step of their induction variable
+    std::unordered_map<int, std::vector<Node::ScopeStmt*>> induction_updates;
+    /// @brief temporaries of the inner loops whose initializer became a literal or a read of a temporary of the
+    /// loop, by slot: they are dropped and their reads take that value
+    std::unordered_map<int, const Node::Expr*> forwarded;
+
+    /// @brief text identifying an expression: two expressions with the same key compute the same thing
+    /// as long as the variables they read do not change
+    static std::string key(const Node::Expr* e);
+
+    /// @brief new local of the function being optimized (`caller`)
+    Node::TermIdentifier* temp(std::string_view prefix, VarType type);
+
+    Node::Expr* read(Node::TermIdentifier* ident);
+
+    void count_writes(const Node::Scope* sc);
+
+    void count_writes(const Node::Expr* e);
+
+    void count_write(VarSlot slot);
+
+    /// @brief true if an expression gives the same value wherever it is evaluated in the code whose writes
+    /// were counted, and can be computed ahead (no effect, no division which could trap)
+    bool invariant(const Node::Expr* e) const;
+
+    /// @brief true for a literal or a variable, which there is no point in keeping in a temporary
+    static bool simple(const Node::Expr* e);
+
+    void loop_scope(Node::Scope* sc);
+
+    /// @return the statements to run before the loop
+    std::vector<Node::ScopeStmt*> loop(Node::StmtWhile* w);
+
+    void hoist_scope(Node::Scope* sc);
+
+    void hoist_expr(Node::Expr* e);
+
+    /// @brief an expression already computed in the scope being optimized
+    struct NumberedValue {
+        /// @brief first occurrence, it reads the temporary once the expression is seen again
+        Node::Expr* node;
+        /// @brief statement of the first occurrence, the temporary is declared before it
+        size_t stmt;
+        /// @brief order of the first occurrences, an expression comes after the ones it contains
+        int order;
+        /// @brief variables it reads, a write to one of them forgets the value
+        std::vector<VarSlot> reads;
+        Node::TermIdentifier* temp = nullptr;
+    };
+
+    /// @brief value numbering of a scope: the values by `key` and the declarations of their temporaries
+    /// with their order, by statement
+    struct ValueTable {
+        std::unordered_map<std::string, NumberedValue> values;
+        std::vector<std::vector<std::pair<int, Node::ScopeStmt*>>> decls;
+        size_t stmt = 0;
+        int order = 0;
+    };
+
+    /// @brief table of the innermost scope being optimized
+    ValueTable* table = nullptr;
+
+    static void reads(const Node::Expr* e, std::vector<VarSlot>& out);
+
+    void cse_scope(Node::Scope* sc);
+
+    void cse_expr(Node::Expr* e);
+
+    /// @brief forget the values reading a variable written by the statement
+    void cse_invalidate();
+
+public:
+    /// @brief fold the constant int and bool expressions, drop the neutral operations
+    /// (`x * 1`, `x + 0`, `!!b`, `true && e`, ...) and prune the if / elif branches with a constant condition
+    void fold(Node::Prog& prog);
+
+    /// @brief remove the functions main cannot reach, the globals no live code uses
+    /// (unless their initializer has an effect) and the statements following a return
+    void eliminate(Node::Prog& prog);
+
+    /// @brief replace the calls to small functions by their body: a function whose body is `return expr`
+    /// is inlined in expressions, a function without return statement where it is called as a statement
+    /// @param threshold largest body inlined (in syntax tree nodes), each function grows by at most 4 times as much
+    void inline_calls(Node::Prog& prog, int threshold);
+
+    /// @brief move the invariant expressions of the while loops before them, and replace the products
+    /// `i * k` of an induction variable by a temporary updated with `+ k` next to the step of `i`
+    void loops(Node::Prog& prog);
+
+    /// @brief compute once the pure expressions repeated in the straight-line code of a scope
+    /// (`a * b + a * b`, `ctoi(c)` twice, ...): the first one goes to a temporary the others read
+    void cse(Node::Prog& prog);
+
+    /// @brief what `eliminate` removed, one line per function, global or group of statements
+    const std::vector<std::string>& removed() const { return removals; }
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+/// @brief run fn(i) for every i in [0, n) on a pool of threads, each taking the next index left
+/// @note the calling thread does the whole work when a single thread is enough (one core or n < 2), fn must
+/// not depend on the order of the calls
+template<typename F>
+void parallel_for(size_t n, F&& fn) {
+    const size_t count = std::min<size_t>(n, std::thread::hardware_concurrency());
+
+    if (count < 2) {
+        for (size_t i = 0; i < n; i++)
+            fn(i);
+        return;
+    }
+
+    std::atomic<size_t> next{ 0 };
+    auto worker = [&] {
+        for (size_t i = next++; i < n; i = next++)
+            fn(i);
+    };
+
+    std::vector<std::jthread> threads;
+    for (size_t t = 1; t < count; t++)
+        threads.emplace_back(worker);
+
+    worker();
+}
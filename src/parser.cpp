@@ -4,18 +4,84 @@
 
 #include <algorithm>
 
-const std::unordered_map<std::string, VarType> Parser::buildin_func_type = { {"print", VarType::VOID}, {"println", VarType::VOID},
+namespace {
+    // the digits modulo 2^32, as the C++ backend's int wraps a long literal
+    int32_t int_literal(std::string_view lit) {
+        uint32_t value = 0;
+        for (const char c : lit)
+            value = value * 10 + static_cast<uint32_t>(c - '0');
+        return static_cast<int32_t>(value);
+    }
+}
+
+const IdentifierMap<VarType> Parser::buildin_func_type = { {"print", VarType::VOID}, {"println", VarType::VOID},
  {"itoc", VarType::CHAR}, {"ctoi", VarType::INT},
 };
 
-bool Parser::is_buildin_func(const std::string& func) {
+bool Parser::is_buildin_func(std::string_view func) {
     return buildin_func_type.count(func);
 }
 
-std::unordered_map<std::string, VarType> Parser::identifiers{};
+bool Parser::is_var(std::string_view var) {
+    return symbol(var) != nullptr;
+}
+
+void Parser::declare_var(const Token& ident, VarType type, VarSlot& slot) {
+    const SymbolId id = interner.intern(ident.val.value());
+
+    if (current_func != nullptr) {
+        slot = { current_func->frame_slots++, false };
+
+        if (static_cast<size_t>(id) >= local_names.size())
+            local_names.resize(interner.size());
+        if (!local_names[id]) {
+            local_names[id] = true;
+            local_decls.push_back(ident);
+        }
+    }
+    else {
+        slot = { global_slots++, true };
+        global_refs.emplace_back(&slot, module);
+    }
+
+    symbols.declare(id, { type, slot, nullptr, module });
+}
+
+void Parser::bind(VarSlot& slot, const Symbol& var) {
+    slot = var.slot;
+    if (slot.global)
+        global_refs.emplace_back(&slot, var.module);
+}
+
+const Parser::Symbol* Parser::symbol(std::string_view ident) const {
+    // a name never interned is declared nowhere in this file
+    if (const std::optional<SymbolId> id = interner.find(ident)) {
+        if (const Symbol* s = symbols.find(id.value()))
+            return s;
+    }
+
+    for (const Parser* p : imports) {
+        if (const Symbol* s = p->exported(ident))
+            return s;
+    }
+
+    return nullptr;
+}
+
+const Parser::Symbol* Parser::exported(std::string_view ident) const {
+    // every scope of a parsed file is popped, only its top-level declarations are left
+    if (const std::optional<SymbolId> id = interner.find(ident))
+        return symbols.find(id.value());
+    return nullptr;
+}
+
+void Parser::import(const Parser& parser) {
+    imports.push_back(&parser);
+}
 
-bool Parser::is_var(const std::string& var) {
-    return identifiers.count(var);
+void Parser::relocate_globals(const std::vector<int>& bases) {
+    for (const auto& [slot, owner] : global_refs)
+        slot->index += bases[owner];
 }
 
 std::optional<VarType> Parser::get_return_type(VarType t1, TokenType op, VarType t2) {
@@ -68,6 +134,70 @@ std::string to_string(VarType t) {
     }
 }
 
+std::string_view to_string(BinOp op) {
+    switch (op) {
+    case BinOp::ADD:
+        return "+";
+    case BinOp::SUB:
+        return "-";
+    case BinOp::MULTI:
+        return "*";
+    case BinOp::DIV:
+        return "/";
+    case BinOp::AND:
+        return "&&";
+    case BinOp::OR:
+        return "||";
+    case BinOp::IS_EQUAL:
+        return "==";
+    case BinOp::IS_NOT_EQUAL:
+        return "!=";
+    case BinOp::GREATER_OR_EQUAL:
+        return ">=";
+    case BinOp::GREATER:
+        return ">";
+    case BinOp::LOWER_OR_EQUAL:
+        return "<=";
+    case BinOp::LOWER:
+        return "<";
+    default:
+        return "";
+    }
+}
+
+std::optional<BinOp> to_bin_op(TokenType t) {
+    switch (t) {
+    case TokenType::PLUS:
+        return BinOp::ADD;
+    case TokenType::MINUS:
+        /// TODO: make sure you cannot sub strings
+        return BinOp::SUB;
+    case TokenType::STAR:
+        return BinOp::MULTI;
+    case TokenType::SLASH:
+        /// TODO: make sure you cannot divide strings
+        return BinOp::DIV;
+    case TokenType::AND:
+        return BinOp::AND;
+    case TokenType::OR:
+        return BinOp::OR;
+    case TokenType::IS_EQUAL:
+        return BinOp::IS_EQUAL;
+    case TokenType::IS_NOT_EQUAL:
+        return BinOp::IS_NOT_EQUAL;
+    case TokenType::GREATER_OR_EQUAL:
+        return BinOp::GREATER_OR_EQUAL;
+    case TokenType::GREATER:
+        return BinOp::GREATER;
+    case TokenType::LOWER_OR_EQUAL:
+        return BinOp::LOWER_OR_EQUAL;
+    case TokenType::LOWER:
+        return BinOp::LOWER;
+    default:
+        return {};
+    }
+}
+
 VarType to_variable_type(TokenType t) {
     switch (t) {
     case TokenType::TYPE_BOOL:
@@ -87,69 +217,80 @@ VarType to_variable_type(TokenType t) {
     }
 }
 
-Parser::Parser(std::vector<Token> tokens)
-    : tokens(std::move(tokens)), allocator(1024 * 1024 * 4) {
-} // 4mb
-
-std::optional<VarType> Parser::var_type(const std::string& ident) {
-    if (is_var(ident))
-        return identifiers[ident];
-    return {};
+Parser::Parser(Tokenizer& tokenizer, int module)
+    : tokenizer(tokenizer), allocator(), module(module) {
 }
 
-std::optional<Token> Parser::peek(const int offset) const {
-    if (index + offset >= tokens.size())
-        return {};
-    return tokens.at(index + offset);
+const Token* Parser::peek(const int offset) {
+    assert(offset >= -1 && offset < static_cast<int>(LOOKAHEAD) - 1);
+
+    const size_t pos = index + offset;
+    if (offset < 0 && index == 0)
+        return nullptr;
+
+    while (pos >= lexed && !eof) {
+        if (std::optional<Token> t = tokenizer.next())
+            lookahead[lexed++ % LOOKAHEAD] = t.value();
+        else
+            eof = true;
+    }
+
+    if (pos >= lexed)
+        return nullptr;
+    return &lookahead[pos % LOOKAHEAD];
 }
 
-bool Parser::peek_type(TokenType type, int offset) const {
-    return peek(offset).has_value() && peek(offset).value().type == type;
+bool Parser::peek_type(TokenType type, int offset) {
+    const Token* t = peek(offset);
+    return t != nullptr && t->type == type;
 }
 
-Token Parser::consume() {
-    //std::cout << to_string(tokens[index].type) << std::endl;
-    return tokens[index++];
+const Token& Parser::consume() {
+    const Token* t = peek();
+    assert(t != nullptr);
+    index++;
+    return *t;
 }
 
-Token Parser::try_consume_err(TokenType type) {
-    if (peek().has_value() && peek().value().type == type) {
-        return consume();
-    }
-    else {
+const Token& Parser::try_consume_err(TokenType type) {
+    if (!peek_type(type))
         exit_with("`" + to_string(type) + "`");
-        return {}; // unreachable
-    }
+
+    return consume();
 }
 
-std::optional<Token> Parser::try_consume(TokenType type) {
-    if (peek().has_value() && peek().value().type == type) {
-        return consume();
+const Token* Parser::try_consume(TokenType type) {
+    if (peek_type(type)) {
+        return &consume();
     }
     else {
-        return {};
+        return nullptr;
     }
 }
 
-void Parser::exit_with(const std::string& err_msg, std::string template_msg) {
-    std::cerr << "[Error] " << template_msg << " " << err_msg << " on line ";
+void Parser::exit_with(std::string_view err_msg, std::string_view template_msg) {
+    const Token* t = peek() ? peek() : peek(-1);
 
-    if (peek().has_value())
-        std::cerr << peek().value().line;
-    else
-        std::cerr << peek(-1).value().line;
-
-    std::cerr << std::endl;
-
-    exit(EXIT_FAILURE);
+    exit_with_error("[Error] " + std::string(template_msg) + " " + std::string(err_msg) + " on "
+        + tokenizer.location(t != nullptr ? t->line : 1));
 }
 
 /* ----- PARSING FUNCTIONS ----- */
 
+std::vector<std::string_view> Parser::parse_imports() {
+    std::vector<std::string_view> paths;
+
+    // IMPORT STRING_LITERAL
+    while (try_consume(TokenType::IMPORT))
+        paths.push_back(try_consume_err(TokenType::STRING_LITERAL).val.value());
+
+    return paths;
+}
+
 std::optional<Node::Prog> Parser::parse_prog() {
-    Node::Prog prog;
+    Node::Prog prog{ ArenaVector<Node::ProgStmt*>(&allocator) };
 
-    while (peek().has_value()) {
+    while (peek()) {
         if (std::optional<Node::ProgStmt*> stmt = parse_prog_stmt()) {
             prog.stmts.push_back(stmt.value());
         }
@@ -158,10 +299,16 @@ std::optional<Node::Prog> Parser::parse_prog() {
         }
     }
 
+    prog.global_slots = global_slots;
+
     return prog;
 };
 
 std::optional<Node::ProgStmt*> Parser::parse_prog_stmt() {
+    // the imports are read before the file is parsed, to parse the imported files first
+    if (peek_type(TokenType::IMPORT))
+        exit_with("at the top of the file", "import must be");
+
     // VAR IDENT ?
     if (peek_type(TokenType::VAR) && peek_type(TokenType::IDENTIFIER, 1)) {
         // VAR IDENT = ?
@@ -172,7 +319,7 @@ std::optional<Node::ProgStmt*> Parser::parse_prog_stmt() {
             var->identifier = consume();
 
             if (is_var(var->identifier.val.value()))
-                exit_with("'" + var->identifier.val.value() + "' already used", "identifier");
+                exit_with("\'" + std::string(var->identifier.val.value()) + "' already used", "identifier");
 
             consume(); // =
 
@@ -183,7 +330,7 @@ std::optional<Node::ProgStmt*> Parser::parse_prog_stmt() {
                 exit_with("expression");
             }
 
-            identifiers[var->identifier.val.value()] = var->expr->type;
+            declare_var(var->identifier, var->expr->type, var->slot);
 
             Node::ProgStmt* stmt = allocator.emplace<Node::ProgStmt>(var);
             return stmt;
@@ -196,10 +343,10 @@ std::optional<Node::ProgStmt*> Parser::parse_prog_stmt() {
             var->identifier = consume();
 
             if (is_var(var->identifier.val.value()))
-                exit_with("'" + var->identifier.val.value() + "' already used", "identifier");
+                exit_with("\'" + std::string(var->identifier.val.value()) + "' already used", "identifier");
 
             consume(); // :
-            Token type = consume();
+            const Token type = consume();
             consume(); // =
 
             if (auto e = parse_expr()) {
@@ -212,7 +359,7 @@ std::optional<Node::ProgStmt*> Parser::parse_prog_stmt() {
             if (var->expr->type != to_variable_type(type.type))
                 exit_with(to_string(type.type), "variable type must be");
 
-            identifiers[var->identifier.val.value()] = var->expr->type;
+            declare_var(var->identifier, var->expr->type, var->slot);
 
             Node::ProgStmt* stmt = allocator.emplace<Node::ProgStmt>(var);
             return stmt;
@@ -224,7 +371,7 @@ std::optional<Node::ProgStmt*> Parser::parse_prog_stmt() {
             var->ident = consume();
 
             if (is_var(var->ident.val.value()))
-                exit_with("'" + var->ident.val.value() + "' already used", "identifier");
+                exit_with("\'" + std::string(var->ident.val.value()) + "' already used", "identifier");
 
             consume(); // :
 
@@ -235,7 +382,7 @@ std::optional<Node::ProgStmt*> Parser::parse_prog_stmt() {
                 exit_with("type");
             }
 
-            identifiers[var->ident.val.value()] = var->type;
+            declare_var(var->ident, var->type, var->slot);
 
             Node::ProgStmt* stmt = allocator.emplace<Node::ProgStmt>(var);
             return stmt;
@@ -248,8 +395,9 @@ std::optional<Node::ProgStmt*> Parser::parse_prog_stmt() {
     if (peek_type(TokenType::FUNC)) {
         consume();
 
-        auto func = allocator.alloc<Node::FuncDeclaration>();
+        auto func = allocator.emplace<Node::FuncDeclaration>();
         func->ident = try_consume_err(TokenType::IDENTIFIER);
+        current_func = func;
 
         try_consume_err(TokenType::LEFT_PARENTHESIS);
         try_consume_err(TokenType::RIGHT_PARENTHESIS);
@@ -267,13 +415,13 @@ std::optional<Node::ProgStmt*> Parser::parse_prog_stmt() {
             }
             else {
                 exit_with("scope");
-                return {}; // unreachable
             }
 
             if (func->type != func->scope->type)
-                exit_with(func->ident.val.value() + " is of type " + to_string(func->type), "function");
+                exit_with(std::string(func->ident.val.value()) + " is of type " + to_string(func->type), "function");
 
-            identifiers[func->ident.val.value()] = func->type;
+            current_func = nullptr;
+            symbols.declare(interner.intern(func->ident.val.value()), { func->type, {}, func });
 
             return allocator.emplace<Node::ProgStmt>(func);
         }
@@ -283,12 +431,12 @@ std::optional<Node::ProgStmt*> Parser::parse_prog_stmt() {
         }
         else {
             exit_with("scope");
-            return {}; // unreachable
         }
 
         func->type = func->scope->type;
 
-        identifiers[func->ident.val.value()] = func->type;
+        current_func = nullptr;
+        symbols.declare(interner.intern(func->ident.val.value()), { func->type, {}, func });
 
         return allocator.emplace<Node::ProgStmt>(func);
     }
@@ -297,10 +445,13 @@ std::optional<Node::ProgStmt*> Parser::parse_prog_stmt() {
 }
 
 std::optional<Node::Scope*> Parser::parse_scope() {
-    if (!try_consume(TokenType::LEFT_CURLY_BACKET).has_value())
+    if (!try_consume(TokenType::LEFT_CURLY_BACKET))
         return {};
 
-    auto scope = allocator.emplace<Node::Scope>();
+    auto scope = allocator.emplace<Node::Scope>(ArenaVector<Node::ScopeStmt*>(&allocator));
+
+    // the variables declared inside are out of scope after the closing bracket
+    symbols.push();
 
     while (auto stmt = parse_scope_stmt()) {
         scope->stmts.push_back(stmt.value());
@@ -311,11 +462,13 @@ std::optional<Node::Scope*> Parser::parse_scope() {
 
     try_consume_err(TokenType::RIGHT_CURLY_BRACKET);
 
+    symbols.pop();
+
     return scope;
 }
 
 std::optional<Node::ScopeStmt*> Parser::parse_scope_stmt() {
-    if (!peek().has_value())
+    if (!peek())
         return {};
 
 
@@ -382,7 +535,7 @@ std::optional<Node::ScopeStmt*> Parser::parse_scope_stmt() {
             var->identifier = consume();
 
             if (is_var(var->identifier.val.value()))
-                exit_with("'" + var->identifier.val.value() + "' already used", "identifier");
+                exit_with("\'" + std::string(var->identifier.val.value()) + "' already used", "identifier");
 
             consume(); // =
 
@@ -393,7 +546,7 @@ std::optional<Node::ScopeStmt*> Parser::parse_scope_stmt() {
                 exit_with("expression");
             }
 
-            identifiers[var->identifier.val.value()] = var->expr->type;
+            declare_var(var->identifier, var->expr->type, var->slot);
 
             Node::ScopeStmt* stmt = allocator.emplace<Node::ScopeStmt>(var);
             return stmt;
@@ -405,10 +558,10 @@ std::optional<Node::ScopeStmt*> Parser::parse_scope_stmt() {
             var->identifier = consume();
 
             if (is_var(var->identifier.val.value()))
-                exit_with("'" + var->identifier.val.value() + "' already used", "identifier");
+                exit_with("\'" + std::string(var->identifier.val.value()) + "' already used", "identifier");
 
             consume(); // :
-            Token type = consume();
+            const Token type = consume();
             consume(); // =
 
             if (auto e = parse_expr()) {
@@ -421,7 +574,7 @@ std::optional<Node::ScopeStmt*> Parser::parse_scope_stmt() {
             if (var->expr->type != to_variable_type(type.type))
                 exit_with(to_string(type.type), "variable type must be");
 
-            identifiers[var->identifier.val.value()] = var->expr->type;
+            declare_var(var->identifier, var->expr->type, var->slot);
 
             Node::ScopeStmt* stmt = allocator.emplace<Node::ScopeStmt>(var);
             return stmt;
@@ -432,7 +585,7 @@ std::optional<Node::ScopeStmt*> Parser::parse_scope_stmt() {
             var->ident = consume();
 
             if (is_var(var->ident.val.value()))
-                exit_with("'" + var->ident.val.value() + "' already used", "identifier");
+                exit_with("\'" + std::string(var->ident.val.value()) + "' already used", "identifier");
 
             consume(); // :
 
@@ -443,7 +596,7 @@ std::optional<Node::ScopeStmt*> Parser::parse_scope_stmt() {
                 exit_with("type");
             }
 
-            identifiers[var->ident.val.value()] = var->type;
+            declare_var(var->ident, var->type, var->slot);
 
             Node::ScopeStmt* stmt = allocator.emplace<Node::ScopeStmt>(var);
             return stmt;
@@ -457,9 +610,11 @@ std::optional<Node::ScopeStmt*> Parser::parse_scope_stmt() {
         auto var_assign = allocator.alloc<Node::StmtVarAssign>();
         var_assign->ident = consume();
 
-        if (!is_var(var_assign->ident.val.value())) {
-            exit_with("'" + var_assign->ident.val.value() + "'", "unknown identifier");
+        const Symbol* var = symbol(var_assign->ident.val.value());
+        if (var == nullptr) {
+            exit_with("\'" + std::string(var_assign->ident.val.value()) + "'", "unknown identifier");
         }
+        bind(var_assign->slot, *var);
 
         consume(); // = token
 
@@ -469,7 +624,7 @@ std::optional<Node::ScopeStmt*> Parser::parse_scope_stmt() {
         else
             exit_with("expression");
 
-        if (identifiers[var_assign->ident.val.value()] != var_assign->expr->type) {
+        if (var->type != var_assign->expr->type) {
             exit_with(to_string(var_assign->expr->type), "wrong type ");
         }
 
@@ -478,14 +633,15 @@ std::optional<Node::ScopeStmt*> Parser::parse_scope_stmt() {
 
     // IDENT( ? )
     if (peek_type(TokenType::IDENTIFIER) && peek_type(TokenType::LEFT_PARENTHESIS, 1)) {
-        auto fcall = allocator.alloc<Node::FuncCall>();
+        auto fcall = allocator.emplace<Node::FuncCall>(Token{}, ArenaVector<Node::Expr*>(&allocator));
         fcall->ident = consume();
 
         if (is_buildin_func(fcall->ident.val.value())) {
-            fcall->type = buildin_func_type.at(fcall->ident.val.value());
+            fcall->type = buildin_func_type.find(fcall->ident.val.value())->second;
         }
-        else if (const auto t = var_type(fcall->ident.val.value())) {
-            fcall->type = t.value();
+        else if (const Symbol* f = symbol(fcall->ident.val.value())) {
+            fcall->type = f->type;
+            fcall->func = f->func;
         }
         else
             exit_with(fcall->ident.val.value(), "unknown identifier ");
@@ -561,8 +717,8 @@ std::optional<Node::ScopeStmt*> Parser::parse_scope_stmt() {
     return {};
 }
 
-std::vector<Node::Expr*> Parser::parse_args() {
-    std::vector<Node::Expr*> args{};
+ArenaVector<Node::Expr*> Parser::parse_args() {
+    ArenaVector<Node::Expr*> args(&allocator);
 
     if (const auto e = parse_expr()) {
         args.push_back(e.value());
@@ -580,7 +736,7 @@ std::vector<Node::Expr*> Parser::parse_args() {
 }
 
 std::optional<Node::IfPred*> Parser::parse_if_pred() {
-    if (auto t = try_consume(TokenType::ELIF)) {
+    if (try_consume(TokenType::ELIF)) {
         try_consume_err(TokenType::LEFT_PARENTHESIS);
         auto elif_pred = allocator.alloc<Node::IfPredElif>();
         if (const auto expr = parse_expr())
@@ -681,11 +837,11 @@ std::optional<Node::Expr*> Parser::parse_expr(int min_prec) {
     /// check compatibility between left and right expressions
     /// handle type compatibility and conversion
     while (true) {
-        std::optional<Token> curr_tok = peek();
+        const Token* curr_tok = peek();
         std::optional<int> prec;
 
-        if (curr_tok.has_value()) {
-            prec = op_prec(curr_tok.value().type);
+        if (curr_tok) {
+            prec = op_prec(curr_tok->type);
             if (!prec.has_value() || prec.value() < min_prec) {
                 break;
             }
@@ -693,7 +849,7 @@ std::optional<Node::Expr*> Parser::parse_expr(int min_prec) {
         else
             break;
 
-        Token op = consume();
+        const Token op = consume();
 
         int next_min_prec = prec.value() + 1;
         auto expr_rside = parse_expr(next_min_prec);
@@ -708,65 +864,14 @@ std::optional<Node::Expr*> Parser::parse_expr(int min_prec) {
                 to_string(expr->type) + " " + to_string(op.type) + " " + to_string(expr_rside.value()->type),
                 "wrong operation :");
 
-        expr->type = return_type.value();
+        const auto bin_op = to_bin_op(op.type);
+        assert(bin_op.has_value());
 
-        auto bin_expr = allocator.emplace<Node::BinExpr>();
-        auto expr_lside = allocator.emplace<Node::Expr>(expr->var);
-
-        if (op.type == TokenType::PLUS) {
-            auto add = allocator.emplace<Node::BinExprAdd>(expr_lside, expr_rside.value());
-            bin_expr->var = add;
-        }
-        else if (op.type == TokenType::MINUS) {
-            /// TODO: make sure you cannot sub strings
-            auto sub = allocator.emplace<Node::BinExprSub>(expr_lside, expr_rside.value());
-            bin_expr->var = sub;
-        }
-        else if (op.type == TokenType::STAR) {
-            auto multi = allocator.emplace<Node::BinExprMulti>(expr_lside, expr_rside.value());
-            bin_expr->var = multi;
-        }
-        else if (op.type == TokenType::SLASH) {
-            /// TODO: make sure you cannot divide strings
-            auto div = allocator.emplace<Node::BinExprDiv>(expr_lside, expr_rside.value());
-            bin_expr->var = div;
-        }
-        else if (op.type == TokenType::IS_EQUAL) {
-            auto iseq = allocator.emplace<Node::BinExprIsEqual>(expr_lside, expr_rside.value());
-            bin_expr->var = iseq;
-        }
-        else if (op.type == TokenType::IS_NOT_EQUAL) {
-            auto iseq = allocator.emplace<Node::BinExprIsNotEqual>(expr_lside, expr_rside.value());
-            bin_expr->var = iseq;
-        }
-        else if (op.type == TokenType::GREATER_OR_EQUAL) {
-            auto iseq = allocator.emplace<Node::BinExprGreaterOrEqual>(expr_lside, expr_rside.value());
-            bin_expr->var = iseq;
-        }
-        else if (op.type == TokenType::GREATER) {
-            auto iseq = allocator.emplace<Node::BinExprGreater>(expr_lside, expr_rside.value());
-            bin_expr->var = iseq;
-        }
-        else if (op.type == TokenType::LOWER_OR_EQUAL) {
-            auto iseq = allocator.emplace<Node::BinExprLowerOrEqual>(expr_lside, expr_rside.value());
-            bin_expr->var = iseq;
-        }
-        else if (op.type == TokenType::LOWER) {
-            auto iseq = allocator.emplace<Node::BinExprLower>(expr_lside, expr_rside.value());
-            bin_expr->var = iseq;
-        }
-        else if (op.type == TokenType::AND) {
-            auto iseq = allocator.emplace<Node::BinExprAnd>(expr_lside, expr_rside.value());
-            bin_expr->var = iseq;
-        }
-        else if (op.type == TokenType::OR) {
-            auto iseq = allocator.emplace<Node::BinExprOr>(expr_lside, expr_rside.value());
-            bin_expr->var = iseq;
-        }
-        else
-            assert(false); // unreachable
+        auto expr_lside = allocator.emplace<Node::Expr>(expr->var, expr->type);
+        auto bin_expr = allocator.emplace<Node::BinExpr>(bin_op.value(), expr_lside, expr_rside.value());
 
         expr->var = bin_expr;
+        expr->type = return_type.value();
     }
 
     return expr;
@@ -775,14 +880,15 @@ std::optional<Node::Expr*> Parser::parse_expr(int min_prec) {
 std::optional<Node::Term*> Parser::parse_term() {
     // FUNC CALL
     if (peek_type(TokenType::IDENTIFIER) && peek_type(TokenType::LEFT_PARENTHESIS, 1)) {
-        auto fcall = allocator.alloc<Node::FuncCall>();
+        auto fcall = allocator.emplace<Node::FuncCall>(Token{}, ArenaVector<Node::Expr*>(&allocator));
         fcall->ident = consume();
 
         if (is_buildin_func(fcall->ident.val.value())) {
-            fcall->type = buildin_func_type.at(fcall->ident.val.value());
+            fcall->type = buildin_func_type.find(fcall->ident.val.value())->second;
         }
-        else if (const auto t = var_type(fcall->ident.val.value())) {
-            fcall->type = t.value();
+        else if (const Symbol* f = symbol(fcall->ident.val.value())) {
+            fcall->type = f->type;
+            fcall->func = f->func;
         }
         else
             exit_with(fcall->ident.val.value(), "unknown identifier");
@@ -808,35 +914,35 @@ std::optional<Node::Term*> Parser::parse_term() {
 
     // LITERALS
     if (auto bool_lit = try_consume(TokenType::BOOLEAN_LITEARL)) {
-        auto term_bool_lit = allocator.emplace<Node::TermBooleanLiteral>(bool_lit.value());
+        auto term_bool_lit = allocator.emplace<Node::TermBooleanLiteral>(*bool_lit, bool_lit->val.value() == "true");
         auto term = allocator.emplace<Node::Term>(term_bool_lit);
         term->type = VarType::BOOL;
         return term;
     }
 
     if (auto int_lit = try_consume(TokenType::INTEGER_LITERAL)) {
-        auto term_int_lit = allocator.emplace<Node::TermIntegerLiteral>(int_lit.value());
+        auto term_int_lit = allocator.emplace<Node::TermIntegerLiteral>(*int_lit, int_literal(int_lit->val.value()));
         auto term = allocator.emplace<Node::Term>(term_int_lit);
         term->type = VarType::INT;
         return term;
     }
 
     if (auto char_lit = try_consume(TokenType::CHAR_LITERAL)) {
-        auto term_char_lit = allocator.emplace<Node::TermCharLiteral>(char_lit.value());
+        auto term_char_lit = allocator.emplace<Node::TermCharLiteral>(*char_lit);
         auto term = allocator.emplace<Node::Term>(term_char_lit);
         term->type = VarType::CHAR;
         return term;
     }
 
     if (auto string_lit = try_consume(TokenType::STRING_LITERAL)) {
-        auto term_string_lit = allocator.emplace<Node::TermStringLiteral>(string_lit.value());
+        auto term_string_lit = allocator.emplace<Node::TermStringLiteral>(*string_lit);
         auto term = allocator.emplace<Node::Term>(term_string_lit);
         term->type = VarType::STRING;
         return term;
     }
 
     // IN PARENTHESIS
-    if (auto open_paren = try_consume(TokenType::LEFT_PARENTHESIS)) {
+    if (try_consume(TokenType::LEFT_PARENTHESIS)) {
         auto expr = parse_expr();
         if (!expr.has_value())
             exit_with("expression");
@@ -854,13 +960,14 @@ std::optional<Node::Term*> Parser::parse_term() {
 
 std::optional<Node::TermIdentifier*> Parser::parse_identifier() {
     if (auto idtoken = try_consume(TokenType::IDENTIFIER)) {
-        auto ident = allocator.emplace<Node::TermIdentifier>(idtoken.value());
+        auto ident = allocator.emplace<Node::TermIdentifier>(*idtoken);
 
-        if (const auto t = var_type(idtoken.value().val.value())) {
-            ident->type = t.value();
+        if (const Symbol* var = symbol(idtoken->val.value())) {
+            ident->type = var->type;
+            bind(ident->slot, *var);
         }
         else
-            exit_with(idtoken.value().val.value(), "unknown identifier");
+            exit_with(idtoken->val.value(), "unknown identifier");
 
         return ident;
     }
@@ -869,16 +976,16 @@ std::optional<Node::TermIdentifier*> Parser::parse_identifier() {
 }
 
 std::optional<VarType> Parser::parse_type() {
-    if (auto t = try_consume(TokenType::TYPE_BOOL))
+    if (try_consume(TokenType::TYPE_BOOL))
         return VarType::BOOL;
 
-    if (auto t = try_consume(TokenType::TYPE_INT))
+    if (try_consume(TokenType::TYPE_INT))
         return VarType::INT;
 
-    if (auto t = try_consume(TokenType::TYPE_CHAR))
+    if (try_consume(TokenType::TYPE_CHAR))
         return VarType::CHAR;
 
-    if (auto t = try_consume(TokenType::TYPE_STRING))
+    if (try_consume(TokenType::TYPE_STRING))
         return VarType::STRING;
 
     return {};
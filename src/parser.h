@@ -1,11 +1,15 @@
 #pragma once
 
 #include <unordered_map>
+#include <string_view>
+#include <array>
+#include <functional>
 #include <cassert>
 #include <variant>
 
 #include "tokenizer.h"
 #include "arena.hpp"
+#include "symbols.h"
 
 enum VarType {
     VOID,
@@ -18,23 +22,57 @@ enum VarType {
 std::string to_string(VarType t);
 VarType to_variable_type(TokenType t);
 
+enum class BinOp {
+    ADD,
+    SUB,
+    MULTI,
+    DIV,
+
+    AND,
+    OR,
+    IS_EQUAL,
+    IS_NOT_EQUAL,
+    GREATER_OR_EQUAL,
+    GREATER,
+    LOWER_OR_EQUAL,
+    LOWER
+};
+
+// operator as written in the source (and in the generated code)
+std::string_view to_string(BinOp op);
+std::optional<BinOp> to_bin_op(TokenType t);
+
+// where a variable lives, resolved at parse time: an index in the globals or in the frame of its function
+struct VarSlot {
+    int index{ -1 };
+    bool global{ false };
+};
+
 namespace Node {
     struct Expr;
 
     struct Scope;
 
+    struct FuncDeclaration;
+
     struct FuncCall {
         Token ident;
-        std::vector<Expr*> args;
+        ArenaVector<Expr*> args;
         VarType type{ VarType::VOID };
+        // called function, nullptr for the buildin ones
+        FuncDeclaration* func{ nullptr };
     };
 
     struct TermBooleanLiteral {
         Token bool_lit;
+        // decoded once when parsed
+        bool value{ false };
     };
 
     struct TermIntegerLiteral {
         Token int_lit;
+        // decoded once when parsed, wrapped like the C++ backend's int
+        int32_t value{ 0 };
     };
 
     struct TermCharLiteral {
@@ -48,6 +86,7 @@ namespace Node {
     struct TermIdentifier {
         Token ident;
         VarType type{VarType::VOID};
+        VarSlot slot{};
     };
 
     struct TermParen {
@@ -67,84 +106,13 @@ namespace Node {
         VarType type{ VarType::VOID };
     };
 
-    struct BinExprAdd {
-        Expr* lside;
-        Expr* rside;
-    };
-
-    struct BinExprSub {
-        Expr* lside;
-        Expr* rside;
-    };
-
-    struct BinExprMulti {
-        Expr* lside;
-        Expr* rside;
-    };
-
-    struct BinExprDiv {
-        Expr* lside;
-        Expr* rside;
-    };
-
-    struct BinExprAnd {
-        Expr* lside;
-        Expr* rside;
-    };
-
-    struct BinExprOr {
-        Expr* lside;
-        Expr* rside;
-    };
-
-    struct BinExprIsEqual {
-        Expr* lside;
-        Expr* rside;
-    };
-
-    struct BinExprIsNotEqual {
-        Expr* lside;
-        Expr* rside;
-    };
-
-    struct BinExprGreaterOrEqual {
-        Expr* lside;
-        Expr* rside;
-    };
-
-    struct BinExprGreater {
-        Expr* lside;
-        Expr* rside;
-    };
-
-    struct BinExprLowerOrEqual {
-        Expr* lside;
-        Expr* rside;
-    };
-
-    struct BinExprLower {
+    // lside op rside
+    struct BinExpr {
+        BinOp op;
         Expr* lside;
         Expr* rside;
     };
 
-    struct BinExpr {
-        std::variant<
-            BinExprAdd*,
-            BinExprSub*,
-            BinExprMulti*,
-            BinExprDiv*,
-
-            BinExprAnd*,
-            BinExprOr*,
-            BinExprIsEqual*,
-            BinExprIsNotEqual*,
-            BinExprGreaterOrEqual*,
-            BinExprGreater*,
-            BinExprLowerOrEqual*,
-            BinExprLower*
-        > var;
-    };
-
     struct ExprNot {
         Expr* expr;
     };
@@ -174,12 +142,14 @@ namespace Node {
     struct StmtImplicitVar {
         Token identifier;
         Expr* expr;
+        VarSlot slot{};
     };
 
     // var ident : type
     struct StmtExplicitVar {
         Token ident;
         VarType type;
+        VarSlot slot{};
     };
 
     // func indent() { ? }
@@ -187,11 +157,14 @@ namespace Node {
         Token ident;
         Scope* scope;
         VarType type{ VarType::VOID };
+        // number of local slots of a call frame
+        int frame_slots{ 0 };
     };
 
     struct StmtVarAssign {
         Token ident;
         Expr* expr;
+        VarSlot slot{};
     };
 
     struct StmtReturn {
@@ -242,7 +215,7 @@ namespace Node {
     };
 
     struct Scope {
-        std::vector<ScopeStmt*> stmts;
+        ArenaVector<ScopeStmt*> stmts;
         VarType type{ VarType::VOID };
     };
 
@@ -255,69 +228,138 @@ namespace Node {
     };
 
     struct Prog {
-        std::vector<ProgStmt*> stmts;
+        ArenaVector<ProgStmt*> stmts;
+        int global_slots{ 0 };
     };
 }
 
 class Parser {
 private:
-    // contains every token in order
-    const std::vector<Token> tokens;
+    // what an identifier names: a variable and its slot, or a function
+    struct Symbol {
+        VarType type;
+        VarSlot slot{};
+        Node::FuncDeclaration* func{ nullptr };
+        // file declaring it, its global slots are numbered per file until the files are merged
+        int module{ 0 };
+    };
+
+    // tokens are pulled on demand from the tokenizer
+    Tokenizer& tokenizer;
+
+    // ring buffer of the lexed tokens: the lookahead plus the last consumed one (peek(-1))
+    static constexpr size_t LOOKAHEAD = 8;
+    std::array<Token, LOOKAHEAD> lookahead{};
 
     // current token index
     size_t index = 0;
 
+    // number of tokens pulled from the tokenizer so far
+    size_t lexed = 0;
+
+    // set once the tokenizer ran out of tokens
+    bool eof = false;
+
     ArenaAllocator allocator;
 
+    // function being parsed, its locals get frame slots (nullptr at the top level)
+    Node::FuncDeclaration* current_func = nullptr;
+
+    // number of global slots handed out so far
+    int global_slots = 0;
+
+    // index of the parsed file in the program
+    int module = 0;
+
+    // parsed files whose top-level declarations are visible here
+    std::vector<const Parser*> imports;
+
+    // every global slot written in the tree with the file declaring the global, see relocate_globals
+    std::vector<std::pair<VarSlot*, int>> global_refs;
+
+    // first declaration of each local name, checked against the globals of the other files once they are all
+    // parsed; local_names tells by id if the name is in it
+    std::vector<Token> local_decls;
+    std::vector<bool> local_names;
+
     // map the buildin functions and their return type
-    static const std::unordered_map<std::string, VarType> buildin_func_type;
+    static const IdentifierMap<VarType> buildin_func_type;
 
     // check if an identifier is a buildin function
-    static bool is_buildin_func(const std::string& func);
+    static bool is_buildin_func(std::string_view func);
 
-    // map the identifiers (vars and funcs) with their return type
-    static std::unordered_map<std::string, VarType> identifiers;
+    // ids of the identifiers met so far, owned by the parser so nothing is shared between two parses
+    Interner interner;
 
-    // check if an identifier exist or not
-    static bool is_var(const std::string& var);
+    // the identifiers (vars and funcs) in scope with their return type and storage, by id; a scope
+    // is pushed and popped by parse_scope, the globals and the functions stay in the outermost one
+    SymbolTable<Symbol> symbols;
 
-    static std::optional<VarType> get_return_type(VarType t1, TokenType op, VarType t2);
+    // check if an identifier is in scope or not
+    bool is_var(std::string_view var);
 
-    // parse the type associated with an identifier
-    std::optional<VarType> var_type(const std::string& ident);
+    // register a variable in the frame of the current function (or in the globals) and set its slot
+    void declare_var(const Token& ident, VarType type, VarSlot& slot);
 
-    // peek the current token (use the offset to check forward or backward)
-    std::optional<Token> peek(const int offset = 0) const;
+    // set the slot of a reference to a variable
+    void bind(VarSlot& slot, const Symbol& var);
+
+    // symbol of an identifier in scope or declared at the top level of an imported file (nullptr if it is unknown)
+    const Symbol* symbol(std::string_view ident) const;
+
+    // symbol of a top-level declaration, once the file is parsed (nullptr if there is none)
+    const Symbol* exported(std::string_view ident) const;
+
+    static std::optional<VarType> get_return_type(VarType t1, TokenType op, VarType t2);
+
+    // peek the current token (use the offset to check forward, or -1 for the previous one); nullptr past the end
+    // the pointed token is overwritten once LOOKAHEAD more tokens are lexed, copy it to keep it longer
+    const Token* peek(const int offset = 0);
 
     // check the type of the current token (return false if there is no token left)
-    bool peek_type(TokenType type, int offset = 0) const;
+    bool peek_type(TokenType type, int offset = 0);
 
     // consume the current token and return it; move to the next token
-    Token consume();
+    const Token& consume();
 
     // consume if the token have the given type; else exit with an error
-    Token try_consume_err(TokenType type);
+    const Token& try_consume_err(TokenType type);
 
-    // try to consume a token of a specific type
-    std::optional<Token> try_consume(TokenType type);
+    // try to consume a token of a specific type (nullptr if it does not match)
+    const Token* try_consume(TokenType type);
 
     /// @brief exit with an error message
     /// @param err_msg content of the error message
     /// @param template_msg balise of it (ex: missing, expected, ...)
-    void exit_with(const std::string& err_msg, std::string template_msg = "missing");
+    [[noreturn]] void exit_with(std::string_view err_msg, std::string_view template_msg = "missing");
 
 public:
-    Parser(std::vector<Token> tokens);
+    /// @param module index of the file in the program
+    Parser(Tokenizer& tokenizer, int module = 0);
+
+    /// @brief parse the `import "file.ce"` statements at the top of the file
+    /// @return the paths as written, relative to the directory of the file
+    std::vector<std::string_view> parse_imports();
+
+    /// @brief make the top-level declarations of another file visible here, it must be parsed before this one
+    void import(const Parser& parser);
 
     std::optional<Node::Prog> parse_prog();
 
+    /// @brief move the global slots from the numbering of each file to the one of the merged program
+    /// @param bases first slot of the globals of each file, by module index
+    void relocate_globals(const std::vector<int>& bases);
+
+    /// @brief first declaration of each name the file gives to a local
+    const std::vector<Token>& locals() const { return local_decls; }
+
     std::optional<Node::ProgStmt*> parse_prog_stmt();
 
     std::optional<Node::Scope*> parse_scope();
 
     std::optional<Node::ScopeStmt*> parse_scope_stmt();
 
-    std::vector<Node::Expr*> parse_args();
+    ArenaVector<Node::Expr*> parse_args();
 
     std::optional<Node::IfPred*> parse_if_pred();
 
@@ -0,0 +1,295 @@
+#include "scan.h"
+
+#include <bit>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+namespace scan {
+    namespace {
+        /* ----- SCALAR ----- */
+
+        constexpr bool is_ident(unsigned char c) {
+            return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+        }
+
+        constexpr bool is_blank(unsigned char c) {
+            return c == ' ' || c == '\n' || c == '\t' || c == '\v' || c == '\f' || c == '\r';
+        }
+
+        size_t line_end_scalar(const char* p, size_t n, size_t i = 0) {
+            while (i < n && p[i] != '\n')
+                i++;
+            return i;
+        }
+
+        size_t block_comment_end_scalar(const char* p, size_t n, int& lines, size_t i = 0) {
+            for (; i < n; i++) {
+                if (p[i] == '*' && i + 1 < n && p[i + 1] == '/')
+                    return i;
+                if (p[i] == '\n')
+                    lines++;
+            }
+            return n;
+        }
+
+        size_t ident_run_scalar(const char* p, size_t n, size_t i = 0) {
+            while (i < n && is_ident(static_cast<unsigned char>(p[i])))
+                i++;
+            return i;
+        }
+
+        size_t blank_run_scalar(const char* p, size_t n, int& lines, size_t i = 0) {
+            for (; i < n && is_blank(static_cast<unsigned char>(p[i])); i++) {
+                if (p[i] == '\n')
+                    lines++;
+            }
+            return i;
+        }
+
+#ifdef SCAN_X86
+        /* ----- SSE2 ----- */
+
+        // signed byte compares only: shift the range so it starts at -128 and test `< -128 + len`
+        inline __m128i in_range_sse2(__m128i v, char lo, char len) {
+            const __m128i shifted = _mm_add_epi8(v, _mm_set1_epi8(static_cast<char>(-128 - lo)));
+            return _mm_cmplt_epi8(shifted, _mm_set1_epi8(static_cast<char>(-128 + len)));
+        }
+
+        inline __m128i ident_mask_sse2(__m128i v) {
+            const __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+            const __m128i alpha = in_range_sse2(lower, 'a', 26);
+            const __m128i digit = in_range_sse2(v, '0', 10);
+            const __m128i under = _mm_cmpeq_epi8(v, _mm_set1_epi8('_'));
+            return _mm_or_si128(_mm_or_si128(alpha, digit), under);
+        }
+
+        inline __m128i blank_mask_sse2(__m128i v) {
+            // \t \n \v \f \r are contiguous
+            const __m128i ctrl = in_range_sse2(v, '\t', 5);
+            const __m128i space = _mm_cmpeq_epi8(v, _mm_set1_epi8(' '));
+            return _mm_or_si128(ctrl, space);
+        }
+
+        inline uint32_t movemask_sse2(__m128i v) {
+            return static_cast<uint32_t>(_mm_movemask_epi8(v));
+        }
+
+        size_t line_end_sse2(const char* p, size_t n) {
+            const __m128i nl = _mm_set1_epi8('\n');
+            size_t i = 0;
+
+            for (; i + 16 <= n; i += 16) {
+                const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+                if (const uint32_t m = movemask_sse2(_mm_cmpeq_epi8(v, nl)))
+                    return i + std::countr_zero(m);
+            }
+
+            return line_end_scalar(p, n, i);
+        }
+
+        size_t block_comment_end_sse2(const char* p, size_t n, int& lines) {
+            const __m128i star = _mm_set1_epi8('*');
+            const __m128i slash = _mm_set1_epi8('/');
+            const __m128i nl = _mm_set1_epi8('\n');
+            size_t i = 0;
+
+            // p[i + 16] is read by the shifted load
+            for (; i + 17 <= n; i += 16) {
+                const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+                const __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i + 1));
+                const uint32_t close = movemask_sse2(_mm_and_si128(_mm_cmpeq_epi8(v, star), _mm_cmpeq_epi8(next, slash)));
+                const uint32_t newlines = movemask_sse2(_mm_cmpeq_epi8(v, nl));
+
+                if (close) {
+                    const int pos = std::countr_zero(close);
+                    lines += std::popcount(newlines & ((1u << pos) - 1));
+                    return i + pos;
+                }
+
+                lines += std::popcount(newlines);
+            }
+
+            return block_comment_end_scalar(p, n, lines, i);
+        }
+
+        size_t ident_run_sse2(const char* p, size_t n) {
+            size_t i = 0;
+
+            for (; i + 16 <= n; i += 16) {
+                const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+                if (const uint32_t stop = ~movemask_sse2(ident_mask_sse2(v)) & 0xFFFF)
+                    return i + std::countr_zero(stop);
+            }
+
+            return ident_run_scalar(p, n, i);
+        }
+
+        size_t blank_run_sse2(const char* p, size_t n, int& lines) {
+            const __m128i nl = _mm_set1_epi8('\n');
+            size_t i = 0;
+
+            for (; i + 16 <= n; i += 16) {
+                const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+                const uint32_t stop = ~movemask_sse2(blank_mask_sse2(v)) & 0xFFFF;
+                const uint32_t newlines = movemask_sse2(_mm_cmpeq_epi8(v, nl));
+
+                if (stop) {
+                    const int pos = std::countr_zero(stop);
+                    lines += std::popcount(newlines & ((1u << pos) - 1));
+                    return i + pos;
+                }
+
+                lines += std::popcount(newlines);
+            }
+
+            return blank_run_scalar(p, n, lines, i);
+        }
+
+        /* ----- AVX2 ----- */
+
+#define SCAN_AVX2 __attribute__((target("avx2")))
+
+        SCAN_AVX2 inline __m256i in_range_avx2(__m256i v, char lo, char len) {
+            const __m256i shifted = _mm256_add_epi8(v, _mm256_set1_epi8(static_cast<char>(-128 - lo)));
+            return _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(-128 + len)), shifted);
+        }
+
+        SCAN_AVX2 inline __m256i ident_mask_avx2(__m256i v) {
+            const __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+            const __m256i alpha = in_range_avx2(lower, 'a', 26);
+            const __m256i digit = in_range_avx2(v, '0', 10);
+            const __m256i under = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_'));
+            return _mm256_or_si256(_mm256_or_si256(alpha, digit), under);
+        }
+
+        SCAN_AVX2 inline __m256i blank_mask_avx2(__m256i v) {
+            const __m256i ctrl = in_range_avx2(v, '\t', 5);
+            const __m256i space = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '));
+            return _mm256_or_si256(ctrl, space);
+        }
+
+        SCAN_AVX2 inline uint32_t movemask_avx2(__m256i v) {
+            return static_cast<uint32_t>(_mm256_movemask_epi8(v));
+        }
+
+        SCAN_AVX2 size_t line_end_avx2(const char* p, size_t n) {
+            const __m256i nl = _mm256_set1_epi8('\n');
+            size_t i = 0;
+
+            for (; i + 32 <= n; i += 32) {
+                const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+                if (const uint32_t m = movemask_avx2(_mm256_cmpeq_epi8(v, nl)))
+                    return i + std::countr_zero(m);
+            }
+
+            return line_end_scalar(p, n, i);
+        }
+
+        SCAN_AVX2 size_t block_comment_end_avx2(const char* p, size_t n, int& lines) {
+            const __m256i star = _mm256_set1_epi8('*');
+            const __m256i slash = _mm256_set1_epi8('/');
+            const __m256i nl = _mm256_set1_epi8('\n');
+            size_t i = 0;
+
+            for (; i + 33 <= n; i += 32) {
+                const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+                const __m256i next = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i + 1));
+                const uint32_t close = movemask_avx2(_mm256_and_si256(_mm256_cmpeq_epi8(v, star), _mm256_cmpeq_epi8(next, slash)));
+                const uint32_t newlines = movemask_avx2(_mm256_cmpeq_epi8(v, nl));
+
+                if (close) {
+                    const int pos = std::countr_zero(close);
+                    lines += std::popcount(newlines & ((1u << pos) - 1));
+                    return i + pos;
+                }
+
+                lines += std::popcount(newlines);
+            }
+
+            return block_comment_end_scalar(p, n, lines, i);
+        }
+
+        SCAN_AVX2 size_t ident_run_avx2(const char* p, size_t n) {
+            size_t i = 0;
+
+            for (; i + 32 <= n; i += 32) {
+                const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+                if (const uint32_t stop = ~movemask_avx2(ident_mask_avx2(v)))
+                    return i + std::countr_zero(stop);
+            }
+
+            return ident_run_scalar(p, n, i);
+        }
+
+        SCAN_AVX2 size_t blank_run_avx2(const char* p, size_t n, int& lines) {
+            const __m256i nl = _mm256_set1_epi8('\n');
+            size_t i = 0;
+
+            for (; i + 32 <= n; i += 32) {
+                const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+                const uint32_t stop = ~movemask_avx2(blank_mask_avx2(v));
+                const uint32_t newlines = movemask_avx2(_mm256_cmpeq_epi8(v, nl));
+
+                if (stop) {
+                    const int pos = std::countr_zero(stop);
+                    lines += std::popcount(newlines & ((1u << pos) - 1));
+                    return i + pos;
+                }
+
+                lines += std::popcount(newlines);
+            }
+
+            return blank_run_scalar(p, n, lines, i);
+        }
+
+#undef SCAN_AVX2
+#endif
+
+        /* ----- DISPATCH ----- */
+
+        struct Kernels {
+            size_t (*line_end)(const char*, size_t);
+            size_t (*block_comment_end)(const char*, size_t, int&);
+            size_t (*ident_run)(const char*, size_t);
+            size_t (*blank_run)(const char*, size_t, int&);
+        };
+
+        Kernels select_kernels() {
+#ifdef SCAN_X86
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2"))
+                return { line_end_avx2, block_comment_end_avx2, ident_run_avx2, blank_run_avx2 };
+            if (__builtin_cpu_supports("sse2"))
+                return { line_end_sse2, block_comment_end_sse2, ident_run_sse2, blank_run_sse2 };
+#endif
+            return {
+                [](const char* p, size_t n) { return line_end_scalar(p, n); },
+                [](const char* p, size_t n, int& lines) { return block_comment_end_scalar(p, n, lines); },
+                [](const char* p, size_t n) { return ident_run_scalar(p, n); },
+                [](const char* p, size_t n, int& lines) { return blank_run_scalar(p, n, lines); },
+            };
+        }
+
+        const Kernels kernels = select_kernels();
+    }
+
+    size_t line_end(const char* p, size_t n) {
+        return kernels.line_end(p, n);
+    }
+
+    size_t block_comment_end(const char* p, size_t n, int& lines) {
+        return kernels.block_comment_end(p, n, lines);
+    }
+
+    size_t ident_run(const char* p, size_t n) {
+        return kernels.ident_run(p, n);
+    }
+
+    size_t blank_run(const char* p, size_t n, int& lines) {
+        return kernels.blank_run(p, n, lines);
+    }
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+
+/// @brief vectorized scanning kernels used by the tokenizer hot loops
+/// @note the widest kernel supported by the cpu (AVX2, SSE2 or scalar) is picked once at runtime
+namespace scan {
+    /// @brief find the end of a line comment
+    /// @return index of the first `\n` in [p, p + n) or n
+    size_t line_end(const char* p, size_t n);
+
+    /// @brief find the end of a block comment body
+    /// @param lines incremented by the number of `\n` before the returned index
+    /// @return index of the `*` of the closing `*/` or n
+    size_t block_comment_end(const char* p, size_t n, int& lines);
+
+    /// @brief measure a run of identifier characters `[A-Za-z0-9_]`
+    /// @return length of the run starting at p
+    size_t ident_run(const char* p, size_t n);
+
+    /// @brief measure a run of whitespace (new lines included)
+    /// @param lines incremented by the number of `\n` in the run
+    /// @return length of the run starting at p
+    size_t blank_run(const char* p, size_t n, int& lines);
+}
@@ -0,0 +1,77 @@
+#include "source.h"
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace {
+    [[noreturn]] void exit_with(const std::string& path, const char* what) {
+        std::cerr << "[Error] cannot " << what << " `" << path << "`: " << std::strerror(errno) << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+SourceFile::SourceFile(const std::string& path) {
+    if (path == "-") {
+        if (!read_all(STDIN_FILENO))
+            exit_with(path, "read");
+        _content = _buffer;
+        return;
+    }
+
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        exit_with(path, "open");
+
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+        exit_with(path, "stat");
+
+    if (S_ISREG(st.st_mode) && st.st_size > 0) {
+        _map_size = static_cast<size_t>(st.st_size);
+        void* map = mmap(nullptr, _map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (map != MAP_FAILED) {
+            madvise(map, _map_size, MADV_SEQUENTIAL);
+            _map = map;
+            _content = std::string_view(static_cast<const char*>(_map), _map_size);
+            close(fd);
+            return;
+        }
+
+        _map_size = 0;
+    }
+
+    // pipes, fifos, procfs entries or a failed mapping
+    if (!read_all(fd))
+        exit_with(path, "read");
+    close(fd);
+
+    _content = _buffer;
+}
+
+SourceFile::~SourceFile() {
+    if (_map != nullptr)
+        munmap(_map, _map_size);
+}
+
+bool SourceFile::read_all(int fd) {
+    char chunk[64 * 1024];
+
+    while (true) {
+        const ssize_t n = read(fd, chunk, sizeof(chunk));
+        if (n == 0)
+            return true;
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        _buffer.append(chunk, static_cast<size_t>(n));
+    }
+}
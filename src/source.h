@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+/// @brief read-only view over the content of a source file
+/// @note regular files are memory-mapped so the tokenizer lexes straight over the mapped pages,
+/// stdin (`-`) and pipes fall back to reading into an owned buffer
+class SourceFile {
+private:
+    /// @brief mapped pages (nullptr when the content is buffered)
+    void* _map = nullptr;
+    /// @brief size of the mapping in bytes
+    size_t _map_size = 0;
+    /// @brief fallback storage for stdin and non-regular files
+    std::string _buffer;
+    /// @brief view over either the mapping or the buffer
+    std::string_view _content;
+
+    /// @brief read a whole file descriptor into the fallback buffer
+    /// @param fd file descriptor to drain
+    /// @return false if a read error occured
+    bool read_all(int fd);
+
+public:
+    /// @brief open a source file and exit with an error if it cannot be read
+    /// @param path path to the file, `-` reads from stdin
+    SourceFile(const std::string& path);
+
+    SourceFile(const SourceFile&) = delete;
+
+    SourceFile& operator=(const SourceFile&) = delete;
+
+    ~SourceFile();
+
+    /// @brief content of the file, valid as long as this object lives
+    std::string_view view() const { return _content; }
+};
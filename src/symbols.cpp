@@ -0,0 +1,16 @@
+#include "symbols.h"
+
+SymbolId Interner::intern(std::string_view name) {
+    if (const auto it = ids.find(name); it != ids.end())
+        return it->second;
+
+    const SymbolId id = static_cast<SymbolId>(ids.size());
+    ids.emplace(name, id);
+    return id;
+}
+
+std::optional<SymbolId> Interner::find(std::string_view name) const {
+    if (const auto it = ids.find(name); it != ids.end())
+        return it->second;
+    return {};
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/// @brief hash identifiers by view so lookups from token values never build a std::string
+struct IdentifierHash {
+    using is_transparent = void;
+
+    size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+};
+
+template<typename T>
+using IdentifierMap = std::unordered_map<std::string, T, IdentifierHash, std::equal_to<>>;
+
+/// @brief dense number of an interned identifier, the same name always gets the same id
+using SymbolId = int32_t;
+
+/// @brief gives every distinct identifier a small integer, so the tables past it are plain vectors
+class Interner {
+private:
+    IdentifierMap<SymbolId> ids;
+
+public:
+    /// @brief id of a name, a new one the first time it is seen
+    SymbolId intern(std::string_view name);
+
+    /// @brief id of a name already interned (nullopt if it never was, so it is declared nowhere)
+    std::optional<SymbolId> find(std::string_view name) const;
+
+    /// @brief number of ids handed out, they are [0, size)
+    size_t size() const { return ids.size(); }
+};
+
+/// @brief what the identifiers are bound to in the scopes open at the current point of the parse
+/// @note push and pop are O(1) amortized: a declaration logs the binding it hides, pop restores the
+/// bindings logged since the matching push; the outermost scope is never popped and logs nothing
+template<typename T>
+class SymbolTable {
+private:
+    /// @brief binding visible for each id (nullopt if the identifier is not in scope)
+    std::vector<std::optional<T>> bindings;
+
+    /// @brief id declared by an open scope and the binding it had before
+    std::vector<std::pair<SymbolId, std::optional<T>>> undo;
+
+    /// @brief size of `undo` when each open scope was pushed
+    std::vector<size_t> marks;
+
+public:
+    void push() {
+        marks.push_back(undo.size());
+    }
+
+    void pop() {
+        for (size_t mark = marks.back(); undo.size() > mark; undo.pop_back())
+            bindings[undo.back().first] = std::move(undo.back().second);
+
+        marks.pop_back();
+    }
+
+    /// @brief bind an id in the innermost open scope (the outermost if none is open)
+    void declare(SymbolId id, T value) {
+        if (static_cast<size_t>(id) >= bindings.size())
+            bindings.resize(id + 1);
+
+        if (!marks.empty())
+            undo.emplace_back(id, std::move(bindings[id]));
+
+        bindings[id] = std::move(value);
+    }
+
+    /// @brief binding of an id (nullptr if it is not in scope)
+    const T* find(SymbolId id) const {
+        if (static_cast<size_t>(id) >= bindings.size() || !bindings[id].has_value())
+            return nullptr;
+        return &bindings[id].value();
+    }
+};
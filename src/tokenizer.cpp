@@ -1,5 +1,13 @@
 #include "tokenizer.h"
 
+#include "scan.h"
+
+#include <array>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+
 std::string to_string(const TokenType type) {
     switch (type) {
     case TokenType::RETURN:
@@ -8,6 +16,8 @@ std::string to_string(const TokenType type) {
         return "var";
     case TokenType::FUNC:
         return "func";
+    case TokenType::IMPORT:
+        return "import";
     case TokenType::IDENTIFIER:
         return "identifier";
     case TokenType::TYPE_BOOL:
@@ -110,261 +120,356 @@ std::optional<int> op_prec(TokenType type) {
     }
 }
 
-Tokenizer::Tokenizer(const std::string& src)
-    : _src(std::move(src)) {
+std::string unescape(std::string_view lit) {
+    std::string s;
+    s.reserve(lit.size());
+
+    for (size_t i = 0; i < lit.size(); i++) {
+        if (lit[i] != '\\' || i + 1 == lit.size()) {
+            s += lit[i];
+            continue;
+        }
+
+        switch (lit[++i]) {
+        case 'n':
+            s += '\n';
+            break;
+        case 't':
+            s += '\t';
+            break;
+        case 'r':
+            s += '\r';
+            break;
+        case '0':
+            s += '\0';
+            break;
+        default:
+            s += lit[i];
+        }
+    }
+
+    return s;
 }
 
-std::optional<char> Tokenizer::peek(const size_t offset) const {
+namespace {
+    /* ----- CHARACTER CLASSES ----- */
+
+    enum class CharClass : uint8_t {
+        INVALID,
+        SPACE,
+        NEWLINE,
+        ALPHA,
+        DIGIT,
+        SLASH,
+        QUOTE,
+        DOUBLE_QUOTE,
+        OPERATOR
+    };
+
+    /// @brief how to lex a punctuation character: a single char token,
+    /// optionally extended into a two chars token when followed by `next`
+    struct Operator {
+        TokenType single;
+        char next = '\0';
+        TokenType pair = TokenType::IDENTIFIER;
+        /// @brief the single char form is not a valid token (`&` and `|`)
+        bool pair_only = false;
+    };
+
+    constexpr std::array<CharClass, 256> char_classes = [] {
+        std::array<CharClass, 256> table{};
+
+        for (int c = 'a'; c <= 'z'; c++)
+            table[c] = CharClass::ALPHA;
+        for (int c = 'A'; c <= 'Z'; c++)
+            table[c] = CharClass::ALPHA;
+        for (int c = '0'; c <= '9'; c++)
+            table[c] = CharClass::DIGIT;
+
+        for (const char c : { ' ', '\t', '\v', '\f', '\r' })
+            table[static_cast<unsigned char>(c)] = CharClass::SPACE;
+        table['\n'] = CharClass::NEWLINE;
+
+        table['/'] = CharClass::SLASH;
+        table['\''] = CharClass::QUOTE;
+        table['"'] = CharClass::DOUBLE_QUOTE;
+
+        for (const char c : { '=', ':', ',', '(', ')', '{', '}', '+', '-', '*', '!', '&', '|', '>', '<' })
+            table[static_cast<unsigned char>(c)] = CharClass::OPERATOR;
+
+        return table;
+    }();
+
+    constexpr std::array<Operator, 256> operators = [] {
+        std::array<Operator, 256> table{};
+
+        table['='] = { TokenType::EQUAL, '=', TokenType::IS_EQUAL };
+        table[':'] = { TokenType::COLON };
+        table[','] = { TokenType::COMMA };
+        table['('] = { TokenType::LEFT_PARENTHESIS };
+        table[')'] = { TokenType::RIGHT_PARENTHESIS };
+        table['{'] = { TokenType::LEFT_CURLY_BACKET };
+        table['}'] = { TokenType::RIGHT_CURLY_BRACKET };
+        table['+'] = { TokenType::PLUS, '+', TokenType::INCREMENTATOR };
+        table['-'] = { TokenType::MINUS, '-', TokenType::DECREMENTATOR };
+        table['*'] = { TokenType::STAR };
+        table['/'] = { TokenType::SLASH };
+        table['!'] = { TokenType::NOT, '=', TokenType::IS_NOT_EQUAL };
+        table['&'] = { TokenType::AND, '&', TokenType::AND, true };
+        table['|'] = { TokenType::OR, '|', TokenType::OR, true };
+        table['>'] = { TokenType::GREATER, '=', TokenType::GREATER_OR_EQUAL };
+        table['<'] = { TokenType::LOWER, '=', TokenType::LOWER_OR_EQUAL };
+
+        return table;
+    }();
+
+    constexpr CharClass char_class(char c) {
+        return char_classes[static_cast<unsigned char>(c)];
+    }
+
+
+    /* ----- KEYWORDS ----- */
+
+    struct Keyword {
+        std::string_view text;
+        TokenType type = TokenType::IDENTIFIER;
+    };
+
+    constexpr Keyword keywords[] = {
+        { "bool", TokenType::TYPE_BOOL },
+        { "int", TokenType::TYPE_INT },
+        { "char", TokenType::TYPE_CHAR },
+        { "string", TokenType::TYPE_STRING },
+        { "true", TokenType::BOOLEAN_LITEARL },
+        { "false", TokenType::BOOLEAN_LITEARL },
+        { "var", TokenType::VAR },
+        { "func", TokenType::FUNC },
+        { "import", TokenType::IMPORT },
+        { "return", TokenType::RETURN },
+        { "while", TokenType::WHILE },
+        { "if", TokenType::IF },
+        { "elif", TokenType::ELIF },
+        { "else", TokenType::ELSE },
+    };
+
+    constexpr size_t KEYWORD_TABLE_SIZE = 32;
+
+    struct KeywordSeed {
+        unsigned first;
+        unsigned last;
+    };
+
+    constexpr size_t keyword_hash(std::string_view s, KeywordSeed seed) {
+        return (static_cast<unsigned char>(s.front()) * seed.first
+            + static_cast<unsigned char>(s.back()) * seed.last
+            + s.size()) % KEYWORD_TABLE_SIZE;
+    }
+
+    /// @brief search the smallest multipliers giving a collision free hash over the keyword set
+    consteval KeywordSeed find_keyword_seed() {
+        for (unsigned first = 1; first < 64; first++) {
+            for (unsigned last = 1; last < 64; last++) {
+                bool used[KEYWORD_TABLE_SIZE]{};
+                bool perfect = true;
+
+                for (const Keyword& k : keywords) {
+                    const size_t h = keyword_hash(k.text, { first, last });
+                    if (used[h]) {
+                        perfect = false;
+                        break;
+                    }
+                    used[h] = true;
+                }
+
+                if (perfect)
+                    return { first, last };
+            }
+        }
+        return { 0, 0 };
+    }
+
+    constexpr KeywordSeed keyword_seed = find_keyword_seed();
+    static_assert(keyword_seed.first != 0, "no perfect hash found for the keyword set");
+
+    constexpr std::array<Keyword, KEYWORD_TABLE_SIZE> keyword_table = [] {
+        std::array<Keyword, KEYWORD_TABLE_SIZE> table{};
+        for (const Keyword& k : keywords)
+            table[keyword_hash(k.text, keyword_seed)] = k;
+        return table;
+    }();
+
+    /// @brief classify an identifier-like word
+    /// @return the keyword token type or IDENTIFIER
+    TokenType keyword_type(std::string_view word) {
+        const Keyword& k = keyword_table[keyword_hash(word, keyword_seed)];
+        return k.text == word ? k.type : TokenType::IDENTIFIER;
+    }
+}
+
+void exit_with_error(const std::string& message) {
+    static std::mutex lock;
+    lock.lock(); // never released, the process ends here
+
+    std::cerr << message << std::endl;
+
+    // the other threads may still be parsing: skip the destructors of the statics they could be reading
+    std::quick_exit(EXIT_FAILURE);
+}
+
+Tokenizer::Tokenizer(std::string_view src, std::string_view path)
+    : _src(src), _path(path) {
+}
+
+std::string Tokenizer::location(int line) const {
+    std::string s = "line " + std::to_string(line);
+    if (!_path.empty())
+        s += " of " + std::string(_path);
+    return s;
+}
+
+void Tokenizer::exit_with(const std::string& err_msg) const {
+    exit_with_error("[Error] " + err_msg + " on " + location(_line));
+}
+
+char Tokenizer::peek(const size_t offset) const {
     if (_index + offset >= _src.length())
-        return {};
-    return _src.at(_index + offset);
+        return '\0';
+    return _src[_index + offset];
 }
 
 char Tokenizer::consume() {
     return _src[_index++];
 }
 
-std::vector<Token> Tokenizer::tokenize() {
-    std::vector<Token> tokens;
-    std::string buf;
-    int line_count = 1;
+std::optional<Token> Tokenizer::next() {
+    const size_t end = _src.length();
 
-    while (peek().has_value()) {
-        if (peek().value() == '/' && peek(1).has_value() && peek(1).value() == '/') {
-            while (peek().has_value() && peek().value() != '\n')
-                consume();
-        }
-        else if (peek().value() == '/' && peek(1).has_value() && peek(1).value() == '*') {
-            consume();
-            consume();
+    while (_index < end) {
+        const char c = _src[_index];
 
-            while (peek().has_value()) {
-                if (peek().value() == '*' && peek(1).has_value() && peek(1).value() == '/')
-                    break;
-                if (peek().value() == '\n')
-                    line_count++;
-                consume();
-            }
+        switch (char_class(c)) {
+        case CharClass::NEWLINE:
+            _line++;
+            [[fallthrough]];
 
-            if (peek().has_value())
-                consume();
-            if (peek().has_value())
-                consume();
-        }
-        else if (std::isalpha(peek().value())) {
-            buf.push_back(consume());
-            while (peek().has_value() &&
-                (std::isalnum(peek().value()) || peek().value() == '_')) {
-                buf.push_back(consume());
-            }
+        case CharClass::SPACE:
+            _index++;
 
-            // TYPES
-            if (buf == "bool")
-                tokens.push_back({ .type = TokenType::TYPE_BOOL, .line = line_count });
-            else if (buf == "int")
-                tokens.push_back({ .type = TokenType::TYPE_INT, .line = line_count });
-            else if (buf == "char")
-                tokens.push_back({ .type = TokenType::TYPE_CHAR, .line = line_count });
-            else if (buf == "string")
-                tokens.push_back({ .type = TokenType::TYPE_STRING, .line = line_count });
-
-            // KEYWORDS
-            else if (buf == "true")
-                tokens.push_back({ .type = TokenType::BOOLEAN_LITEARL, .line = line_count, .val = "true" });
-            else if (buf == "false")
-                tokens.push_back({ .type = TokenType::BOOLEAN_LITEARL, .line = line_count, .val = "false" });
-            else if (buf == "var")
-                tokens.push_back({ .type = TokenType::VAR, .line = line_count });
-            else if (buf == "func")
-                tokens.push_back({ .type = TokenType::FUNC, .line = line_count });
-            else if (buf == "return")
-                tokens.push_back({ .type = TokenType::RETURN, .line = line_count });
-            else if (buf == "while")
-                tokens.push_back({ .type = TokenType::WHILE, .line = line_count });
-            else if (buf == "if")
-                tokens.push_back({ .type = TokenType::IF, .line = line_count });
-            else if (buf == "elif")
-                tokens.push_back({ .type = TokenType::ELIF, .line = line_count });
-            else if (buf == "else")
-                tokens.push_back({ .type = TokenType::ELSE, .line = line_count });
-            else
-                tokens.push_back({ .type = TokenType::IDENTIFIER, .line = line_count, .val = buf });
-
-            buf.clear();
-        }
-        else if (std::isdigit(peek().value())) {
-            buf.push_back(consume());
-            while (peek().has_value() && std::isdigit(peek().value())) {
-                buf.push_back(consume());
-            }
-            tokens.push_back({ .type = TokenType::INTEGER_LITERAL,
-                              .line = line_count,
-                              .val = buf });
-            buf.clear();
-        }
-        else if (peek().value() == '=') {
-            consume();
+            // indentation and blank lines: skip the rest of the run at once
+            if (const CharClass next = char_class(peek()); next == CharClass::SPACE || next == CharClass::NEWLINE)
+                _index += scan::blank_run(_src.data() + _index, end - _index, _line);
+            break;
 
-            if (peek().has_value() && peek().value() == '=') {
-                consume();
-                tokens.push_back({ .type = TokenType::IS_EQUAL, .line = line_count });
-            }
-            else
-                tokens.push_back({ .type = TokenType::EQUAL, .line = line_count });
-        }
-        else if (peek().value() == ':') {
-            consume();
-            tokens.push_back({ .type = TokenType::COLON, .line = line_count });
-        }
-        else if (peek().value() == ',') {
-            consume();
-            tokens.push_back({ .type = TokenType::COMMA, .line = line_count });
-        }
-        else if (peek().value() == '(') {
-            consume();
-            tokens.push_back({ .type = TokenType::LEFT_PARENTHESIS, .line = line_count });
-        }
-        else if (peek().value() == ')') {
-            consume();
-            tokens.push_back({ .type = TokenType::RIGHT_PARENTHESIS, .line = line_count });
-        }
-        else if (peek().value() == '{') {
-            consume();
-            tokens.push_back({ .type = TokenType::LEFT_CURLY_BACKET, .line = line_count });
-        }
-        else if (peek().value() == '}') {
-            consume();
-            tokens.push_back({ .type = TokenType::RIGHT_CURLY_BRACKET, .line = line_count });
-        }
-        else if (peek().value() == '+') {
-            consume();
+        case CharClass::ALPHA: {
+            const size_t start = _index++;
+            _index += scan::ident_run(_src.data() + _index, end - _index);
 
-            if (peek().has_value() && peek().value() == '+') {
-                consume();
-                tokens.push_back({ .type = TokenType::INCREMENTATOR, .line = line_count });
-            }
-            else
-                tokens.push_back({ .type = TokenType::PLUS, .line = line_count });
-        }
-        else if (peek().value() == '-') {
-            consume();
+            const std::string_view word = _src.substr(start, _index - start);
+            const TokenType type = keyword_type(word);
 
-            if (peek().has_value() && peek().value() == '-') {
-                consume();
-                tokens.push_back({ .type = TokenType::DECREMENTATOR, .line = line_count });
-            }
-            else
-                tokens.push_back({ .type = TokenType::MINUS, .line = line_count });
-        }
-        else if (peek().value() == '*') {
-            consume();
-            tokens.push_back({ .type = TokenType::STAR, .line = line_count });
+            if (type == TokenType::IDENTIFIER || type == TokenType::BOOLEAN_LITEARL)
+                return Token{ .type = type, .line = _line, .val = word };
+            return Token{ .type = type, .line = _line };
         }
-        else if (peek().value() == '/') {
-            consume();
-            tokens.push_back({ .type = TokenType::SLASH, .line = line_count });
-        }
-        else if (peek().value() == '!') {
-            consume();
 
-            if (peek().has_value() && peek().value() == '=') {
-                consume();
-                tokens.push_back({ .type = TokenType::IS_NOT_EQUAL, .line = line_count });
-            }
-            else
-                tokens.push_back({ .type = TokenType::NOT, .line = line_count });
+        case CharClass::DIGIT: {
+            const size_t start = _index++;
+            while (_index < end && char_class(_src[_index]) == CharClass::DIGIT)
+                _index++;
+
+            return Token{ .type = TokenType::INTEGER_LITERAL,
+                          .line = _line,
+                          .val = _src.substr(start, _index - start) };
         }
-        else if (peek().value() == '&') {
-            consume();
 
-            if (!peek().has_value() || peek().value() != '&') {
-                std::cerr << "expected `&` on line " << line_count << std::endl;
-                exit(EXIT_FAILURE);
+        case CharClass::SLASH:
+            // line comment: stop on the new line so it gets counted
+            if (peek(1) == '/') {
+                _index += scan::line_end(_src.data() + _index, end - _index);
+                break;
             }
-            tokens.push_back({ .type = TokenType::AND, .line = line_count });
-        }
-        else if (peek().value() == '|') {
-            consume();
 
-            if (!peek().has_value() || peek().value() != '|') {
-                std::cerr << "expected `|` on line " << line_count << std::endl;
-                exit(EXIT_FAILURE);
+            // block comment
+            if (peek(1) == '*') {
+                _index += 2;
+                _index += scan::block_comment_end(_src.data() + _index, end - _index, _line);
+                _index = std::min(_index + 2, end);
+                break;
             }
 
-            tokens.push_back({ .type = TokenType::OR, .line = line_count });
-        }
-        else if (peek().value() == '>') {
             consume();
+            return Token{ .type = TokenType::SLASH, .line = _line };
 
-            if (peek().has_value() && peek().value() == '=') {
+        case CharClass::OPERATOR: {
+            const Operator& op = operators[static_cast<unsigned char>(consume())];
+
+            if (op.next != '\0' && peek() == op.next) {
                 consume();
-                tokens.push_back({ .type = TokenType::GREATER_OR_EQUAL, .line = line_count });
+                return Token{ .type = op.pair, .line = _line };
             }
-            else
-                tokens.push_back({ .type = TokenType::GREATER, .line = line_count });
-        }
-        else if (peek().value() == '<') {
-            consume();
 
-            if (peek().has_value() && peek().value() == '=') {
-                consume();
-                tokens.push_back({ .type = TokenType::LOWER_OR_EQUAL, .line = line_count });
+            if (op.pair_only) {
+                exit_with("expected `" + std::string(1, c) + "`");
             }
-            else
-                tokens.push_back({ .type = TokenType::LOWER, .line = line_count });
+
+            return Token{ .type = op.single, .line = _line };
         }
-        else if (peek().value() == '\'') {
+
+        case CharClass::QUOTE:
             consume(); // '
 
-            if (peek().has_value() && isalnum(peek().value())) {
-                std::string c;
-                c += consume();
-                tokens.push_back({ .type = TokenType::CHAR_LITERAL, .line = line_count, .val = c });
+            if (const char lit = peek(); char_class(lit) == CharClass::ALPHA || char_class(lit) == CharClass::DIGIT) {
+                const Token token{ .type = TokenType::CHAR_LITERAL, .line = _line, .val = _src.substr(_index, 1) };
+                consume();
 
-                if (!peek().has_value() || peek().value() != '\'') {
-                    std::cerr << "[Error] expected `'` on line " << line_count << std::endl;
-                    exit(EXIT_FAILURE);
+                if (peek() != '\'') {
+                    exit_with("expected `'`");
                 }
 
                 consume(); // '
+                return token;
             }
-            else {
-                std::cerr << "[Error] expected a valid char on line " << line_count << std::endl;
-                exit(EXIT_FAILURE);
-            }
-        }
-        else if (peek().value() == '"') {
+
+            exit_with("expected a valid char");
+
+        case CharClass::DOUBLE_QUOTE: {
             consume(); // "
 
-            while (peek().has_value() &&
-                (std::isalnum(peek().value()) || peek().value() != '"')) {
-                buf.push_back(consume());
+            const size_t start = _index;
+            const int line = _line;
+            while (_index < end && _src[_index] != '"') {
+                if (_src[_index] == '\n')
+                    _line++;
+                _index++;
             }
 
-            tokens.push_back({ .type = TokenType::STRING_LITERAL, .line = line_count, .val = buf });
-            buf.clear();
-            if (!peek().has_value() || peek().value() != '"') {
-                std::cerr << "[Error] expected `\"` on line " << line_count << std::endl;
-                exit(EXIT_FAILURE);
+            const Token token{ .type = TokenType::STRING_LITERAL, .line = line, .val = _src.substr(start, _index - start) };
+            if (_index >= end) {
+                exit_with("expected `\"`");
             }
 
             consume(); // "
-            line_count++;
-        }
-        else if (peek().value() == '\n') {
-            line_count++;
-            consume();
+            return token;
         }
-        else if (std::isspace(peek().value())) {
-            consume();
-        }
-        else {
-            std::cerr << "[Error] invalid token `" << peek().value() << "` on line " << line_count << std::endl;
-            exit(EXIT_FAILURE);
+
+        case CharClass::INVALID:
+            exit_with("invalid token `" + std::string(1, c) + "`");
         }
     }
 
+    return {};
+}
+
+std::vector<Token> Tokenizer::tokenize() {
+    std::vector<Token> tokens;
+    // rough guess of one token every 8 bytes, avoids most of the regrowth on big sources
+    tokens.reserve(_src.length() / 8);
+
+    while (std::optional<Token> token = next())
+        tokens.push_back(token.value());
+
     _index = 0;
+    _line = 1;
 
     return tokens;
 }
@@ -4,11 +4,13 @@
 #include <optional>
 #include <vector>
 #include <string>
+#include <string_view>
 
 enum TokenType {
     RETURN,
     VAR,
     FUNC,
+    IMPORT,
     IDENTIFIER,
 
     TYPE_BOOL,
@@ -63,32 +65,59 @@ std::string to_string(const TokenType type);
 std::optional<int> op_prec(TokenType type);
 
 /// @brief a token is represented by its type, the line it is on and an optional value
+/// @note the value is a slice of the tokenizer source, it stays valid as long as the source does
 struct Token {
     TokenType type;
     int line;
-    std::optional<std::string> val{};
+    std::optional<std::string_view> val{};
 };
 
+/// @brief print a compile error on stderr and exit the process
+/// @note the files are lexed and parsed in parallel: the first thread to fail reports, the others block
+/// until the process is gone
+[[noreturn]] void exit_with_error(const std::string& message);
+
+/// @brief decode the escape sequences of a string literal value (kept as written in the source)
+/// @param lit value of a string literal token
+/// @return the string the C++ backend's literal would hold
+std::string unescape(std::string_view lit);
+
 class Tokenizer {
 private:
-    /// @brief src string containing the code to tokenize
-    const std::string _src;
+    /// @brief view over the code to tokenize (token values point into it)
+    const std::string_view _src;
+    /// @brief file the code comes from, named in the errors (empty for stdin)
+    const std::string_view _path;
     /// @brief index of the current character
     size_t _index = 0;
+    /// @brief line of the current character
+    int _line = 1;
 
     /// @brief peek a character value (default: current)
-    /// @param offset to peek forward or backward (default: 0)
-    std::optional<char> peek(const size_t offset = 0) const;
+    /// @param offset to peek forward (default: 0)
+    /// @return the character or `\0` past the end of the source
+    char peek(const size_t offset = 0) const;
 
     /// @brief consume the current char and move to the next one
     /// @return the consumed char
     char consume();
 
+    /// @brief exit with an error on the current line
+    [[noreturn]] void exit_with(const std::string& err_msg) const;
+
 public:
     /// @brief Create a tokenizer
-    /// @param src string containing the code to tokenize
-    Tokenizer(const std::string& src);
+    /// @param src code to tokenize, must outlive the produced tokens
+    /// @param path file the code comes from, must outlive the tokenizer
+    Tokenizer(std::string_view src, std::string_view path = {});
+
+    /// @brief where an error is: `line N`, followed by the file when it is known
+    std::string location(int line) const;
+
+    /// @brief lex the next token on demand
+    /// @return the token or nothing at the end of the source
+    std::optional<Token> next();
 
-    /// @brief start tokenization
+    /// @brief tokenize the whole source at once
     std::vector<Token> tokenize();
 };
\ No newline at end of file
@@ -0,0 +1,375 @@
+#include "vm.h"
+
+#include <charconv>
+#include <cstdio>
+#include <memory>
+
+#include "jit.h"
+
+namespace {
+    // registers of all the active frames
+    constexpr size_t STACK_SIZE = 1 << 20;
+
+    [[noreturn]] void exit_with(const std::string& err_msg) {
+        std::fflush(stdout);
+        std::cerr << "[Runtime Error] " << err_msg << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    // buffered like std::cout: flushed when full, by println (std::endl) and before exiting
+    class Output {
+    private:
+        static constexpr size_t CAPACITY = 4096;
+
+        char buffer[CAPACITY];
+        size_t size = 0;
+
+    public:
+        void flush() {
+            std::fwrite(buffer, 1, size, stdout);
+            std::fflush(stdout);
+            size = 0;
+        }
+
+        void put(char c) {
+            if (size == CAPACITY)
+                flush();
+            buffer[size++] = c;
+        }
+
+        void write(std::string_view s) {
+            for (const char c : s)
+                put(c);
+        }
+
+        void write_int(int64_t v) {
+            char digits[24];
+            const auto [end, ec] = std::to_chars(digits, digits + sizeof(digits), v);
+            write(std::string_view(digits, end - digits));
+        }
+    };
+
+    // int arithmetic wraps on 32 bits like the C++ backend's int
+    inline int64_t wrap(uint32_t v) {
+        return static_cast<int32_t>(v);
+    }
+
+    struct CallInfo {
+        const bc::Instr* ret;
+        int64_t* base;
+        int frame_size;
+        int32_t dst;
+        int32_t function;
+    };
+
+    // calls to a function and backward jumps taken in it before it is compiled to machine code
+    constexpr uint32_t HOT_THRESHOLD = 1000;
+
+    class Machine {
+    private:
+        const bc::Program& program;
+
+        std::unique_ptr<int64_t[]> stack;
+        std::unique_ptr<int64_t[]> globals;
+        const int64_t* stack_end;
+
+        std::vector<CallInfo> calls;
+        Output out;
+
+        // tiering: the functions running hot are compiled by the JIT, index 0 (initialization) never is
+        bool jit;
+        std::vector<uint32_t> counters;
+        std::vector<std::unique_ptr<jit::Code>> compiled;
+        jit::Context ctx;
+        jit::Hooks hooks;
+
+        static Machine& of(jit::Context* ctx) {
+            return *static_cast<Machine*>(ctx->vm);
+        }
+
+        static int64_t call_hook(jit::Context* ctx, int32_t function, int64_t* base) {
+            return of(ctx).call(function, base);
+        }
+
+        static void print_hook(jit::Context* ctx, int32_t op, int64_t value) {
+            of(ctx).print(static_cast<bc::OpCode>(op), value);
+        }
+
+        static void fail_hook(jit::Context*, int32_t error) {
+            exit_with(error == jit::DIVISION_BY_ZERO ? "division by zero" : "stack overflow");
+        }
+
+        // count one more call or loop iteration of a function, compile it once it is hot;
+        // returns its machine code, nullptr while it runs in the VM
+        const jit::Code* tier_up(int32_t function) {
+            if (compiled[function] != nullptr)
+                return compiled[function].get();
+            if (!jit || function == 0 || ++counters[function] < HOT_THRESHOLD)
+                return nullptr;
+
+            if (!compile(function))
+                jit = false; // no executable memory, stay in the VM
+
+            return compiled[function].get();
+        }
+
+        // the functions called are compiled first (there is no recursion), so the new code calls
+        // them directly instead of going back to the VM
+        bool compile(int32_t function) {
+            const bc::Function& f = program.functions[function];
+
+            for (size_t pc = f.entry; pc < f.end; pc++) {
+                const bc::Instr& i = program.code[pc];
+                if (i.op == bc::CALL && compiled[i.b] == nullptr && !compile(i.b))
+                    return false;
+            }
+
+            compiled[function] = jit::compile(program, function, compiled, hooks);
+            return compiled[function] != nullptr;
+        }
+
+        // a call from machine code to a function without machine code
+        int64_t call(int32_t function, int64_t* base) {
+            if (const jit::Code* code = tier_up(function))
+                return code->entry()(base, &ctx, code->start());
+            return execute(function, base);
+        }
+
+        void print(bc::OpCode op, int64_t value) {
+            switch (op) {
+            case bc::PRINTI:
+                out.write_int(value);
+                break;
+            case bc::PRINTC:
+                out.put(static_cast<char>(value));
+                break;
+            case bc::PRINTS:
+                // a std::string built from a literal stops at its first NUL, like the C++ backend
+                out.write(program.strings[value].c_str());
+                break;
+            default:
+                out.put('\n');
+                out.flush();
+            }
+        }
+
+    public:
+        Machine(const bc::Program& program, bool jit)
+            : program(program),
+            stack(std::make_unique_for_overwrite<int64_t[]>(STACK_SIZE)),
+            globals(std::make_unique<int64_t[]>(program.num_globals)),
+            stack_end(stack.get() + STACK_SIZE),
+            jit(jit && jit::supported()),
+            counters(program.functions.size(), 0),
+            compiled(program.functions.size()),
+            ctx{ globals.get(), stack_end, this },
+            hooks{ call_hook, print_hook, fail_hook } {
+        }
+
+        int run() {
+            return static_cast<int>(execute(0, stack.get()));
+        }
+
+        // run a function until it returns (HALT for the initialization)
+        int64_t execute(int32_t function, int64_t* base);
+    };
+
+    int64_t Machine::execute(int32_t function, int64_t* base) {
+        // dispatch with computed gotos (GNU extension): every handler jumps straight to the next one,
+        // which gives the branch predictor one indirect jump per opcode instead of a shared switch
+        static const void* const handlers[] = {
+            &&op_LOADI, &&op_MOV, &&op_GETG, &&op_SETG,
+            &&op_ADD, &&op_SUB, &&op_MUL, &&op_DIV, &&op_ADDI, &&op_MULI,
+            &&op_EQ, &&op_NE, &&op_LT, &&op_LE, &&op_GT, &&op_GE,
+            &&op_EQI, &&op_NEI, &&op_LTI, &&op_LEI, &&op_GTI, &&op_GEI,
+            &&op_NOT, &&op_TEST, &&op_ITOC, &&op_CTOI,
+            &&op_JMP, &&op_JMPF, &&op_JMPT,
+            &&op_CALL, &&op_RET, &&op_RETV,
+            &&op_PRINTI, &&op_PRINTC, &&op_PRINTS, &&op_PRINTLN, &&op_HALT
+        };
+        static_assert(std::size(handlers) == bc::OP_COUNT, "one handler per opcode");
+
+        const bc::Instr* const code = program.code.data();
+        const bc::Function& entry = program.functions[function];
+
+        // the frames pushed below this one belong to the callers of machine code
+        const size_t depth = calls.size();
+
+        const bc::Instr* pc = code + entry.entry;
+        int64_t* r = base;
+        int frame_size = entry.frame_size;
+        int64_t value;
+
+        if (r + frame_size > stack_end)
+            exit_with("stack overflow");
+
+        const bc::Instr* i;
+
+#define DISPATCH() do { i = pc++; goto *handlers[i->op]; } while (false)
+
+        DISPATCH();
+
+    op_LOADI:
+        r[i->a] = i->b;
+        DISPATCH();
+    op_MOV:
+        r[i->a] = r[i->b];
+        DISPATCH();
+    op_GETG:
+        r[i->a] = globals[i->b];
+        DISPATCH();
+    op_SETG:
+        globals[i->a] = r[i->b];
+        DISPATCH();
+    op_ADD:
+        r[i->a] = wrap(static_cast<uint32_t>(r[i->b]) + static_cast<uint32_t>(r[i->c]));
+        DISPATCH();
+    op_SUB:
+        r[i->a] = wrap(static_cast<uint32_t>(r[i->b]) - static_cast<uint32_t>(r[i->c]));
+        DISPATCH();
+    op_MUL:
+        r[i->a] = wrap(static_cast<uint32_t>(r[i->b]) * static_cast<uint32_t>(r[i->c]));
+        DISPATCH();
+    op_DIV:
+        if (r[i->c] == 0)
+            exit_with("division by zero");
+        r[i->a] = wrap(static_cast<uint32_t>(r[i->b] / r[i->c]));
+        DISPATCH();
+    op_ADDI:
+        r[i->a] = wrap(static_cast<uint32_t>(r[i->b]) + static_cast<uint32_t>(i->c));
+        DISPATCH();
+    op_MULI:
+        r[i->a] = wrap(static_cast<uint32_t>(r[i->b]) * static_cast<uint32_t>(i->c));
+        DISPATCH();
+    op_EQ:
+        r[i->a] = r[i->b] == r[i->c];
+        DISPATCH();
+    op_NE:
+        r[i->a] = r[i->b] != r[i->c];
+        DISPATCH();
+    op_LT:
+        r[i->a] = r[i->b] < r[i->c];
+        DISPATCH();
+    op_LE:
+        r[i->a] = r[i->b] <= r[i->c];
+        DISPATCH();
+    op_GT:
+        r[i->a] = r[i->b] > r[i->c];
+        DISPATCH();
+    op_GE:
+        r[i->a] = r[i->b] >= r[i->c];
+        DISPATCH();
+    op_EQI:
+        r[i->a] = r[i->b] == i->c;
+        DISPATCH();
+    op_NEI:
+        r[i->a] = r[i->b] != i->c;
+        DISPATCH();
+    op_LTI:
+        r[i->a] = r[i->b] < i->c;
+        DISPATCH();
+    op_LEI:
+        r[i->a] = r[i->b] <= i->c;
+        DISPATCH();
+    op_GTI:
+        r[i->a] = r[i->b] > i->c;
+        DISPATCH();
+    op_GEI:
+        r[i->a] = r[i->b] >= i->c;
+        DISPATCH();
+    op_NOT:
+        r[i->a] = !r[i->b];
+        DISPATCH();
+    op_TEST:
+        r[i->a] = r[i->b] != 0;
+        DISPATCH();
+    op_ITOC:
+        r[i->a] = static_cast<int8_t>(r[i->b] + '0');
+        DISPATCH();
+    op_CTOI:
+        r[i->a] = wrap(static_cast<uint32_t>(r[i->b] - '0'));
+        DISPATCH();
+    op_JMP:
+        pc = code + i->a;
+        // a backward jump closes a loop iteration: once the loop is hot, the rest of the call runs
+        // as machine code, entered at the head of the loop with the registers as they are
+        if (pc <= i) {
+            if (const jit::Code* jitted = tier_up(function)) {
+                value = jitted->entry()(r, &ctx, jitted->at(i->a));
+                goto ret;
+            }
+        }
+        DISPATCH();
+    op_JMPF:
+        if (!r[i->a])
+            pc = code + i->b;
+        DISPATCH();
+    op_JMPT:
+        if (r[i->a])
+            pc = code + i->b;
+        DISPATCH();
+    op_CALL: {
+        if (const jit::Code* jitted = tier_up(i->b)) {
+            r[i->a] = jitted->entry()(r + frame_size, &ctx, jitted->start());
+            DISPATCH();
+        }
+
+        const bc::Function& f = program.functions[i->b];
+
+        calls.push_back({ pc, r, frame_size, i->a, function });
+        function = i->b;
+        r += frame_size;
+        frame_size = f.frame_size;
+        pc = code + f.entry;
+
+        if (r + frame_size > stack_end)
+            exit_with("stack overflow");
+        DISPATCH();
+    }
+    op_RET:
+        value = r[i->a];
+        goto ret;
+    op_RETV:
+        value = 0;
+        goto ret;
+    ret: {
+        if (calls.size() == depth)
+            return value;
+
+        const CallInfo& caller = calls.back();
+
+        pc = caller.ret;
+        r = caller.base;
+        frame_size = caller.frame_size;
+        function = caller.function;
+        r[caller.dst] = value;
+        calls.pop_back();
+        DISPATCH();
+    }
+    op_PRINTI:
+        out.write_int(r[i->a]);
+        DISPATCH();
+    op_PRINTC:
+        out.put(static_cast<char>(r[i->a]));
+        DISPATCH();
+    op_PRINTS:
+        // a std::string built from a literal stops at its first NUL, like the C++ backend
+        out.write(program.strings[r[i->a]].c_str());
+        DISPATCH();
+    op_PRINTLN:
+        out.put('\n');
+        out.flush();
+        DISPATCH();
+    op_HALT:
+        out.flush();
+        return r[i->a];
+
+#undef DISPATCH
+    }
+}
+
+namespace vm {
+    int run(const bc::Program& program, bool jit) {
+        return Machine(program, jit).run();
+    }
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "bytecode.h"
+
+namespace vm {
+    /// @brief execute a compiled program, its output goes to stdout
+    /// @param jit compile the hot functions to machine code (when the host supports it)
+    /// @return the exit status (the value returned by main)
+    int run(const bc::Program& program, bool jit);
+}
@@ -0,0 +1,81 @@
+#!/usr/bin/env bash
+# Differential test: every program of tests/programs (a .ce file, or a directory whose main.ce imports the
+# rest) goes through every backend, with and without the optimizer. Its output and exit status must match
+# the ones of the tree-walking interpreter on the unoptimized tree. The runs of --native on a program using
+# what it does not support are skipped. An executable killed by SIGFPE stands for the division by zero the
+# interpreter reports.
+#
+# usage: tests/differential.sh [path/to/cern]
+
+set -u
+
+cern=$(realpath "${1:-build/cern}")
+tests=$(cd "$(dirname "$0")" && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+# the builds write main.cpp and app in the working directory, and never touch the cache of the user
+export XDG_CACHE_HOME="$work/cache"
+mkdir -p "$work/build"
+
+modes=("--interpret" "--run" "--run --no-jit" "--native" "--via-ir" "" "--incremental")
+opts=("--no-opt" "")
+
+# output then exit status of a program through a mode; the build modes run the app they wrote
+run() {
+    local mode=$1 opt=$2 program=$3
+
+    case "$mode" in
+    --interpret* | --run*)
+        $cern $mode $opt "$program" 2>&1
+        echo "exit $?"
+        ;;
+    *)
+        rm -f "$work/build/app"
+        if ! (cd "$work/build" && $cern --no-cache $mode $opt "$program" > "$work/build.log" 2>&1); then
+            echo "build failed"
+            return
+        fi
+        (cd "$work/build" && ./app 2>&1) 2>/dev/null
+        local status=$?
+        if [ "$status" -eq $((128 + 8)) ]; then
+            echo "[Runtime Error] division by zero"
+            status=1
+        fi
+        echo "exit $status"
+        ;;
+    esac
+}
+
+checked=0
+skipped=0
+failed=0
+
+for program in "$tests"/programs/*.ce "$tests"/programs/*/main.ce; do
+    name=${program#"$tests/programs/"}
+    run --interpret --no-opt "$program" > "$work/expected"
+
+    for mode in "${modes[@]}"; do
+        for opt in "${opts[@]}"; do
+            run "$mode" "$opt" "$program" > "$work/actual"
+
+            # the native backend rejects the features it lacks (string operations), nothing to compare
+            if [ "$mode" = --native ] && grep -q "not supported" "$work/build.log" 2>/dev/null; then
+                skipped=$((skipped + 1))
+                rm -f "$work/build.log"
+                continue
+            fi
+            rm -f "$work/build.log"
+            checked=$((checked + 1))
+
+            if ! cmp -s "$work/expected" "$work/actual"; then
+                failed=$((failed + 1))
+                echo "FAIL $name ${mode:-(default)} ${opt:-(opt)}"
+                diff "$work/expected" "$work/actual" | head -n 10
+            fi
+        done
+    done
+done
+
+echo "$checked runs, $skipped skipped, $failed failed"
+[ "$failed" -eq 0 ]